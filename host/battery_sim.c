@@ -0,0 +1,100 @@
+// battery_sim.c
+// Replays a battery trace through the history store and estimator
+// (battery_history.h) and prints what the overlay would show, as CSV.
+//
+//   battery_sim <battery.trace>
+//
+// Trace lines are "<wall_s> <percent>", or "restart": the app saves its
+// history, closes and loads it again on the next line, as it does across
+// a HOME exit. The tool exits non-zero if a restart loses or changes the
+// history, or a fit reaches back across a restart gap.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "platform.h"
+#include "battery_history.h"
+
+static bool same_history(const BatteryHistory* a, const BatteryHistory* b) {
+    if(a->base_time != b->base_time || a->base_pct != b->base_pct || a->count != b->count ||
+       a->last_time != b->last_time || a->last_pct != b->last_pct)
+        return false;
+    for(int i = 0; i < a->count; i++) {
+        const BatteryDelta* x = battery_history_delta(a, i);
+        const BatteryDelta* y = battery_history_delta(b, i);
+        if(x->dt_s != y->dt_s || x->dp != y->dp) return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if(argc != 2) {
+        fprintf(stderr, "usage: %s <battery.trace>\n", argv[0]);
+        return 2;
+    }
+    FILE* f = fopen(argv[1], "r");
+    if(!f) {
+        fprintf(stderr, "cannot read battery trace %s\n", argv[1]);
+        return 1;
+    }
+    char dir[] = "/tmp/battery_sim.XXXXXX";
+    if(!mkdtemp(dir)) {
+        fprintf(stderr, "cannot create a scratch directory in /tmp\n");
+        return 1;
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "%s/battery_history.bin", dir);
+
+    static BatteryHistory bh, reloaded;
+    battery_history_init(&bh);
+    u32 first = 0, closed_at = 0, segment = 0;
+    bool reopened = false;
+    int samples = 0, restarts = 0, errors = 0;
+    char line[128];
+    printf("minute,percent,smoothed,tte_min,deltas\n");
+    while(fgets(line, sizeof(line), f)) {
+        unsigned t, pct;
+        if(strncmp(line, "restart", 7) == 0) {
+            if(!battery_history_save(&bh, path) || !battery_history_load(&reloaded, path) ||
+               !same_history(&bh, &reloaded)) {
+                fprintf(stderr, "restart %d: history did not survive save and load\n", restarts + 1);
+                errors++;
+            }
+            bh = reloaded;
+            closed_at = bh.last_time;
+            reopened = true;
+            restarts++;
+            continue;
+        }
+        if(line[0] == '#' || sscanf(line, "%u %u", &t, &pct) != 2) continue;
+        if(!samples) first = t;
+        u32 base = bh.base_time;
+        battery_history_add(&bh, t, (u8)pct);
+        samples++;
+        if(reopened) {
+            if(bh.base_time != base) {
+                fprintf(stderr, "restart %d: history dropped after a %lu s gap\n", restarts,
+                        (unsigned long)(t - closed_at));
+                errors++;
+            }
+            // a gap too long for one delta starts a new segment
+            if(t - closed_at > 0xFFFF) segment = t;
+            reopened = false;
+        }
+        if(segment && bh.have_fit && t - segment < BH_MIN_SPAN_S) {
+            fprintf(stderr, "minute %lu: fit reaches back across the restart gap\n",
+                    (unsigned long)(t - first) / 60);
+            errors++;
+        }
+        printf("%lu,%u,%.1f,%.0f,%d\n", (unsigned long)(t - first) / 60, pct,
+               battery_history_smoothed(&bh, t), battery_history_tte(&bh, t), bh.count);
+    }
+    fclose(f);
+
+    remove(path);
+    rmdir(dir);
+    fprintf(stderr, "%d readings, %d restarts, %d deltas (%d bytes on SD), history from %+ld s\n",
+            samples, restarts, bh.count, 16 + bh.count * 3, (long)bh.base_time - (long)first);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,520 @@
+// bench.c
+// Microbenchmarks for the code paths the apps run every frame or on every
+// settings change, built natively against the simulated platform. Each
+// case runs a fixed number of iterations per repetition; the report gives
+// the median, fastest and slowest repetition in nanoseconds per operation
+// as JSON on stdout, so runs can be stored and compared across commits.
+// Scratch files go to a private directory under /tmp.
+//
+//   bench [--reps N] [--quick] [name-filter...]
+//
+// --quick runs a tenth of the iterations (smoke test, noisy numbers).
+// Filters are substrings of case names ("config." runs the config group).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "system_utils.h"
+#include "config_store.h"
+#include "config_watch.h"
+#include "config_writer.h"
+#include "config_snapshot.h"
+#include "json_parser.h"
+#include "status_text.h"
+#include "sensors.h"
+#include "governor.h"
+#include "scene.h"
+#include "frametime.h"
+#include "ui_page.h"
+#include "sd_index.h"
+
+#define BENCH_REPS_DEFAULT 7
+#define BENCH_REPS_MAX     64
+#define FRAME_MS           16
+#define SD_TREE_SUBDIRS    8      // per top-level folder
+#define SD_TREE_FILES      8      // per subfolder
+
+static volatile u64 bench_sink;   // keeps results observable to the optimizer
+
+static char bench_dir[64];
+static char config_path[128];
+static char legacy_path[128];
+
+static char json_text[CONFIG_FILE_MAX];
+static int json_len;
+static char legacy_text[CONFIG_FILE_MAX];
+static int legacy_len;
+
+static ConfigStore config;
+static ConfigWatch watch;
+static ConfigWriter writer;
+static ConfigSnapshots snapshots;
+static SdIndex sdIndex;
+static char sd_root[96];
+static const char* sd_top[] = { "3ds", "Nintendo 3DS", "luma", "DCIM" };
+
+static u64 now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+// Fixtures
+
+// A config the size the apps actually carry: app toggles, the theme and
+// the full set of governor keys.
+static void fill_config(ConfigStore* cs) {
+    static const char* tiers[GOV_TIER_COUNT] = { "normal", "saver", "critical" };
+    GovConfig gov;
+    governor_config_defaults(&gov);
+    config_store_clear(cs);
+    config_store_set_bool(cs, "battery_saver", false);
+    config_store_set_bool(cs, "perf_logging", true);
+    config_store_set_bool(cs, "request_overlay", false);
+    config_store_set_int(cs, "brightness", 80);
+    config_store_set_string(cs, "theme", "night");
+    config_store_set_bool(cs, "gov_enabled", gov.enabled);
+    config_store_set_int(cs, "gov_target_min", gov.target_min);
+    config_store_set_int(cs, "gov_saver_pct", gov.saver_pct);
+    config_store_set_int(cs, "gov_critical_pct", gov.critical_pct);
+    config_store_set_int(cs, "gov_hyst_pct", gov.hyst_pct);
+    config_store_set_int(cs, "gov_dwell_ms", gov.dwell_ms);
+    for(int i = 0; i < GOV_TIER_COUNT; i++) {
+        char key[CONFIG_KEY_LEN];
+        snprintf(key, sizeof(key), "gov_%s_brightness", tiers[i]);
+        config_store_set_int(cs, key, gov.tier[i].brightness);
+        snprintf(key, sizeof(key), "gov_%s_refresh_ms", tiers[i]);
+        config_store_set_int(cs, key, gov.tier[i].refresh_ms);
+        snprintf(key, sizeof(key), "gov_%s_poll_ms", tiers[i]);
+        config_store_set_int(cs, key, gov.tier[i].poll_ms);
+    }
+}
+
+static bool write_file(const char* path, const char* data, size_t len) {
+    FILE* f = fopen(path, "w");
+    if(!f) return false;
+    bool ok = fwrite(data, 1, len, f) == len;
+    return fclose(f) == 0 && ok;
+}
+
+// A small card: a few top-level folders, each with subfolders of files.
+// With `create` false, removes it again.
+static bool sd_tree(bool create) {
+    char path[192];
+    bool ok = true;
+    for(size_t t = 0; t < sizeof(sd_top) / sizeof(sd_top[0]); t++) {
+        snprintf(path, sizeof(path), "%s/%s", sd_root, sd_top[t]);
+        if(create) ok = mkdir(path, 0755) == 0 && ok;
+        for(int d = 0; d < SD_TREE_SUBDIRS; d++) {
+            snprintf(path, sizeof(path), "%s/%s/%d", sd_root, sd_top[t], d);
+            if(create) ok = mkdir(path, 0755) == 0 && ok;
+            for(int f = 0; f < SD_TREE_FILES; f++) {
+                snprintf(path, sizeof(path), "%s/%s/%d/%d.bin", sd_root, sd_top[t], d, f);
+                if(create) ok = write_file(path, json_text, (size_t)(f + 1) * 64) && ok;
+                else remove(path);
+            }
+            snprintf(path, sizeof(path), "%s/%s/%d", sd_root, sd_top[t], d);
+            if(!create) rmdir(path);
+        }
+        snprintf(path, sizeof(path), "%s/%s", sd_root, sd_top[t]);
+        if(!create) rmdir(path);
+    }
+    if(!create) rmdir(sd_root);
+    return ok;
+}
+
+static bool setup_fixtures(void) {
+    snprintf(bench_dir, sizeof(bench_dir), "/tmp/enhancer_bench.XXXXXX");
+    if(!mkdtemp(bench_dir)) return false;
+    snprintf(config_path, sizeof(config_path), "%s/config.json", bench_dir);
+    snprintf(legacy_path, sizeof(legacy_path), "%s/config.txt", bench_dir);
+
+    fill_config(&config);
+    json_len = config_writer_format(&config, json_text, sizeof(json_text));
+    if(json_len < 0) return false;
+
+    // the same keys as key=value lines, with the looked-up key last so
+    // read_bool_config scans the whole file
+    legacy_len = 0;
+    for(int i = 0; i < CONFIG_STORE_SLOTS; i++) {
+        const ConfigEntry* e = &config.slots[i];
+        if(e->type == CONFIG_NONE || strcmp(e->key, "perf_logging") == 0) continue;
+        char v[CONFIG_STR_LEN];
+        config_entry_text(e, v, sizeof(v));
+        legacy_len += snprintf(legacy_text + legacy_len, sizeof(legacy_text) - legacy_len, "%s=%s\n", e->key, v);
+    }
+    legacy_len += snprintf(legacy_text + legacy_len, sizeof(legacy_text) - legacy_len, "perf_logging=1\n");
+
+    if(!write_file(config_path, json_text, json_len) || !write_file(legacy_path, legacy_text, legacy_len))
+        return false;
+    config_store_load(&config, config_path);
+    config_watch_init(&watch, config_path);
+    config_writer_init(&writer, &config, &watch);
+    config_snapshot_init(&snapshots, config_path);
+
+    snprintf(sd_root, sizeof(sd_root), "%s/sd", bench_dir);
+    return mkdir(sd_root, 0755) == 0 && sd_tree(true);
+}
+
+static void remove_fixtures(void) {
+    static const char* suffixes[] = { "/config.json", "/config.json" CONFIG_TMP_SUFFIX, "/config.gen",
+                                      "/config.gen" CONFIG_TMP_SUFFIX, "/config.snap",
+                                      "/config.snap" CONFIG_TMP_SUFFIX, "/config.txt" };
+    char path[160];
+    sd_tree(false);
+    for(size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        snprintf(path, sizeof(path), "%s%s", bench_dir, suffixes[i]);
+        remove(path);
+    }
+    rmdir(bench_dir);
+}
+
+// A one-hour discharge, one sample per minute, so the cached sensor values
+// (and with them the status text) change now and then like on hardware.
+static void fill_trace(void) {
+    for(int i = 0; i <= 60; i++) {
+        SimSample* s = &platform_sim.samples[i];
+        s->time_ms = i * 60000u;
+        s->battery = (u8)(100 - i);
+        s->free_mem = (48u << 20) - (u32)(i % 7) * 4096u;
+        s->sd_free = (2ULL << 30) - (u64)i * 65536u;
+    }
+    platform_sim.count = 61;
+    platform_sim.cursor = 0;
+    platform_sim.now_ms = 0;
+}
+
+// Overview page as enhanced_settings shows it.
+
+static bool page_saver;
+static int page_brightness = 80;
+
+static void text_battery(const UiWidget* w, char* buf, size_t n) {
+    (void)w;
+    status_battery(buf, n, (u8)sensors_get(SENSOR_BATTERY));
+}
+
+static void text_free_mem(const UiWidget* w, char* buf, size_t n) {
+    (void)w;
+    status_free_mem(buf, n, (u32)sensors_get(SENSOR_FREE_MEM));
+}
+
+static void text_sd_free(const UiWidget* w, char* buf, size_t n) {
+    (void)w;
+    status_sd_free(buf, n, sensors_get(SENSOR_SD_FREE));
+}
+
+static void text_sensor_stats(const UiWidget* w, char* buf, size_t n) {
+    sensors_format_stats((SensorId)w->arg, buf, n);
+}
+
+static UiPage pages[1] = {
+    { .tab = "[Main]  (L/R to change)", .title = "Overview", .widgets = {
+        { .kind = UI_INFO, .text = text_battery },
+        { .kind = UI_TOGGLE, .label = "Battery Saver", .flag = &page_saver },
+        { .kind = UI_SLIDER, .label = "Brightness", .value = &page_brightness,
+          .min = 0, .max = 100, .step = 10, .flags = UI_F_EDIT },
+        { .kind = UI_INFO, .text = text_free_mem },
+        { .kind = UI_INFO, .text = text_sd_free },
+        { .kind = UI_INFO, .text = text_sensor_stats, .arg = SENSOR_BATTERY, .flags = UI_F_SMALL },
+    } },
+};
+static UiApp ui = { "Enhanced Settings", pages, 1, 0, 0, false };
+static UiDrawList drawList;
+
+// Cases. Each runs n operations.
+
+static void bench_config_parse_legacy(u32 n) {
+    static ConfigStore cs;
+    char text[CONFIG_FILE_MAX];
+    for(u32 i = 0; i < n; i++) {
+        memcpy(text, legacy_text, legacy_len + 1);
+        config_store_clear(&cs);
+        config_store_parse(&cs, text);
+        bench_sink += cs.count;
+    }
+}
+
+static void bench_config_parse_json(u32 n) {
+    static ConfigStore cs;
+    char text[CONFIG_FILE_MAX];
+    for(u32 i = 0; i < n; i++) {
+        memcpy(text, json_text, json_len + 1);
+        config_store_clear(&cs);
+        config_store_parse_json(&cs, text, json_len);
+        bench_sink += cs.count;
+    }
+}
+
+static void bench_json_tokenize(u32 n) {
+    char text[CONFIG_FILE_MAX];
+    for(u32 i = 0; i < n; i++) {
+        memcpy(text, json_text, json_len + 1);
+        JsonLexer lx;
+        json_lexer_init(&lx, text, json_len);
+        JsonToken t;
+        while((t = json_next(&lx)) != JSON_DONE && t != JSON_ERROR) bench_sink++;
+    }
+}
+
+static void bench_config_load(u32 n) {
+    static ConfigStore cs;
+    for(u32 i = 0; i < n; i++) {
+        config_store_load(&cs, config_path);
+        bench_sink += cs.count;
+    }
+}
+
+// One op: the lookups an app does when it applies its settings.
+static void bench_config_get(u32 n) {
+    for(u32 i = 0; i < n; i++) {
+        bench_sink += config_store_get_bool(&config, "battery_saver", false);
+        bench_sink += config_store_get_bool(&config, "perf_logging", false);
+        bench_sink += config_store_get_int(&config, "brightness", 100);
+        bench_sink += (uintptr_t)config_store_get_string(&config, "theme", "default");
+        bench_sink += config_store_get_int(&config, "no_such_key", 0);
+    }
+}
+
+// The old per-key path: open and scan the file for every lookup.
+static void bench_read_bool_config(u32 n) {
+    for(u32 i = 0; i < n; i++)
+        bench_sink += read_bool_config(legacy_path, "perf_logging", false);
+}
+
+static void bench_config_format(u32 n) {
+    char buf[CONFIG_FILE_MAX];
+    for(u32 i = 0; i < n; i++)
+        bench_sink += config_writer_format(&config, buf, sizeof(buf));
+}
+
+// Full commit: re-read, merge, format, atomic replace, journal.
+static void bench_config_commit(u32 n) {
+    for(u32 i = 0; i < n; i++) {
+        config_writer_set_bool(&writer, "battery_saver", i & 1, 0);
+        bench_sink += config_writer_commit(&writer);
+    }
+}
+
+// The snapshot the writer takes before a save, one key changed each time:
+// mostly appends, with the rewrite whenever the store is full amortized in.
+static void bench_config_snapshot(u32 n) {
+    static ConfigStore cs;
+    cs = config;
+    for(u32 i = 0; i < n; i++) {
+        config_store_set_int(&cs, "brightness", (int)(i % 100));
+        bench_sink += config_snapshot_take(&snapshots, &cs, i);
+    }
+}
+
+// A watcher reading an unchanged journal, i.e. every CONFIG_WATCH_PERIOD_MS.
+static void bench_config_watch(u32 n) {
+    static ConfigWatch w;
+    config_watch_init(&w, config_path);
+    for(u32 i = 0; i < n; i++)
+        bench_sink += config_watch_poll(&w, &config, i * CONFIG_WATCH_PERIOD_MS, NULL, NULL);
+}
+
+static void bench_status_text(u32 n) {
+    char line[96];
+    for(u32 i = 0; i < n; i++) {
+        bench_sink += status_battery(line, sizeof(line), (u8)(i % 101));
+        bench_sink += status_saver(line, sizeof(line), i & 1);
+        bench_sink += status_free_mem(line, sizeof(line), (48u << 20) - i);
+        bench_sink += status_sd_free(line, sizeof(line), (2ULL << 30) - i);
+    }
+}
+
+static void bench_sensors_get(u32 n) {
+    for(u32 i = 0; i < n; i++)
+        for(int s = 0; s < SENSOR_COUNT; s++)
+            if(sensors_valid((SensorId)s)) bench_sink += sensors_get((SensorId)s);
+}
+
+// Per-frame poll when no sensor is due.
+static void bench_sensors_poll(u32 n) {
+    sensors_poll();
+    for(u32 i = 0; i < n; i++) sensors_poll();
+    bench_sink += sensors.s[SENSOR_BATTERY].samples;
+}
+
+static void bench_ui_emit(u32 n) {
+    for(u32 i = 0; i < n; i++) {
+        ui_emit(&ui, &drawList);
+        bench_sink += drawList.text_count + ui_batch_breaks(&drawList);
+    }
+}
+
+typedef struct {
+    u8 battery;
+    bool saver;
+    u8 tier;
+    u32 free_mem;
+    u64 sd_free;
+} FrameState;
+
+// One frame of an app with nothing to draw on the GPU: sample, govern,
+// poll config, decide whether to render and build the draw list if so.
+static void bench_frame(u32 n) {
+    static Governor gov;
+    static Scene scene;
+    static FrameTimer ft;
+    GovConfig cfg;
+    governor_config_load(&cfg, &config);
+    governor_init(&gov, &cfg);
+    scene_init(&scene);
+    frame_timer_init(&ft);
+    fill_trace();
+    for(int s = 0; s < SENSOR_COUNT; s++) sensors.s[s].valid = false;
+    sensors_init();
+    watch.checked = false;
+
+    u64 vblank_us = 0;
+    for(u32 i = 0; i < n; i++) {
+        platform_sim_advance_ms(FRAME_MS);
+        u32 now = platform_ms();
+        frame_timer_mark(&ft, FT_BEGIN, vblank_us);
+
+        sensors_poll();
+        u8 pct = (u8)sensors_get(SENSOR_BATTERY);
+        governor_update(&gov, now, pct);
+        config_watch_poll(&watch, &config, now, NULL, NULL);
+        config_writer_poll(&writer, now);
+
+        FrameState st = { pct, page_saver, (u8)gov.tier, (u32)sensors_get(SENSOR_FREE_MEM), sensors_get(SENSOR_SD_FREE) };
+        scene_update(&scene, 0, &st, sizeof(st));
+        bool render = scene_should_render(&scene);
+        if(render) {
+            ui_emit(&ui, &drawList);
+            bench_sink += ui_batch_breaks(&drawList);
+        }
+        frame_timer_mark(&ft, FT_CPU_DONE, vblank_us + 2000);
+        frame_timer_mark(&ft, FT_GPU_DONE, vblank_us + 4000);
+        vblank_us += FT_VBLANK_US;
+        frame_timer_end(&ft, vblank_us, render);
+        scene_end_frame(&scene, render);
+    }
+    bench_sink += scene.frames_rendered;
+}
+
+// One whole walk of the fixture card per op, in worker-sized slices.
+static void bench_sd_index_full(u32 n) {
+    sd_index_init(&sdIndex, sd_root, NULL);
+    for(u32 i = 0; i < n; i++) {
+        sd_index_begin(&sdIndex, true);
+        while(sd_index_step(&sdIndex, SD_INDEX_SLICE_US)) {}
+    }
+    bench_sink += sdIndex.current->dirs[0].total_bytes;
+    sd_index_free(&sdIndex);
+}
+
+// Nothing changed since the last walk: only directories are stat()ed.
+static void bench_sd_index_rescan(u32 n) {
+    sd_index_init(&sdIndex, sd_root, NULL);
+    sd_index_begin(&sdIndex, true);
+    while(sd_index_step(&sdIndex, SD_INDEX_SLICE_US)) {}
+    for(u32 i = 0; i < n; i++) {
+        sd_index_begin(&sdIndex, false);
+        while(sd_index_step(&sdIndex, SD_INDEX_SLICE_US)) {}
+    }
+    bench_sink += sdIndex.current->h.reused;
+    sd_index_free(&sdIndex);
+}
+
+typedef struct {
+    const char* name;
+    void (*fn)(u32 n);
+    u32 iters;
+    const int* bytes;         // input bytes per op, for a throughput figure
+} BenchCase;
+
+static const BenchCase cases[] = {
+    { "config.parse_legacy",   bench_config_parse_legacy, 100000, &legacy_len },
+    { "config.parse_json",     bench_config_parse_json,   100000, &json_len },
+    { "config.get",            bench_config_get,         2000000, NULL },
+    { "config.read_bool_file", bench_read_bool_config,     20000, NULL },
+    { "config.load",           bench_config_load,          20000, NULL },
+    { "config.format_json",    bench_config_format,       100000, NULL },
+    { "config.commit",         bench_config_commit,         1000, NULL },
+    { "config.snapshot",       bench_config_snapshot,      5000, NULL },
+    { "config.watch_poll",     bench_config_watch,         20000, NULL },
+    { "json.tokenize",         bench_json_tokenize,       100000, &json_len },
+    { "status.format",         bench_status_text,         500000, NULL },
+    { "sensors.get",           bench_sensors_get,        2000000, NULL },
+    { "sensors.poll_idle",     bench_sensors_poll,       2000000, NULL },
+    { "sd_index.full",         bench_sd_index_full,          200, NULL },
+    { "sd_index.rescan",       bench_sd_index_rescan,       2000, NULL },
+    { "ui.emit",               bench_ui_emit,             200000, NULL },
+    { "frame.headless",        bench_frame,               225000, NULL },  // one simulated hour
+};
+
+static int cmp_u64(const void* a, const void* b) {
+    u64 x = *(const u64*)a, y = *(const u64*)b;
+    return x < y ? -1 : x > y;
+}
+
+static bool selected(const char* name, int nfilter, char** filter) {
+    if(nfilter == 0) return true;
+    for(int i = 0; i < nfilter; i++)
+        if(strstr(name, filter[i])) return true;
+    return false;
+}
+
+int main(int argc, char** argv) {
+    int reps = BENCH_REPS_DEFAULT;
+    u32 divisor = 1;
+    char* filter[16];
+    int nfilter = 0;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            reps = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--quick") == 0) {
+            divisor = 10;
+        } else if(argv[i][0] != '-' && nfilter < 16) {
+            filter[nfilter++] = argv[i];
+        } else {
+            fprintf(stderr, "usage: %s [--reps N] [--quick] [name-filter...]\n", argv[0]);
+            return 2;
+        }
+    }
+    if(reps < 1 || reps > BENCH_REPS_MAX) {
+        fprintf(stderr, "--reps must be 1..%d\n", BENCH_REPS_MAX);
+        return 2;
+    }
+    if(!setup_fixtures()) {
+        fprintf(stderr, "cannot set up scratch files in /tmp\n");
+        return 1;
+    }
+    fill_trace();
+    sensors_init();
+    ui_layout(&ui);
+
+    printf("{\n  \"suite\": \"system_enhancer\",\n  \"reps\": %d,\n  \"unit\": \"ns/op\",\n  \"results\": [", reps);
+    bool first = true;
+    for(size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        const BenchCase* bc = &cases[c];
+        if(!selected(bc->name, nfilter, filter)) continue;
+        u32 iters = bc->iters / divisor ? bc->iters / divisor : 1;
+        u64 ns[BENCH_REPS_MAX];
+        bc->fn(iters / 10 ? iters / 10 : 1);       // warm caches and files
+        for(int r = 0; r < reps; r++) {
+            u64 t0 = now_ns();
+            bc->fn(iters);
+            ns[r] = now_ns() - t0;
+        }
+        qsort(ns, reps, sizeof(ns[0]), cmp_u64);
+        double median = (double)ns[reps / 2] / iters;
+        printf("%s\n    { \"name\": \"%s\", \"iters\": %u, \"median\": %.2f, \"min\": %.2f, \"max\": %.2f",
+               first ? "" : ",", bc->name, iters, median, (double)ns[0] / iters, (double)ns[reps - 1] / iters);
+        if(bc->bytes) printf(", \"bytes\": %d, \"mb_per_s\": %.1f", *bc->bytes, *bc->bytes * 1000.0 / median);
+        printf(" }");
+        fflush(stdout);
+        first = false;
+    }
+    printf("\n  ]\n}\n");
+
+    remove_fixtures();
+    return 0;
+}
@@ -0,0 +1,27 @@
+// check.h
+// Assertions for the host test programs. A failed CHECK prints where and
+// what and keeps going, so one run reports every broken case; check_done()
+// turns the tally into the exit status `make check` looks at.
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+static int check_failures;
+static int check_count;
+
+#define CHECK(cond) do { \
+        check_count++; \
+        if(!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            check_failures++; \
+        } \
+    } while(0)
+
+static inline int check_done(const char* name) {
+    printf("%s: %d checks, %d failed\n", name, check_count, check_failures);
+    return check_failures ? 1 : 0;
+}
+
+#endif
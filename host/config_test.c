@@ -0,0 +1,179 @@
+// config_test.c
+// Checks the parse-once config store (config_store.h) against the
+// read_bool_config() scan it replaced: every key answers the same from the
+// table as from the file, in both the legacy key=value and the JSON format,
+// and config_store_reload_if_changed() re-parses only when the file moved.
+// Malformed, oversized and lossy files must be reported as such.
+// Also prints lookups per second of both paths.
+//
+//   config_test
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "config_store.h"
+#include "json_parser.h"
+#include "check.h"
+
+static char dir[64];
+static char legacy_path[128];
+static char json_path[128];
+
+static const char legacy_text[] =
+    "battery_saver=1\n"
+    "perf_logging=false\n"
+    "request_overlay=true\n"
+    "brightness=70\n"
+    "theme=night\n"
+    "  padded = 1 \r\n"
+    "no_equals_line\n";
+
+static const char json_text[] =
+    "{\"battery_saver\": true, \"perf_logging\": false, \"brightness\": 70,\n"
+    " \"theme\": \"night\", \"profile\": {\"name\": \"travel\", \"saver\": true}}\n";
+
+static bool write_file(const char* path, const char* text) {
+    FILE* f = fopen(path, "w");
+    if(!f) return false;
+    bool ok = fputs(text, f) >= 0;
+    return fclose(f) == 0 && ok;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void test_legacy(void) {
+    static ConfigStore cs;
+    CHECK(config_store_load(&cs, legacy_path));
+    CHECK(cs.loaded);
+
+    // the table agrees with the old file scan for every key, present or not
+    static const char* keys[] = { "battery_saver", "perf_logging", "request_overlay", "missing" };
+    for(size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        CHECK(config_store_get_bool(&cs, keys[i], false) == read_bool_config(legacy_path, keys[i], false));
+        CHECK(config_store_get_bool(&cs, keys[i], true) == read_bool_config(legacy_path, keys[i], true));
+    }
+    CHECK(config_store_get_int(&cs, "brightness", 0) == 70);
+    CHECK(strcmp(config_store_get_string(&cs, "theme", ""), "night") == 0);
+    CHECK(config_store_get_bool(&cs, "padded", false));
+    CHECK(config_store_find(&cs, "no_equals_line") == NULL);
+    // a key of the wrong type falls back to the default
+    CHECK(config_store_get_int(&cs, "theme", 5) == 5);
+    CHECK(config_store_get_string(&cs, "brightness", NULL) == NULL);
+}
+
+static void test_json(void) {
+    static ConfigStore cs;
+    CHECK(config_store_load(&cs, json_path));
+    CHECK(config_store_get_bool(&cs, "battery_saver", false));
+    CHECK(!config_store_get_bool(&cs, "perf_logging", true));
+    CHECK(config_store_get_int(&cs, "brightness", 0) == 70);
+    CHECK(strcmp(config_store_get_string(&cs, "theme", ""), "night") == 0);
+    CHECK(strcmp(config_store_get_string(&cs, "profile.name", ""), "travel") == 0);
+    CHECK(config_store_get_bool(&cs, "profile.saver", false));
+    CHECK(cs.count == 6);
+}
+
+static void test_reload(void) {
+    static ConfigStore cs;
+    CHECK(config_store_load(&cs, legacy_path));
+    CHECK(!config_store_reload_if_changed(&cs));
+    CHECK(!config_store_reload_if_changed(&cs));
+
+    // a different size is a change even within the same mtime second
+    CHECK(write_file(legacy_path, "battery_saver=0\nbrightness=100\n"));
+    CHECK(config_store_reload_if_changed(&cs));
+    CHECK(!config_store_get_bool(&cs, "battery_saver", true));
+    CHECK(config_store_get_int(&cs, "brightness", 0) == 100);
+    CHECK(config_store_find(&cs, "theme") == NULL);     // replaced, not merged
+    CHECK(!config_store_reload_if_changed(&cs));
+
+    // a deleted file keeps the last table
+    remove(legacy_path);
+    CHECK(!config_store_reload_if_changed(&cs));
+    CHECK(config_store_get_int(&cs, "brightness", 0) == 100);
+    CHECK(write_file(legacy_path, legacy_text));
+}
+
+static void test_bad_files(void) {
+    static ConfigStore cs;
+    char path[160];
+    snprintf(path, sizeof(path), "%s/bad.json", dir);
+
+    // a bad escape: the keys before it are kept, but the load fails
+    CHECK(write_file(path, "{\"brightness\":70,\"comment\":\"C:\\path\",\"theme\":\"night\"}"));
+    CHECK(!config_store_load(&cs, path));
+    CHECK(cs.status == CONFIG_LOAD_SYNTAX && !cs.loaded);
+    CHECK(config_store_get_int(&cs, "brightness", 0) == 70);
+    CHECK(config_store_find(&cs, "theme") == NULL);
+
+    CHECK(write_file(path, "{\"name\":\"x\",\"colors\":{\"text\":\"#ffffff\""));
+    CHECK(!config_store_load(&cs, path) && cs.status == CONFIG_LOAD_SYNTAX);
+    CHECK(write_file(path, "{\"a\":1,}"));
+    CHECK(!config_store_load(&cs, path));
+    CHECK(write_file(path, "{\"a\":1.5e}"));
+    CHECK(!config_store_load(&cs, path));
+
+    // a file at the size limit was cut off by the read
+    static char big[CONFIG_FILE_MAX + 1];
+    memset(big, ' ', CONFIG_FILE_MAX);
+    big[0] = '{';
+    big[CONFIG_FILE_MAX - 1] = '}';
+    CHECK(write_file(path, big));
+    CHECK(!config_store_load(&cs, path) && cs.status == CONFIG_LOAD_TOO_BIG);
+
+    // values the table cannot hold load, but are counted
+    CHECK(write_file(path, "{\"list\":[1,2],\"none\":null,\"ratio\":0.5,\"ok\":true}"));
+    CHECK(config_store_load(&cs, path));
+    CHECK(cs.dropped == 3 && config_store_get_bool(&cs, "ok", false));
+
+    // an unchanged bad file is not parsed again
+    CHECK(write_file(path, "{\"a\":"));
+    CHECK(!config_store_load(&cs, path));
+    CHECK(!config_store_reload_if_changed(&cs));
+    remove(path);
+}
+
+static void report_rate(void) {
+    static ConfigStore cs;
+    config_store_load(&cs, legacy_path);
+    volatile int sink = 0;
+
+    const int table_n = 2000000, file_n = 20000;
+    double t0 = now_s();
+    for(int i = 0; i < table_n; i++) sink += config_store_get_bool(&cs, "request_overlay", false);
+    double table = table_n / (now_s() - t0);
+    t0 = now_s();
+    for(int i = 0; i < file_n; i++) sink += read_bool_config(legacy_path, "request_overlay", false);
+    double file = file_n / (now_s() - t0);
+    printf("lookups/s: table %.0f, read_bool_config %.0f (%.0fx)\n", table, file, table / file);
+}
+
+int main(void) {
+    snprintf(dir, sizeof(dir), "/tmp/config_test.XXXXXX");
+    if(!mkdtemp(dir)) {
+        fprintf(stderr, "cannot create a scratch directory in /tmp\n");
+        return 1;
+    }
+    snprintf(legacy_path, sizeof(legacy_path), "%s/config.txt", dir);
+    snprintf(json_path, sizeof(json_path), "%s/config.json", dir);
+    if(!write_file(legacy_path, legacy_text) || !write_file(json_path, json_text)) {
+        fprintf(stderr, "cannot write to %s\n", dir);
+        return 1;
+    }
+
+    test_legacy();
+    test_json();
+    test_reload();
+    test_bad_files();
+    report_rate();
+
+    remove(legacy_path);
+    remove(json_path);
+    rmdir(dir);
+    return check_done("config_test");
+}
@@ -0,0 +1,127 @@
+// cpu_load_sim.c
+// Replays a synthetic busy trace through the CPU-load estimator
+// (cpu_load.h) and compares what the idle probe measures with the load the
+// trace put on the core. Prints one CSV row per probe window, then the
+// error summary.
+//
+//   cpu_load_sim [--burst-us N] [--read-us N] <busy.trace>
+//
+// Trace lines are "<time_ms> <busy_pct>": from that time on, higher
+// priority threads hold the core busy_pct of the time, in bursts of
+// --burst-us (default 1000). While the core is free the probe reads the
+// clock every --read-us (default 1), as its spin loop would. The windows,
+// ring and rolling average are the ones the probe thread and
+// cpu_load_update() use. Exits non-zero if a window is off by more than
+// MAX_ERROR_PCT.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "platform.h"
+#include "cpu_load.h"
+
+#define MAX_STEPS     256
+#define MAX_ERROR_PCT 5.0f
+
+typedef struct {
+    u32 time_ms;
+    u32 busy_pct;
+} BusyStep;
+
+static BusyStep steps[MAX_STEPS];
+static int nsteps;
+static u32 burst_us = 1000;
+
+static int load_trace(const char* path) {
+    FILE* f = fopen(path, "r");
+    if(!f) return -1;
+    char line[128];
+    unsigned t, pct;
+    while(nsteps < MAX_STEPS && fgets(line, sizeof(line), f)) {
+        if(line[0] == '#' || sscanf(line, "%u %u", &t, &pct) != 2) continue;
+        steps[nsteps].time_ms = t;
+        steps[nsteps].busy_pct = pct > 100 ? 100 : pct;
+        nsteps++;
+    }
+    fclose(f);
+    return nsteps;
+}
+
+static u32 busy_pct_at(u64 t_us) {
+    int i = 0;
+    while(i + 1 < nsteps && steps[i + 1].time_ms * 1000ULL <= t_us) i++;
+    return steps[i].busy_pct;
+}
+
+// End of the burst covering t, or t if the core is free then. Bursts sit
+// at the start of every burst_us period.
+static u64 busy_until(u64 t_us) {
+    u64 period = t_us / burst_us * burst_us;
+    u64 end = period + (u64)burst_us * busy_pct_at(t_us) / 100;
+    return t_us < end ? end : t_us;
+}
+
+// Busy share of [from, to) as the trace defines it, in percent.
+static float true_load(u64 from, u64 to) {
+    u64 busy = 0;
+    for(u64 t = from; t < to; ) {
+        u64 next = (t / burst_us + 1) * burst_us;
+        if(next > to) next = to;
+        u64 end = t / burst_us * burst_us + (u64)burst_us * busy_pct_at(t) / 100;
+        if(end > t) busy += (end < next ? end : next) - t;
+        t = next;
+    }
+    return to > from ? 100.0f * busy / (to - from) : 0.0f;
+}
+
+int main(int argc, char** argv) {
+    u32 read_us = 1;
+    int arg = 1;
+    while(arg + 1 < argc && argv[arg][0] == '-') {
+        if(strcmp(argv[arg], "--burst-us") == 0) burst_us = (u32)atoi(argv[arg + 1]);
+        else if(strcmp(argv[arg], "--read-us") == 0) read_us = (u32)atoi(argv[arg + 1]);
+        else break;
+        arg += 2;
+    }
+    if(arg >= argc || !burst_us || !read_us) {
+        fprintf(stderr, "usage: %s [--burst-us N] [--read-us N] <busy.trace>\n", argv[0]);
+        return 2;
+    }
+    if(load_trace(argv[arg]) <= 0) {
+        fprintf(stderr, "cannot read busy trace %s\n", argv[arg]);
+        return 1;
+    }
+
+    static CpuCore core;
+    u64 end_us = steps[nsteps - 1].time_ms * 1000ULL;
+    float max_err = 0.0f, sum_err = 0.0f;
+    int windows = 0;
+    printf("time_ms,true_load,measured,avg\n");
+    for(u64 start = 0; start + CPU_LOAD_WINDOW_MS * 1000ULL <= end_us; start += CPU_LOAD_PERIOD_MS * 1000ULL) {
+        // the probe's spin loop: it only gets to read the clock while the
+        // core is free
+        IdleAccumulator acc;
+        u64 now = busy_until(start);
+        idle_acc_begin(&acc, now);
+        while(now - acc.start_us < CPU_LOAD_WINDOW_MS * 1000ULL) {
+            now = busy_until(now + read_us);
+            idle_acc_step(&acc, now);
+        }
+        CpuSample s = { (u32)(now / 1000), idle_acc_load(&acc) };
+        cpu_ring_push(&core.ring, s);
+        while(cpu_ring_pop(&core.ring, &s)) cpu_core_add(&core, s.load);
+
+        float expect = true_load(acc.start_us, acc.last_us);
+        float err = fabsf(s.load - expect);
+        if(err > max_err) max_err = err;
+        sum_err += err;
+        windows++;
+        printf("%lu,%.1f,%.1f,%.1f\n", (unsigned long)(start / 1000), expect, s.load, core.avg);
+    }
+
+    fprintf(stderr, "%d windows, mean error %.2f%%, max error %.2f%% (limit %.1f%%), %lu dropped\n",
+            windows, windows ? sum_err / windows : 0.0f, max_err, MAX_ERROR_PCT,
+            (unsigned long)core.ring.dropped);
+    return max_err <= MAX_ERROR_PCT ? 0 : 1;
+}
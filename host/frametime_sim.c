@@ -0,0 +1,118 @@
+// frametime_sim.c
+// Replays a synthetic frame-cost trace through the frame timer
+// (frametime.h) and checks its histogram statistics against exact values
+// computed from every recorded interval.
+//
+//   frametime_sim [--dump FILE] <frames.trace>
+//
+// Trace lines are "<frames> <cpu_us> <gpu_us>": that many frames, each
+// costing about the given CPU and GPU time (+-10%, deterministic). A frame
+// starts at the vblank after the previous one and is shown on the first
+// vblank after its GPU work ends, like a vsynced loop. Prints the overlay
+// line, the exact and histogram percentiles, and exits non-zero if they
+// differ by more than one bin or the missed-vblank count is wrong.
+// --dump writes frame_timer_dump() output to FILE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "platform.h"
+#include "frametime.h"
+
+#define MAX_FRAMES 65536
+
+static u32 intervals[MAX_FRAMES];
+static int nintervals;
+static u32 rng = 12345;
+
+// Cost with +-10% jitter.
+static u32 jitter(u32 us) {
+    rng = rng * 1103515245u + 12345u;
+    u32 spread = us / 5;
+    return spread ? us - us / 10 + (rng >> 8) % spread : us;
+}
+
+static int cmp_u32(const void* a, const void* b) {
+    u32 x = *(const u32*)a, y = *(const u32*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Same rank rule as frame_hist_percentile(), on the raw values.
+static u32 exact_percentile(const u32* sorted, int n, float p) {
+    if(n == 0) return 0;
+    u32 rank = (u32)((p / 100.0f) * (n - 1)) + 1;
+    return sorted[rank - 1];
+}
+
+int main(int argc, char** argv) {
+    const char* dump = NULL;
+    int arg = 1;
+    if(arg + 1 < argc && strcmp(argv[arg], "--dump") == 0) {
+        dump = argv[arg + 1];
+        arg += 2;
+    }
+    if(arg >= argc) {
+        fprintf(stderr, "usage: %s [--dump FILE] <frames.trace>\n", argv[0]);
+        return 2;
+    }
+    FILE* f = fopen(argv[arg], "r");
+    if(!f) {
+        fprintf(stderr, "cannot read frame trace %s\n", argv[arg]);
+        return 1;
+    }
+
+    static FrameTimer ft;
+    frame_timer_init(&ft);
+    u64 vblank = FT_VBLANK_US;
+    u32 missed = 0;
+    char line[128];
+    unsigned frames, cpu, gpu;
+    while(fgets(line, sizeof(line), f)) {
+        if(line[0] == '#' || sscanf(line, "%u %u %u", &frames, &cpu, &gpu) != 3) continue;
+        for(unsigned i = 0; i < frames && nintervals < MAX_FRAMES; i++) {
+            u64 begin = vblank;
+            u64 cpu_done = begin + jitter(cpu);
+            u64 gpu_done = cpu_done + jitter(gpu);
+            frame_timer_mark(&ft, FT_BEGIN, begin);
+            frame_timer_mark(&ft, FT_CPU_DONE, cpu_done);
+            frame_timer_mark(&ft, FT_GPU_DONE, gpu_done);
+            u64 shown = vblank + FT_VBLANK_US;
+            u32 late = 0;
+            for(; shown < gpu_done; shown += FT_VBLANK_US) late++;
+            // the timer starts measuring at the first vblank it sees
+            bool first = ft.last_vblank == 0;
+            frame_timer_end(&ft, shown, true);
+            if(!first) {
+                intervals[nintervals++] = (u32)(shown - vblank);
+                missed += late;
+            }
+            vblank = shown;
+        }
+    }
+    fclose(f);
+
+    char text[96];
+    frame_timer_format(&ft, text, sizeof(text));
+    printf("%s\n", text);
+
+    qsort(intervals, nintervals, sizeof(intervals[0]), cmp_u32);
+    static const float ps[] = { 50, 95, 99, 100 };
+    int bad = 0;
+    printf("percentile,exact_us,hist_us\n");
+    for(size_t i = 0; i < sizeof(ps) / sizeof(ps[0]); i++) {
+        u32 exact = exact_percentile(intervals, nintervals, ps[i]);
+        u32 hist = ps[i] < 100 ? frame_hist_percentile(&ft.interval, ps[i]) : ft.interval.max_us;
+        printf("p%g,%lu,%lu\n", ps[i], (unsigned long)exact, (unsigned long)hist);
+        if(hist < exact || hist - exact > FT_BIN_US) bad++;
+    }
+    printf("frames %d, missed vblanks %lu (expected %lu), fps %.1f\n", nintervals,
+           (unsigned long)ft.missed_vblanks, (unsigned long)missed, frame_timer_fps(&ft));
+    if(ft.missed_vblanks != missed) bad++;
+    if(ft.interval.count != (u32)nintervals) bad++;
+
+    if(dump && !frame_timer_dump(&ft, dump)) {
+        fprintf(stderr, "cannot write %s\n", dump);
+        return 1;
+    }
+    return bad ? 1 : 0;
+}
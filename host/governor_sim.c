@@ -0,0 +1,108 @@
+// governor_sim.c
+// Trace-driven simulator for the battery-saver governor.
+// Replays a recorded discharge curve through governor.h once per policy
+// config and reports the runtime each policy would reach.
+//
+//   governor_sim [--timeline] <trace> [config...]
+//
+// The trace gives the drain rate at full brightness. The backlight is
+// modelled as BACKLIGHT_SHARE of the total draw and scales linearly with
+// brightness; past the end of the trace its average rate is used.
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "platform.h"
+#include "config_store.h"
+#include "governor.h"
+
+#define STEP_MS          1000
+#define MAX_SIM_MS       (24u * 3600u * 1000u)
+#define BACKLIGHT_SHARE  0.45f
+
+// Battery percent of the trace at time t, linearly interpolated.
+static float trace_percent(u32 t) {
+    const SimSample* s = platform_sim.samples;
+    int n = platform_sim.count;
+    if(t <= s[0].time_ms) return s[0].battery;
+    for(int i = 1; i < n; i++) {
+        if(t <= s[i].time_ms) {
+            float f = (float)(t - s[i-1].time_ms) / (s[i].time_ms - s[i-1].time_ms);
+            return s[i-1].battery + f * (s[i].battery - s[i-1].battery);
+        }
+    }
+    return s[n-1].battery;
+}
+
+static float power_factor(int brightness) {
+    return (1.0f - BACKLIGHT_SHARE) + BACKLIGHT_SHARE * brightness / 100.0f;
+}
+
+static void simulate(const char* name, const GovConfig* cfg, bool timeline) {
+    static Governor gov;
+    governor_init(&gov, cfg);
+
+    u32 end = platform_sim_duration_ms();
+    float first = platform_sim.samples[0].battery;
+    float last = platform_sim.samples[platform_sim.count - 1].battery;
+    float avg_drain = end ? (first - last) / end * STEP_MS : 0.0f; // per step
+
+    float level = first;
+    u32 tier_ms[GOV_TIER_COUNT] = { 0 };
+    u32 t = 0;
+    while(level > 0.0f && t < MAX_SIM_MS) {
+        u8 shown = (u8)ceilf(level);
+        governor_update(&gov, t, shown);
+        const GovTierSettings* ts = governor_settings(&gov);
+        if(timeline && t % 60000 == 0)
+            printf("%s,%lu,%.2f,%s,%d,%.1f\n", name, (unsigned long)(t / 60000), level,
+                   governor_tier_name(gov.tier), ts->brightness, gov.runtime_min);
+
+        float drain = t + STEP_MS <= end ? trace_percent(t) - trace_percent(t + STEP_MS) : avg_drain;
+        if(drain < 0) drain = 0;
+        level -= drain * power_factor(ts->brightness);
+        tier_ms[gov.tier] += STEP_MS;
+        t += STEP_MS;
+    }
+
+    printf("%s: runtime %.1f min, normal %.1f / saver %.1f / critical %.1f min, %lu switches\n",
+           name, t / 60000.0f, tier_ms[GOV_NORMAL] / 60000.0f, tier_ms[GOV_SAVER] / 60000.0f,
+           tier_ms[GOV_CRITICAL] / 60000.0f, (unsigned long)gov.switches);
+}
+
+int main(int argc, char** argv) {
+    int arg = 1;
+    bool timeline = false;
+    if(arg < argc && strcmp(argv[arg], "--timeline") == 0) { timeline = true; arg++; }
+    if(arg >= argc) {
+        fprintf(stderr, "usage: %s [--timeline] <trace> [config...]\n", argv[0]);
+        return 2;
+    }
+    if(!platform_sim_load_trace(argv[arg])) {
+        fprintf(stderr, "cannot read trace %s\n", argv[arg]);
+        return 1;
+    }
+    arg++;
+    if(timeline) printf("policy,minute,level,tier,brightness,predicted_min\n");
+
+    GovConfig cfg;
+    // baseline: governor off, the old fixed full brightness
+    governor_config_defaults(&cfg);
+    cfg.enabled = false;
+    simulate("baseline", &cfg, timeline);
+
+    if(arg >= argc) {
+        governor_config_defaults(&cfg);
+        simulate("defaults", &cfg, timeline);
+    }
+    for(; arg < argc; arg++) {
+        static ConfigStore cs;
+        if(!config_store_load(&cs, argv[arg])) {
+            fprintf(stderr, "cannot read config %s\n", argv[arg]);
+            continue;
+        }
+        governor_config_load(&cfg, &cs);
+        simulate(argv[arg], &cfg, timeline);
+    }
+    return 0;
+}
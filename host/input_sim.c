@@ -0,0 +1,131 @@
+// input_sim.c
+// Replays a scripted key trace through the input sampler (input.h) and
+// prints the events it queues as CSV, then the repeat and latency summary.
+//
+//   input_sim [--frame-us N] <keys.trace> [config]
+//
+// Trace lines are "<time_ms> <keys>", keys joined by '+' ("RIGHT", "DOWN+A")
+// or '-' for none; '#' starts a comment. The held keys are sampled every
+// INPUT_SAMPLE_MS and a frame drains the queue every --frame-us (one 60 Hz
+// vblank by default), so the latency column is what the sampling and frame
+// pacing alone add. The config takes the input_repeat_* keys.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "platform.h"
+#include "config_store.h"
+#include "input.h"
+
+#define MAX_STEPS 1024
+#define FRAME_US_DEFAULT 16715    // 59.83 Hz
+
+typedef struct {
+    u32 time_ms;
+    u32 keys;
+} KeyStep;
+
+static const struct { const char* name; u32 bit; } key_names[] = {
+    { "A", KEY_A }, { "B", KEY_B }, { "X", KEY_X }, { "Y", KEY_Y },
+    { "L", KEY_L }, { "R", KEY_R }, { "START", KEY_START }, { "SELECT", KEY_SELECT },
+    { "UP", KEY_DUP }, { "DOWN", KEY_DDOWN }, { "LEFT", KEY_DLEFT }, { "RIGHT", KEY_DRIGHT },
+};
+
+static const char* key_name(u32 bit) {
+    for(size_t i = 0; i < sizeof(key_names) / sizeof(key_names[0]); i++)
+        if(key_names[i].bit == bit) return key_names[i].name;
+    return "?";
+}
+
+static bool parse_keys(char* s, u32* keys) {
+    *keys = 0;
+    if(strcmp(s, "-") == 0) return true;
+    for(char* tok = strtok(s, "+"); tok; tok = strtok(NULL, "+")) {
+        size_t i = 0;
+        while(i < sizeof(key_names) / sizeof(key_names[0]) && strcmp(key_names[i].name, tok) != 0) i++;
+        if(i == sizeof(key_names) / sizeof(key_names[0])) return false;
+        *keys |= key_names[i].bit;
+    }
+    return true;
+}
+
+static int load_keys(const char* path, KeyStep* steps) {
+    FILE* f = fopen(path, "r");
+    if(!f) return -1;
+    int n = 0;
+    char line[128];
+    while(n < MAX_STEPS && fgets(line, sizeof(line), f)) {
+        unsigned t;
+        char keys[96];
+        if(line[0] == '#' || sscanf(line, "%u %95s", &t, keys) != 2) continue;
+        if(!parse_keys(keys, &steps[n].keys)) {
+            fprintf(stderr, "%s: unknown key in \"%s\"\n", path, keys);
+            continue;
+        }
+        steps[n++].time_ms = t;
+    }
+    fclose(f);
+    return n;
+}
+
+int main(int argc, char** argv) {
+    int arg = 1;
+    u32 frame_us = FRAME_US_DEFAULT;
+    if(arg + 1 < argc && strcmp(argv[arg], "--frame-us") == 0) {
+        frame_us = (u32)atoi(argv[arg + 1]);
+        arg += 2;
+    }
+    if(arg >= argc || !frame_us) {
+        fprintf(stderr, "usage: %s [--frame-us N] <keys.trace> [config]\n", argv[0]);
+        return 2;
+    }
+    static KeyStep steps[MAX_STEPS];
+    int n = load_keys(argv[arg], steps);
+    if(n <= 0) {
+        fprintf(stderr, "cannot read key trace %s\n", argv[arg]);
+        return 1;
+    }
+
+    InputConfig cfg;
+    input_config_defaults(&cfg, KEY_UP | KEY_DOWN | KEY_LEFT | KEY_RIGHT);
+    if(arg + 1 < argc) {
+        static ConfigStore cs;
+        if(!config_store_load(&cs, argv[arg + 1])) {
+            fprintf(stderr, "cannot read config %s\n", argv[arg + 1]);
+            return 1;
+        }
+        input_config_load(&cfg, &cs);
+    }
+    static Input in;
+    input_init(&in, &cfg);
+
+    u64 end_us = steps[n - 1].time_ms * 1000ULL;
+    u64 next_frame = frame_us;
+    u32 presses = 0, repeats = 0;
+    int step = 0;
+    printf("time_ms,event,key,repeat,frame_ms,latency_ms\n");
+    for(u64 t = 0; t <= end_us; t += INPUT_SAMPLE_MS * 1000) {
+        while(step + 1 < n && steps[step + 1].time_ms * 1000ULL <= t) step++;
+        input_sample(&in, t, steps[step].keys);
+        if(t + INPUT_SAMPLE_MS * 1000 <= next_frame) continue;
+
+        // a frame: drain everything queued so far and show it at the vblank
+        InputEvent e;
+        while(input_next(&in, &e)) {
+            static const char* types[] = { "press", "repeat", "release" };
+            if(e.type == INPUT_PRESS) presses++;
+            if(e.type == INPUT_REPEAT) repeats++;
+            printf("%.1f,%s,%s,%u,%.1f,%.1f\n", e.time_us / 1000.0, types[e.type], key_name(e.key),
+                   (unsigned)e.repeat, next_frame / 1000.0, (next_frame - e.time_us) / 1000.0);
+        }
+        input_frame_end(&in, true);
+        input_vblank(&in, next_frame);
+        next_frame += frame_us;
+    }
+
+    char line[64];
+    input_format_latency(&in, line, sizeof(line));
+    fprintf(stderr, "%lu presses, %lu repeats, %lu dropped; %s\n", (unsigned long)presses,
+            (unsigned long)repeats, (unsigned long)in.dropped, line);
+    return 0;
+}
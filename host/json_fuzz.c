@@ -0,0 +1,228 @@
+// json_fuzz.c
+// Fuzz target for the JSON tokenizer (json_parser.h) and the config store
+// parsers built on it (config_store.h). For every input it checks that
+//   - the tokenizer stays inside the buffer, keeps its depth in range,
+//     terminates strings and stops for good at the end or the first error;
+//   - a document that parses with nothing dropped survives a round trip
+//     through config_writer_format() unchanged, which is what lets the
+//     config writer rewrite a file without losing keys.
+// A violated check prints the input and aborts.
+//
+// Built as is, it is a self-contained mutation fuzzer seeded with typical
+// config and theme files (and any files given):
+//
+//   json_fuzz [--iters N] [--seed S] [seed-file...]
+//
+// `make fuzz` builds it with AddressSanitizer and UBSan and runs it. With
+// -DJSON_FUZZ_LIBFUZZER only LLVMFuzzerTestOneInput() is compiled, for
+// clang -fsanitize=fuzzer.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "config_store.h"
+#include "config_writer.h"
+#include "json_parser.h"
+
+static const char* fuzz_input;
+static size_t fuzz_len;
+
+static void fuzz_fail(const char* what) {
+    fprintf(stderr, "json_fuzz: %s\ninput (%lu bytes): \"", what, (unsigned long)fuzz_len);
+    for(size_t i = 0; i < fuzz_len; i++) {
+        unsigned char c = (unsigned char)fuzz_input[i];
+        if(c == '"' || c == '\\') fprintf(stderr, "\\%c", c);
+        else if(c >= 0x20 && c < 0x7F) fputc(c, stderr);
+        else fprintf(stderr, "\\x%02x", c);
+    }
+    fprintf(stderr, "\"\n");
+    abort();
+}
+
+#define FUZZ_CHECK(cond) do { if(!(cond)) fuzz_fail("check failed: " #cond); } while(0)
+
+static void fuzz_tokenizer(const uint8_t* data, size_t size) {
+    static char buf[CONFIG_FILE_MAX + 1];
+    memcpy(buf, data, size);
+    buf[size] = '\0';
+    JsonLexer lx;
+    json_lexer_init(&lx, buf, size);
+    JsonToken t;
+    size_t tokens = 0;
+    do {
+        t = json_next(&lx);
+        FUZZ_CHECK(lx.p >= buf && lx.p <= buf + size);
+        FUZZ_CHECK(lx.depth >= 0 && lx.depth <= JSON_MAX_DEPTH);
+        if(t == JSON_KEY || t == JSON_STRING) {
+            FUZZ_CHECK(lx.str >= buf && lx.str + lx.len < buf + size);
+            FUZZ_CHECK(lx.str[lx.len] == '\0');
+        } else if(t == JSON_NUMBER) {
+            FUZZ_CHECK(lx.len > 0 && lx.str >= buf && lx.str + lx.len <= buf + size);
+        }
+        FUZZ_CHECK(++tokens <= size + 1);
+    } while(t != JSON_DONE && t != JSON_ERROR);
+    FUZZ_CHECK(t != JSON_DONE || lx.depth == 0);
+    FUZZ_CHECK(t != JSON_ERROR || lx.pos <= size);
+    FUZZ_CHECK(json_next(&lx) == t);
+}
+
+static bool entries_equal(const ConfigEntry* a, const ConfigEntry* b) {
+    if(a->type != b->type) return false;
+    if(a->type == CONFIG_BOOL) return a->v.b == b->v.b;
+    if(a->type == CONFIG_INT) return a->v.i == b->v.i;
+    return strcmp(a->v.s, b->v.s) == 0;
+}
+
+static void fuzz_round_trip(const uint8_t* data, size_t size) {
+    static char buf[CONFIG_FILE_MAX + 1];
+    static char out[CONFIG_FILE_MAX];
+    static ConfigStore cs, again;
+    memcpy(buf, data, size);
+    buf[size] = '\0';
+    config_store_clear(&cs);
+    if(!config_store_parse_any(&cs, buf, size) || cs.dropped) return;
+
+    int len = config_writer_format(&cs, out, sizeof(out));
+    if(len < 0) return;       // too big to write; the writer gives up safely
+    config_store_clear(&again);
+    FUZZ_CHECK(config_store_parse_json(&again, out, (size_t)len));
+    FUZZ_CHECK(again.dropped == 0);
+    FUZZ_CHECK(again.count == cs.count);
+    for(int i = 0; i < CONFIG_STORE_SLOTS; i++) {
+        const ConfigEntry* e = &cs.slots[i];
+        if(e->type == CONFIG_NONE) continue;
+        const ConfigEntry* r = config_store_find(&again, e->key);
+        FUZZ_CHECK(r && entries_equal(e, r));
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if(size > CONFIG_FILE_MAX) return 0;
+    fuzz_input = (const char*)data;
+    fuzz_len = size;
+    fuzz_tokenizer(data, size);
+    fuzz_round_trip(data, size);
+    return 0;
+}
+
+#ifndef JSON_FUZZ_LIBFUZZER
+
+static const char* seeds[] = {
+    "{\n  \"battery_saver\": true,\n  \"brightness\": 80,\n  \"theme\": \"night\",\n"
+    "  \"gov\": {\"enabled\": false, \"target_min\": 180, \"saver\": {\"brightness\": 40}}\n}\n",
+    "{\"name\":\"night\",\"colors\":{\"background\":\"#000010c0\",\"text\":\"#b0b0d0\"},"
+    "\"thresholds\":{\"low_pulse\":15},\"scales\":{\"title\":1.2}}",
+    "{\"a\":[1,2,{\"b\":[]}],\"c\":null,\"d\":-0.5e+3,\"e\":\"\\u00e9\\n\\\"x\\\"\",\"f\":{}}",
+    "battery_saver=1\nbrightness=70\ntheme=night\nperf_logging=false\n",
+    "{\"\":{\"a\":1},\"a.b\":2,\"a\":{\"c\":\"\\ud800\"}}",
+};
+
+// Bytes and fragments that steer mutations toward the grammar's edges.
+static const char* dict[] = {
+    "{", "}", "[", "]", ",", ":", "\"", "\\", "\\u", "\\u0000", "true", "false", "null",
+    "-", "0", "1.5", "e", "E+", ".", "=", "\n", " ", "{\"k\":", "\"k\":1,", "99999999999",
+};
+
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state >> 32);
+}
+
+static size_t mutate(uint8_t* d, size_t n, size_t cap) {
+    size_t at = n ? rng() % n : 0;
+    switch(rng() % 6) {
+        case 0:               // flip a bit
+            if(n) d[at] ^= (uint8_t)(1u << (rng() % 8));
+            break;
+        case 1:               // random byte
+            if(n) d[at] = (uint8_t)rng();
+            break;
+        case 2: {             // insert a dictionary fragment
+            const char* s = dict[rng() % (sizeof(dict) / sizeof(dict[0]))];
+            size_t k = strlen(s);
+            if(n + k > cap) break;
+            memmove(d + at + k, d + at, n - at);
+            memcpy(d + at, s, k);
+            n += k;
+            break;
+        }
+        case 3: {             // delete a range
+            size_t k = n - at ? 1 + rng() % (n - at < 8 ? n - at : 8) : 0;
+            memmove(d + at, d + at + k, n - at - k);
+            n -= k;
+            break;
+        }
+        case 4: {             // duplicate a range
+            size_t k = n - at ? 1 + rng() % (n - at < 16 ? n - at : 16) : 0;
+            if(n + k > cap) break;
+            memmove(d + at + k, d + at, n - at);
+            n += k;
+            break;
+        }
+        default:              // truncate
+            n = at;
+            break;
+    }
+    return n;
+}
+
+static uint8_t corpus[64][CONFIG_FILE_MAX];
+static size_t corpus_len[64];
+static int corpus_count;
+
+static void add_seed(const void* data, size_t n) {
+    if(corpus_count == 64) return;
+    if(n > CONFIG_FILE_MAX) n = CONFIG_FILE_MAX;
+    memcpy(corpus[corpus_count], data, n);
+    corpus_len[corpus_count++] = n;
+}
+
+int main(int argc, char** argv) {
+    unsigned long iters = 200000;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--iters") == 0 && i + 1 < argc) {
+            iters = strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            rng_state = strtoull(argv[++i], NULL, 10) | 1;
+        } else if(argv[i][0] != '-') {
+            static uint8_t file[CONFIG_FILE_MAX];
+            FILE* f = fopen(argv[i], "rb");
+            if(!f) {
+                fprintf(stderr, "cannot read %s\n", argv[i]);
+                return 1;
+            }
+            add_seed(file, fread(file, 1, sizeof(file), f));
+            fclose(f);
+        } else {
+            fprintf(stderr, "usage: %s [--iters N] [--seed S] [seed-file...]\n", argv[0]);
+            return 2;
+        }
+    }
+    for(size_t i = 0; i < sizeof(seeds) / sizeof(seeds[0]); i++) add_seed(seeds[i], strlen(seeds[i]));
+
+    static uint8_t input[CONFIG_FILE_MAX];
+    unsigned long parsed = 0;
+    for(unsigned long it = 0; it < iters; it++) {
+        int s = rng() % corpus_count;
+        size_t n = corpus_len[s];
+        memcpy(input, corpus[s], n);
+        for(int m = 1 + rng() % 8; m > 0; m--) n = mutate(input, n, sizeof(input));
+        LLVMFuzzerTestOneInput(input, n);
+
+        static ConfigStore cs;
+        static char text[CONFIG_FILE_MAX + 1];
+        memcpy(text, input, n);
+        text[n] = '\0';
+        config_store_clear(&cs);
+        if(config_store_parse_any(&cs, text, n) && !cs.dropped) parsed++;
+    }
+    printf("json_fuzz: %lu inputs, %lu parsed cleanly, no failures\n", iters, parsed);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,65 @@
+// telemetry_decode.c
+// Converts a perf_log.bin written by telemetry.h into CSV.
+// Each row carries the session it was logged in (counting from 1) and its
+// wall-clock time, derived from the session record; time_ms restarts with
+// every session. Version 1 logs have no session records: everything is
+// session 1 and wall_s is left empty.
+//
+//   telemetry_decode <perf_log.bin> [out.csv]
+
+#include <stdio.h>
+#include "telemetry.h"
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s <perf_log.bin> [out.csv]\n", argv[0]);
+        return 2;
+    }
+    FILE* in = fopen(argv[1], "rb");
+    if(!in) {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+    FILE* out = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if(!out) {
+        fprintf(stderr, "cannot create %s\n", argv[2]);
+        fclose(in);
+        return 1;
+    }
+
+    TelemetryHeader h;
+    if(fread(&h, sizeof(h), 1, in) != 1 || h.magic != TELEMETRY_MAGIC) {
+        fprintf(stderr, "%s: not a telemetry log\n", argv[1]);
+        return 1;
+    }
+    if((h.version != TELEMETRY_VERSION && h.version != 1) || h.record_size != sizeof(TelemetryRecord)) {
+        fprintf(stderr, "%s: unsupported version %u (record size %u)\n",
+                argv[1], (unsigned)h.version, (unsigned)h.record_size);
+        return 1;
+    }
+
+    fprintf(out, "session,wall_s,time_ms,battery,brightness,cpu_percent,free_mem,frame_us\n");
+    TelemetryRecord r;
+    unsigned long n = 0;
+    u32 session = h.version == 1 ? 1 : 0;
+    u32 start_ms = 0, start_wall = 0;
+    while(fread(&r, sizeof(r), 1, in) == 1) {
+        if(r.cpu_x10 == TELEMETRY_SESSION) {
+            session++;
+            start_ms = r.time_ms;
+            start_wall = r.free_mem;
+            continue;
+        }
+        char wall[16] = "";
+        if(start_wall) snprintf(wall, sizeof(wall), "%lu", (unsigned long)(start_wall + (r.time_ms - start_ms) / 1000));
+        fprintf(out, "%lu,%s,%lu,%u,%u,%.1f,%lu,%lu\n", (unsigned long)session, wall,
+                (unsigned long)r.time_ms, r.battery, r.brightness, r.cpu_x10 / 10.0f,
+                (unsigned long)r.free_mem, (unsigned long)r.frame_us);
+        n++;
+    }
+    fprintf(stderr, "%lu records in %lu sessions\n", n, (unsigned long)session);
+
+    fclose(in);
+    if(out != stdout) fclose(out);
+    return 0;
+}
@@ -0,0 +1,117 @@
+// telemetry_test.c
+// Appending to the telemetry log (telemetry.h): every session starts with
+// a session record and every record stays aligned, also after a crash
+// left half a record at the end. Version 1 logs are appended to, anything
+// else is started over, and a log that cannot be written is refused.
+//
+//   telemetry_test
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "telemetry.h"
+#include "check.h"
+
+static char dir[64];
+static char path[128];
+
+static long file_size(void) {
+    FILE* f = fopen(path, "rb");
+    if(!f) return -1;
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fclose(f);
+    return n;
+}
+
+static bool log_session(int records, u32 first) {
+    if(!telemetry_start(path)) return false;
+    for(int i = 0; i < records; i++) {
+        TelemetryRecord r = { first + (u32)i, 0, 16667, 100, 80, 50 };
+        telemetry_log(&r);
+    }
+    telemetry_stop();
+    return true;
+}
+
+// Reads the log back: header version, record count, sessions seen, and
+// whether every data record carries the time_ms sequence it was logged
+// with (1000, 1001, ... per session).
+static void read_log(int* version, int* records, int* sessions, bool* aligned) {
+    FILE* f = fopen(path, "rb");
+    TelemetryHeader h;
+    *version = *records = *sessions = 0;
+    *aligned = f && fread(&h, sizeof(h), 1, f) == 1 && h.magic == TELEMETRY_MAGIC;
+    if(!*aligned) {
+        if(f) fclose(f);
+        return;
+    }
+    *version = h.version;
+    TelemetryRecord r;
+    u32 expect = 0;
+    while(fread(&r, sizeof(r), 1, f) == 1) {
+        (*records)++;
+        if(r.cpu_x10 == TELEMETRY_SESSION) {
+            (*sessions)++;
+            expect = 1000;
+            continue;
+        }
+        if(expect && (r.time_ms != expect++ || r.frame_us != 16667 || r.battery != 80)) *aligned = false;
+    }
+    fclose(f);
+}
+
+int main(void) {
+    snprintf(dir, sizeof(dir), "/tmp/telemetry_test.XXXXXX");
+    if(!mkdtemp(dir)) {
+        fprintf(stderr, "cannot create a scratch directory in /tmp\n");
+        return 1;
+    }
+    snprintf(path, sizeof(path), "%s/perf_log.bin", dir);
+    int version, records, sessions;
+    bool aligned;
+
+    CHECK(log_session(10, 1000));
+    CHECK(file_size() == (long)(sizeof(TelemetryHeader) + 11 * sizeof(TelemetryRecord)));
+
+    // a crash in the middle of a record
+    FILE* f = fopen(path, "ab");
+    fwrite("\x01\x02\x03\x04\x05\x06\x07", 7, 1, f);
+    fclose(f);
+    CHECK(log_session(5, 1000));
+    read_log(&version, &records, &sessions, &aligned);
+    CHECK(version == TELEMETRY_VERSION && records == 17 && sessions == 2 && aligned);
+
+    // a version 1 log keeps its header and its records
+    f = fopen(path, "wb");
+    TelemetryHeader h = { TELEMETRY_MAGIC, 1, sizeof(TelemetryRecord), 0, 0 };
+    fwrite(&h, sizeof(h), 1, f);
+    for(u32 i = 0; i < 3; i++) {
+        TelemetryRecord r = { i, 0, 16667, 100, 80, 50 };
+        fwrite(&r, sizeof(r), 1, f);
+    }
+    fclose(f);
+    CHECK(log_session(2, 1000));
+    read_log(&version, &records, &sessions, &aligned);
+    CHECK(version == 1 && records == 6 && sessions == 1 && aligned);
+
+    // anything else is started over
+    f = fopen(path, "wb");
+    fputs("not a log", f);
+    fclose(f);
+    CHECK(log_session(2, 1000));
+    read_log(&version, &records, &sessions, &aligned);
+    CHECK(version == TELEMETRY_VERSION && records == 3 && sessions == 1 && aligned);
+
+    // nowhere to write: no session is started
+    if(access("/dev/full", W_OK) == 0) {
+        snprintf(path, sizeof(path), "/dev/full");
+        CHECK(!telemetry_start(path) && !telemetry_active());
+        snprintf(path, sizeof(path), "%s/perf_log.bin", dir);
+    }
+
+    remove(path);
+    rmdir(dir);
+    return check_done("telemetry_test");
+}
@@ -0,0 +1,120 @@
+// theme_compile.c
+// Compiles an editable theme source (JSON) into the binary blob theme.h
+// loads on the console. Anything the source leaves out keeps the default.
+//
+//   theme_compile <theme.json> <theme.bin>
+//
+//   {
+//     "name": "night",
+//     "colors": { "background": "#000020c0", "text": "#d0d0ff" },
+//     "thresholds": { "battery_high": 50, "battery_mid": 20, "low_pulse": 10 },
+//     "layout": { "battery_bar": "50 50 200 30", "cpu_text": "50 145" },
+//     "scales": { "title": 1.5, "stats": 0.6 }
+//   }
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "config_store.h"
+#include "theme.h"
+
+static const char* color_names[THEME_COLOR_COUNT] = {
+    "background", "text", "battery_high", "battery_mid", "battery_low", "battery_outline",
+    "saver_on", "saver_off", "cpu_bar", "fps_bar", "low_pulse"
+};
+static const char* rect_names[THEME_RECT_COUNT] = {
+    "title", "battery_bar", "battery_text", "saver", "saver_text",
+    "cpu_bar", "cpu_text", "fps_bar", "fps_text"
+};
+static const char* scale_names[THEME_SCALE_COUNT] = { "title", "battery", "saver", "stats" };
+
+static int find_name(const char* const* names, int n, const char* s) {
+    for(int i = 0; i < n; i++)
+        if(strcmp(names[i], s) == 0) return i;
+    return -1;
+}
+
+// "#rrggbb" or "#rrggbbaa"
+static bool parse_color(const char* s, u32* out) {
+    unsigned r, g, b, a = 255;
+    size_t n = strlen(s);
+    if(s[0] != '#' || (n != 7 && n != 9)) return false;
+    if(sscanf(s + 1, "%2x%2x%2x", &r, &g, &b) != 3) return false;
+    if(n == 9 && sscanf(s + 7, "%2x", &a) != 1) return false;
+    *out = THEME_RGBA(r, g, b, a);
+    return true;
+}
+
+static bool parse_scale(const ConfigEntry* e, float* out) {
+    if(e->type == CONFIG_INT) { *out = (float)e->v.i; return true; }
+    if(e->type != CONFIG_STRING) return false;
+    char* end;
+    *out = strtof(e->v.s, &end);
+    return *e->v.s && *end == '\0';
+}
+
+static bool apply_key(Theme* t, const ConfigEntry* e) {
+    const char* k = e->key;
+    const char* dot = strchr(k, '.');
+    const char* leaf = dot ? dot + 1 : k;
+    int i;
+    if(strcmp(k, "name") == 0) {
+        if(e->type != CONFIG_STRING || strlen(e->v.s) >= THEME_NAME_LEN) return false;
+        snprintf(t->name, sizeof(t->name), "%s", e->v.s);
+        return true;
+    }
+    if(strncmp(k, "colors.", 7) == 0 && (i = find_name(color_names, THEME_COLOR_COUNT, leaf)) >= 0)
+        return e->type == CONFIG_STRING && parse_color(e->v.s, &t->color[i]);
+    if(strncmp(k, "thresholds.", 11) == 0) {
+        if(e->type != CONFIG_INT || e->v.i < 0 || e->v.i > 100) return false;
+        if(strcmp(leaf, "battery_high") == 0) { t->battery_high_pct = e->v.i; return true; }
+        if(strcmp(leaf, "battery_mid") == 0) { t->battery_mid_pct = e->v.i; return true; }
+        if(strcmp(leaf, "low_pulse") == 0) { t->low_pulse_pct = e->v.i; return true; }
+        return false;
+    }
+    if(strncmp(k, "layout.", 7) == 0 && (i = find_name(rect_names, THEME_RECT_COUNT, leaf)) >= 0) {
+        int x, y, w = t->rect[i].w, h = t->rect[i].h;
+        if(e->type != CONFIG_STRING) return false;
+        int n = sscanf(e->v.s, "%d %d %d %d", &x, &y, &w, &h);
+        if(n != 2 && n != 4) return false;
+        t->rect[i] = (ThemeRect){ (s16)x, (s16)y, (s16)w, (s16)h };
+        return true;
+    }
+    if(strncmp(k, "scales.", 7) == 0 && (i = find_name(scale_names, THEME_SCALE_COUNT, leaf)) >= 0)
+        return parse_scale(e, &t->scale[i]);
+    return false;
+}
+
+int main(int argc, char** argv) {
+    if(argc != 3) {
+        fprintf(stderr, "usage: %s <theme.json> <theme.bin>\n", argv[0]);
+        return 2;
+    }
+    static ConfigStore src;
+    if(!config_store_load(&src, argv[1])) {
+        char why[48];
+        config_store_format_status(&src, why, sizeof(why));
+        fprintf(stderr, "%s: %s\n", argv[1], why);
+        return 1;
+    }
+
+    Theme t;
+    theme_default(&t);
+    int errors = 0;
+    for(int i = 0; i < CONFIG_STORE_SLOTS; i++) {
+        const ConfigEntry* e = &src.slots[i];
+        if(e->type == CONFIG_NONE || apply_key(&t, e)) continue;
+        fprintf(stderr, "%s: bad or unknown key '%s'\n", argv[1], e->key);
+        errors++;
+    }
+    if(errors) return 1;
+    if(t.battery_mid_pct > t.battery_high_pct) {
+        fprintf(stderr, "%s: battery_mid above battery_high\n", argv[1]);
+        return 1;
+    }
+    if(!theme_save(&t, argv[2])) {
+        fprintf(stderr, "cannot write %s\n", argv[2]);
+        return 1;
+    }
+    printf("%s: theme '%s', %u bytes\n", argv[2], t.name, (unsigned)sizeof(t));
+    return 0;
+}
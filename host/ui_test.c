@@ -0,0 +1,192 @@
+// ui_test.c
+// Headless checks of the table-driven settings pages (ui_page.h): the
+// layout stays on the top screen and inside the draw list, and input can
+// always leave a page, in particular one whose only widget is a slider that
+// takes Left/Right. The pages copy the shapes of enhanced_settings'.
+//
+//   ui_test
+
+#include <stdio.h>
+#include <string.h>
+#include "ui_page.h"
+#include "check.h"
+
+enum { PAGE_MAIN = 0, PAGE_DISPLAY, PAGE_POWER, PAGE_STATS, PAGE_ADVANCED, PAGE_COUNT };
+
+static bool saver;
+static int brightness = 50, batt = 80, snapshot;
+static int changes;
+
+static void text_line(const UiWidget* w, char* buf, size_t n) {
+    snprintf(buf, n, "line %d: 12345 KB of 67890 KB", w->arg);
+}
+
+static void on_change(UiApp* app, UiWidget* w) {
+    (void)app; (void)w;
+    changes++;
+}
+
+static void on_open_display(UiApp* app, UiWidget* w) {
+    (void)w;
+    ui_goto_page(app, PAGE_DISPLAY);
+}
+
+static UiPage pages[PAGE_COUNT] = {
+    [PAGE_MAIN] = { .tab = "[Main]  (L/R to change)", .title = "Overview", .widgets = {
+        { .kind = UI_INFO, .text = text_line },
+        { .kind = UI_INFO, .text = text_line },
+        { .kind = UI_ACTION, .label = "Display settings", .on_change = on_open_display },
+        { .kind = UI_ACTION, .label = "Request overlay launch", .on_change = on_change },
+    } },
+    [PAGE_DISPLAY] = { .tab = "[Display]  (L/R to change)", .title = "Display Settings", .widgets = {
+        { .kind = UI_SLIDER, .label = "Brightness", .value = &brightness,
+          .min = 0, .max = 100, .step = 10, .flags = UI_F_EDIT, .on_change = on_change },
+    } },
+    [PAGE_POWER] = { .tab = "[Power]  (L/R to change)", .title = "Power & Battery", .widgets = {
+        { .kind = UI_TOGGLE, .label = "Battery Saver", .flag = &saver, .on_change = on_change },
+        { .kind = UI_SLIDER, .label = "Battery level", .value = &batt, .min = 0, .max = 100 },
+        { .kind = UI_INFO, .text = text_line },
+    } },
+    [PAGE_STATS] = { .tab = "[Performance]  (L/R to change)", .title = "Performance", .widgets = {
+        { .kind = UI_INFO, .text = text_line, .arg = 0 },
+        { .kind = UI_INFO, .text = text_line, .arg = 1 },
+        { .kind = UI_TOGGLE, .label = "Overlay telemetry log", .flag = &saver },
+        { .kind = UI_INFO, .text = text_line, .arg = 2, .flags = UI_F_SMALL },
+        { .kind = UI_INFO, .text = text_line, .arg = 3, .flags = UI_F_SMALL },
+        { .kind = UI_INFO, .text = text_line, .arg = 4, .flags = UI_F_SMALL },
+        { .kind = UI_INFO, .text = text_line, .arg = 5, .flags = UI_F_SMALL },
+        { .kind = UI_INFO, .text = text_line, .arg = 6, .flags = UI_F_SMALL },
+        { .kind = UI_INFO, .text = text_line, .arg = 7, .flags = UI_F_SMALL },
+    } },
+    [PAGE_ADVANCED] = { .tab = "[Advanced]  (L/R to change)", .title = "Advanced", .widgets = {
+        { .kind = UI_INFO, .text = text_line, .flags = UI_F_SMALL },
+        { .kind = UI_SLIDER, .label = "Snapshot", .text = text_line,
+          .value = &snapshot, .min = 0, .max = 15, .step = 1, .flags = UI_F_EDIT },
+        { .kind = UI_ACTION, .label = "Restore selected snapshot", .on_change = on_change },
+        { .kind = UI_ACTION, .label = "Delete selected snapshot", .on_change = on_change },
+        { .kind = UI_ACTION, .label = "Prune to the newest 4", .on_change = on_change },
+        { .kind = UI_ACTION, .label = "Quick save to config (writes now)", .on_change = on_change },
+    } },
+};
+static UiApp ui = { "Enhanced Settings", pages, PAGE_COUNT, PAGE_MAIN, 0, false };
+static UiDrawList drawList;
+
+static void test_layout(void) {
+    ui_layout(&ui);
+    for(int p = 0; p < PAGE_COUNT; p++) {
+        UiPage* pg = &pages[p];
+        int slots = 0;
+        float prev = 0;
+        for(int i = 0; i < pg->count; i++) {
+            UiWidget* w = &pg->widgets[i];
+            float bottom = w->y + UI_LINE_H * w->scale;
+            if(w->kind == UI_SLIDER) bottom += UI_SLIDER_H + 4;
+            if(bottom > UI_SCREEN_H || w->y < prev) printf("page %d widget %d at y %.1f..%.1f\n", p, i, w->y, bottom);
+            CHECK(w->y >= prev && bottom <= UI_SCREEN_H);
+            prev = bottom;
+            if(w->slot >= 0) CHECK(w->slot == slots++);
+        }
+        CHECK(slots <= UI_MAX_SLOTS);
+        CHECK(strstr(pg->tab, "Left/Right") == NULL);
+
+        // every page fits the draw list with the help box up
+        ui.page = p;
+        ui.help = true;
+        ui_emit(&ui, &drawList);
+        CHECK(drawList.rect_count < UI_MAX_RECTS && drawList.text_count < UI_MAX_TEXTS);
+        for(int i = 0; i < drawList.rect_count; i++)
+            CHECK(drawList.rects[i].x + drawList.rects[i].w <= UI_SCREEN_W);
+        CHECK(ui_batch_breaks(&drawList) <= 2 * ui_layer_count(&drawList) - 1);
+    }
+    ui.help = false;
+    CHECK(pages[PAGE_DISPLAY].focusable == 1);
+    CHECK(pages[PAGE_POWER].focusable == 1);
+    CHECK(pages[PAGE_ADVANCED].focusable == 5);
+}
+
+// Presses keys (libctru bits) through the same mapping the app uses.
+static bool press(u32 keys) {
+    return ui_input(&ui, ui_keys(keys));
+}
+
+static void test_slider_page(void) {
+    ui_goto_page(&ui, PAGE_MAIN);
+    press(KEY_DDOWN);
+    press(KEY_DDOWN);                  // no further than the last action
+    CHECK(ui.focus == 1);
+    press(KEY_DUP);
+    press(KEY_A);                      // "Display settings"
+    CHECK(ui.page == PAGE_DISPLAY && ui_focused(&ui)->value == &brightness);
+
+    // Left/Right edit the slider and stay on the page
+    changes = 0;
+    press(KEY_DRIGHT);
+    press(KEY_CPAD_RIGHT);
+    CHECK(ui.page == PAGE_DISPLAY && brightness == 70 && changes == 2);
+    for(int i = 0; i < 20; i++) press(KEY_DLEFT);
+    CHECK(ui.page == PAGE_DISPLAY && brightness == 0 && changes == 9);
+    press(KEY_DUP);
+    press(KEY_DDOWN);
+    CHECK(ui.page == PAGE_DISPLAY && ui.focus == 0);
+
+    // L/R and ZL/ZR leave it either way
+    press(KEY_R);
+    CHECK(ui.page == PAGE_POWER);
+    press(KEY_L);
+    CHECK(ui.page == PAGE_DISPLAY);
+    press(KEY_ZL);
+    CHECK(ui.page == PAGE_MAIN);
+    press(KEY_ZR);
+    CHECK(ui.page == PAGE_DISPLAY && brightness == 0);
+
+    // a page turn wins over a slider edit in the same frame
+    press(KEY_DRIGHT | KEY_R);
+    CHECK(ui.page == PAGE_POWER && brightness == 0);
+}
+
+static void test_every_page_reachable(void) {
+    for(int start = 0; start < PAGE_COUNT; start++) {
+        for(int focus = 0; focus < 8; focus++) {
+            ui_goto_page(&ui, start);
+            for(int i = 0; i < focus; i++) press(KEY_DDOWN);
+            bool seen[PAGE_COUNT] = { false };
+            for(int i = 0; i < PAGE_COUNT; i++) {
+                seen[ui.page] = true;
+                press(KEY_R);
+            }
+            CHECK(ui.page == start);
+            for(int p = 0; p < PAGE_COUNT; p++) CHECK(seen[p]);
+        }
+    }
+
+    // without a slider in focus Left/Right still turn the page
+    ui_goto_page(&ui, PAGE_POWER);
+    press(KEY_DRIGHT);
+    CHECK(ui.page == PAGE_STATS);
+    press(KEY_DLEFT);
+    CHECK(ui.page == PAGE_POWER && batt == 80);
+    ui_goto_page(&ui, PAGE_ADVANCED);
+    press(KEY_DDOWN);                  // off the snapshot list
+    press(KEY_DRIGHT);
+    CHECK(ui.page == PAGE_MAIN);
+}
+
+static void test_help(void) {
+    press(KEY_SELECT);
+    ui_emit(&ui, &drawList);
+    bool found = false;
+    for(int i = 0; i < drawList.text_count; i++)
+        if(drawList.texts[i].str && strstr(drawList.texts[i].str, "L/R: page")) found = true;
+    CHECK(ui.help && found);
+    press(KEY_SELECT);
+    CHECK(!ui.help);
+    CHECK(!press(0));
+}
+
+int main(void) {
+    test_layout();
+    test_slider_page();
+    test_every_page_reachable();
+    test_help();
+    return check_done("ui_test");
+}
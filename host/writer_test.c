@@ -0,0 +1,393 @@
+// writer_test.c
+// Interrupted and refused writes of the config writer (config_writer.h).
+//
+//   writer_test [kills]
+//
+// - A child process commits in a loop and is SIGKILLed at random points
+//   (default 200 times); after every kill config.json must load cleanly
+//   with all of another app's keys and one of the values the child wrote.
+// - The states a crash can leave on the 3DS, where rename cannot replace a
+//   file (a torn config.json.tmp next to the old file, or only the complete
+//   .tmp), must load complete and be cleaned up by the next commit.
+// - A file the writer cannot read back in full (bad escape, truncated
+//   array, too many keys) must be left byte for byte, with the key still
+//   dirty, and written once it is fixed.
+// - A restore of many keys goes out in one commit or not at all, and
+//   watchers see every key even when the list outgrows the journal.
+// - Strings that look like numbers or hold newlines keep their type and
+//   value through the journal and the snapshot file, and a change from
+//   another app never overwrites a key still dirty here.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "config_store.h"
+#include "config_writer.h"
+#include "check.h"
+
+static char dir[64];
+static char path[128];
+static char tmp_path[160];
+
+// What another app owns in the file; the writer must never lose it.
+static const char foreign_json[] =
+    "{\"brightness\": 70, \"theme\": \"night\", \"gov_enabled\": false,\n"
+    " \"profile\": {\"name\": \"travel\", \"saver\": true}}\n";
+
+static bool write_file(const char* p, const char* data, size_t len) {
+    FILE* f = fopen(p, "wb");
+    if(!f) return false;
+    bool ok = fwrite(data, 1, len, f) == len;
+    return fclose(f) == 0 && ok;
+}
+
+static size_t read_file(const char* p, char* buf, size_t cap) {
+    FILE* f = fopen(p, "rb");
+    if(!f) return 0;
+    size_t n = fread(buf, 1, cap, f);
+    fclose(f);
+    return n;
+}
+
+static bool has_foreign_keys(const ConfigStore* cs) {
+    return config_store_get_int(cs, "brightness", 0) == 70 &&
+           strcmp(config_store_get_string(cs, "theme", ""), "night") == 0 &&
+           config_store_get_bool(cs, "gov_enabled", true) == false &&
+           strcmp(config_store_get_string(cs, "profile.name", ""), "travel") == 0 &&
+           config_store_get_bool(cs, "profile.saver", false);
+}
+
+static void committer(void) {
+    static ConfigStore cs;
+    static ConfigWriter w;
+    config_store_load(&cs, path);
+    config_writer_init(&w, &cs, NULL);
+    for(int i = 1;; i++) {
+        config_writer_set_int(&w, "counter", i, 0);
+        config_writer_set_bool(&w, "battery_saver", i & 1, 0);
+        config_writer_commit(&w);
+    }
+}
+
+static void test_kills(int kills) {
+    static ConfigStore cs;
+    write_file(path, foreign_json, strlen(foreign_json));
+    remove(tmp_path);
+    int bad = 0, torn_tmp = 0, last = 0;
+    for(int k = 0; k < kills; k++) {
+        pid_t pid = fork();
+        if(pid == 0) committer();
+        usleep(200 + rand() % 3000);
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+
+        if(access(tmp_path, F_OK) == 0) torn_tmp++;
+        bool ok = config_store_load(&cs, path) && cs.dropped == 0 && has_foreign_keys(&cs);
+        int counter = config_store_get_int(&cs, "counter", -1);
+        if(!ok || (k && counter < 1)) bad++;
+        if(counter > 0) last = counter;
+    }
+    printf("kills: %d, %d left a temp file, %d broken configs, last counter %d\n", kills, torn_tmp, bad, last);
+    CHECK(bad == 0);
+    CHECK(last > 0);
+}
+
+// A crash while config.json.tmp was being written, for every length it
+// could have reached.
+static void test_torn_tmp(void) {
+    static ConfigStore cs, src;
+    static ConfigWriter w;
+    char full[CONFIG_FILE_MAX];
+    write_file(path, foreign_json, strlen(foreign_json));
+    config_store_load(&src, path);
+    config_store_set_int(&src, "counter", 12345);
+    int len = config_writer_format(&src, full, sizeof(full));
+    CHECK(len > 0);
+
+    int bad = 0;
+    for(int n = 0; n < len; n++) {
+        write_file(path, foreign_json, strlen(foreign_json));
+        write_file(tmp_path, full, n);
+        if(!config_store_load(&cs, path) || !has_foreign_keys(&cs) || config_store_find(&cs, "counter")) bad++;
+    }
+    CHECK(bad == 0);
+
+    // the next commit replaces the torn temp file
+    config_store_load(&cs, path);
+    config_writer_init(&w, &cs, NULL);
+    config_writer_set_int(&w, "counter", 7, 0);
+    CHECK(config_writer_commit(&w));
+    CHECK(access(tmp_path, F_OK) != 0);
+    CHECK(config_store_load(&cs, path) && has_foreign_keys(&cs) && config_store_get_int(&cs, "counter", 0) == 7);
+}
+
+// A crash between removing config.json and renaming the temp file.
+static void test_missing_target(void) {
+    static ConfigStore cs;
+    static ConfigWriter w;
+    char full[CONFIG_FILE_MAX];
+    write_file(path, foreign_json, strlen(foreign_json));
+    config_store_load(&cs, path);
+    config_store_set_int(&cs, "counter", 99);
+    int len = config_writer_format(&cs, full, sizeof(full));
+    remove(path);
+    write_file(tmp_path, full, len);
+
+    CHECK(config_store_load(&cs, path));
+    CHECK(has_foreign_keys(&cs) && config_store_get_int(&cs, "counter", 0) == 99);
+    config_writer_init(&w, &cs, NULL);
+    config_writer_set_bool(&w, "battery_saver", true, 0);
+    CHECK(config_writer_commit(&w));
+    CHECK(access(path, F_OK) == 0 && access(tmp_path, F_OK) != 0);
+    CHECK(config_store_load(&cs, path) && has_foreign_keys(&cs));
+    CHECK(config_store_get_int(&cs, "counter", 0) == 99 && config_store_get_bool(&cs, "battery_saver", false));
+}
+
+// Another app leaves text in config.json after this one loaded it; the
+// writer must not rewrite it.
+static void check_refused(const char* name, const char* text, size_t len) {
+    static ConfigStore cs;
+    static ConfigWriter w;
+    static char after[CONFIG_FILE_MAX + 64];
+    write_file(path, foreign_json, strlen(foreign_json));
+    config_store_load(&cs, path);
+    config_writer_init(&w, &cs, NULL);
+    write_file(path, text, len);
+    config_writer_set_bool(&w, "battery_saver", true, 0);
+    bool committed = config_writer_commit(&w);
+    size_t n = read_file(path, after, sizeof(after));
+    bool same = n == len && memcmp(after, text, len) == 0;
+    if(committed || !same || w.ndirty != 1) printf("%s: overwritten\n", name);
+    CHECK(!committed && same && w.ndirty == 1 && w.failures == 1);
+
+    // once the file is fixed, the pending key goes out with the rest intact
+    write_file(path, foreign_json, strlen(foreign_json));
+    CHECK(config_writer_flush(&w) && w.ndirty == 0);
+    CHECK(config_store_load(&cs, path) && has_foreign_keys(&cs) && config_store_get_bool(&cs, "battery_saver", false));
+}
+
+static void test_refused(void) {
+    static const char bad_escape[] = "{\"brightness\":70,\"comment\":\"C:\\path\",\"theme\":\"night\",\"gov_enabled\":false}";
+    check_refused("bad escape", bad_escape, strlen(bad_escape));
+    static const char torn_array[] = "{\"brightness\":70,\"recent\":[1,2,";
+    check_refused("truncated array", torn_array, strlen(torn_array));
+    static const char with_array[] = "{\"brightness\":70,\"recent\":[1,2]}";
+    check_refused("array", with_array, strlen(with_array));
+
+    char many[CONFIG_FILE_MAX];
+    int n = snprintf(many, sizeof(many), "{");
+    for(int i = 0; i < CONFIG_STORE_MAX_KEYS + 4; i++)
+        n += snprintf(many + n, sizeof(many) - n, "%s\"key%d\": %d", i ? ", " : "", i, i);
+    n += snprintf(many + n, sizeof(many) - n, "}");
+    check_refused("too many keys", many, n);
+
+    static char big[CONFIG_FILE_MAX + 16];
+    memset(big, ' ', sizeof(big));
+    big[0] = '{';
+    big[sizeof(big) - 1] = '}';
+    check_refused("too large", big, sizeof(big));
+}
+
+// Values that grow the most when escaped must still come back unchanged.
+static void test_escaping(void) {
+    static ConfigStore cs;
+    static ConfigWriter w;
+    static const char worst[] = { '"', '\\', '\x01', '\n', '\x1f', '\t', '\x7f' };
+    char value[CONFIG_STR_LEN];
+    for(int i = 0; i < CONFIG_STR_LEN - 1; i++) value[i] = worst[i % sizeof(worst)];
+    value[CONFIG_STR_LEN - 1] = '\0';
+
+    write_file(path, foreign_json, strlen(foreign_json));
+    config_store_load(&cs, path);
+    config_writer_init(&w, &cs, NULL);
+    config_writer_set_string(&w, "quotes", value, 0);
+    memset(value, '\x02', CONFIG_STR_LEN - 1);
+    config_writer_set_string(&w, "controls", value, 0);
+    CHECK(config_writer_commit(&w));
+    CHECK(config_store_load(&cs, path) && cs.dropped == 0 && has_foreign_keys(&cs));
+    CHECK(strcmp(config_store_get_string(&cs, "controls", ""), value) == 0);
+    for(int i = 0; i < CONFIG_STR_LEN - 1; i++) value[i] = worst[i % sizeof(worst)];
+    CHECK(strcmp(config_store_get_string(&cs, "quotes", ""), value) == 0);
+}
+
+static bool is_string(const ConfigStore* cs, const char* key, const char* want) {
+    const ConfigEntry* e = config_store_find(cs, key);
+    return e && e->type == CONFIG_STRING && strcmp(e->v.s, want) == 0;
+}
+
+static void test_typed_values(void) {
+    static ConfigStore a, b, snap;
+    static ConfigWriter wa, wb;
+    static ConfigWatch watch_a, watch_b;
+    static ConfigSnapshots ss;
+    write_file(path, foreign_json, strlen(foreign_json));
+    config_store_load(&a, path);
+    config_store_load(&b, path);
+    config_watch_start(&watch_a, path);
+    config_watch_start(&watch_b, path);
+    config_writer_init(&wa, &a, &watch_a);
+    config_writer_init(&wb, &b, &watch_b);
+    config_snapshot_init(&ss, path);
+    remove(ss.path);
+    config_snapshot_init(&ss, path);
+    wa.snapshots = &ss;
+
+    // through the journal
+    config_writer_set_string(&wa, "pin", "1", 0);
+    config_writer_set_string(&wa, "answer", "true", 0);
+    config_writer_set_string(&wa, "note", "a\nb=c\n.", 0);
+    CHECK(config_writer_commit(&wa));
+    CHECK(config_watch_poll(&watch_b, &b, 0, NULL, NULL) == 3 && watch_b.reloads == 0);
+    CHECK(is_string(&b, "pin", "1") && is_string(&b, "answer", "true") && is_string(&b, "note", "a\nb=c\n."));
+    CHECK(!config_store_find(&b, "b"));
+
+    // through the snapshot file: the next commit snapshots that version
+    config_writer_set_int(&wa, "brightness", 10, 0);
+    CHECK(config_writer_commit(&wa));
+    config_snapshot_init(&ss, path);
+    CHECK(ss.count == 2);
+    config_snapshot_get(&ss, ss.count - 1, &snap);
+    CHECK(is_string(&snap, "pin", "1") && is_string(&snap, "answer", "true") && is_string(&snap, "note", "a\nb=c\n."));
+    CHECK(config_store_get_int(&snap, "brightness", 0) == 70 && !config_store_find(&snap, "b"));
+
+    // files written before values were encoded still read
+    config_store_set_encoded(&snap, "legacy", "night");
+    CHECK(is_string(&snap, "legacy", "night"));
+    config_store_set_encoded(&snap, "legacy", "42");
+    CHECK(config_store_get_int(&snap, "legacy", 0) == 42);
+
+    // b edits brightness but has not saved; a's change must not undo it
+    config_watch_poll(&watch_b, &b, CONFIG_WATCH_PERIOD_MS, NULL, NULL);
+    config_writer_set_int(&wb, "brightness", 30, 0);
+    config_writer_set_int(&wa, "brightness", 90, 0);
+    config_writer_set_bool(&wa, "battery_saver", true, 0);
+    CHECK(config_writer_commit(&wa));
+    config_watch_poll(&watch_b, &b, 2 * CONFIG_WATCH_PERIOD_MS, NULL, NULL);
+    CHECK(config_store_get_int(&b, "brightness", 0) == 30 && config_store_get_bool(&b, "battery_saver", false));
+    // the same when b missed a generation and reloads the file
+    config_writer_set_int(&wa, "brightness", 91, 0);
+    CHECK(config_writer_commit(&wa));
+    config_writer_set_int(&wa, "brightness", 92, 0);
+    CHECK(config_writer_commit(&wa));
+    config_watch_poll(&watch_b, &b, 3 * CONFIG_WATCH_PERIOD_MS, NULL, NULL);
+    CHECK(watch_b.reloads == 1 && config_store_get_int(&b, "brightness", 0) == 30);
+    CHECK(config_writer_commit(&wb));
+    CHECK(config_store_load(&a, path) && config_store_get_int(&a, "brightness", 0) == 30);
+    CHECK(is_string(&a, "note", "a\nb=c\n."));
+
+    remove(ss.path);
+    remove(watch_a.journal);
+}
+
+#define RESTORE_KEYS 30
+
+static void write_many(const char* value) {
+    char text[CONFIG_FILE_MAX];
+    int n = snprintf(text, sizeof(text), "{\"brightness\": 70, \"theme\": \"night\", \"gov_enabled\": false,"
+                     " \"profile\": {\"name\": \"travel\", \"saver\": true}");
+    for(int i = 0; i < RESTORE_KEYS; i++)
+        n += snprintf(text + n, sizeof(text) - n, ", \"k%02d\": \"%s-%02d\"", i, value, i);
+    n += snprintf(text + n, sizeof(text) - n, "}\n");
+    write_file(path, text, n);
+}
+
+static int watched;
+
+static void on_watch(const char* key, const ConfigEntry* e, void* ctx) {
+    (void)e; (void)ctx;
+    if(key[0] == 'k') watched++;
+}
+
+static void test_restore(void) {
+    static ConfigStore cs, other;
+    static ConfigWriter w;
+    static ConfigSnapshots ss;
+    static ConfigWatch watch, other_watch;
+    static char before[CONFIG_FILE_MAX], after[CONFIG_FILE_MAX];
+    const char* old_value = "an-old-value-long-enough-to-fill-the-journal";
+
+    write_many(old_value);
+    config_snapshot_init(&ss, path);
+    remove(ss.path);
+    config_snapshot_init(&ss, path);
+    config_store_load(&cs, path);
+    config_watch_start(&watch, path);
+    config_writer_init(&w, &cs, &watch);
+    w.snapshots = &ss;
+    config_store_load(&other, path);
+    config_watch_start(&other_watch, path);
+
+    // change every key at once: one commit, which snapshots the old values
+    char v[CONFIG_STR_LEN];
+    for(int i = 0; i < RESTORE_KEYS; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "k%02d", i);
+        snprintf(v, sizeof(v), "new-%02d", i);
+        config_writer_set_string(&w, key, v, 0);
+    }
+    CHECK(w.ndirty == RESTORE_KEYS && w.commits == 0);
+    CHECK(config_writer_commit(&w) && w.commits == 1 && ss.count == 1);
+    config_watch_poll(&other_watch, &other, 0, on_watch, NULL);
+    CHECK(other_watch.reloads == 0 && watched == RESTORE_KEYS);
+
+    // a restore into a file another app broke: nothing written, all kept
+    static const char broken[] = "{\"brightness\":70,\"comment\":\"C:\\path\"}";
+    write_file(path, broken, strlen(broken));
+    int changed = config_writer_restore(&w, &ss, 0, 10, NULL, NULL);
+    size_t n = read_file(path, before, sizeof(before));
+    CHECK(changed == -1 && w.ndirty == RESTORE_KEYS && w.commits == 1);
+    CHECK(n == strlen(broken) && memcmp(before, broken, n) == 0);
+
+    // once it is fixed the next poll writes the whole restore in one go
+    write_many("new");
+    config_writer_poll(&w, 10 + CONFIG_WRITE_DEBOUNCE_MS);
+    CHECK(w.ndirty == 0 && w.commits == 2);
+    CHECK(config_store_load(&cs, path) && has_foreign_keys(&cs));
+    int restored = 0;
+    for(int i = 0; i < RESTORE_KEYS; i++) {
+        char key[8], want[CONFIG_STR_LEN];
+        snprintf(key, sizeof(key), "k%02d", i);
+        snprintf(want, sizeof(want), "%s-%02d", old_value, i);
+        if(strcmp(config_store_get_string(&cs, key, ""), want) == 0) restored++;
+    }
+    CHECK(restored == RESTORE_KEYS);
+
+    // the key list did not fit the journal: a watcher reloads instead
+    watched = 0;
+    config_watch_poll(&other_watch, &other, CONFIG_WATCH_PERIOD_MS, on_watch, NULL);
+    CHECK(other_watch.reloads == 1 && watched == RESTORE_KEYS);
+    CHECK(strcmp(config_store_get_string(&other, "k00", ""), config_store_get_string(&cs, "k00", "-")) == 0);
+    n = read_file(watch.journal, after, sizeof(after));
+    CHECK(n > 0 && n < CONFIG_JOURNAL_MAX);
+
+    remove(ss.path);
+    remove(watch.journal);
+}
+
+int main(int argc, char** argv) {
+    int kills = argc > 1 ? atoi(argv[1]) : 200;
+    snprintf(dir, sizeof(dir), "/tmp/writer_test.XXXXXX");
+    if(!mkdtemp(dir)) {
+        fprintf(stderr, "cannot create a scratch directory in /tmp\n");
+        return 1;
+    }
+    snprintf(path, sizeof(path), "%s/config.json", dir);
+    snprintf(tmp_path, sizeof(tmp_path), "%s" CONFIG_TMP_SUFFIX, path);
+    srand(1);
+
+    test_torn_tmp();
+    test_missing_target();
+    test_refused();
+    test_escaping();
+    test_typed_values();
+    test_restore();
+    test_kills(kills);
+
+    remove(path);
+    remove(tmp_path);
+    rmdir(dir);
+    return check_done("writer_test");
+}
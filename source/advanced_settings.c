@@ -1,41 +1,68 @@
 #include <3ds.h>
 #include <stdio.h>
 #include "system_utils.h"
-#include "json_parser.h"
+#include "config_store.h"
+#include "sensors.h"
+#include "console_diff.h"
+#include "config_watch.h"
+#include "config_writer.h"
 
 #define CONFIG_PATH "/3ds/system_enhancer/config.json"
 
 int main() {
     gfxInitDefault();
-    consoleInit(GFX_TOP, NULL);
-    consoleInit(GFX_BOTTOM, NULL);
+    PrintConsole* topConsole = consoleInit(GFX_TOP, NULL);
+    PrintConsole* bottomConsole = consoleInit(GFX_BOTTOM, NULL);
 
-    printf("3DS System Enhancer - Advanced Settings\n");
-    printf("Press START to exit\n");
+    // only changed cells reach the consoles
+    static ConsoleGrid topGrid, bottomGrid;
+    console_grid_init(&topGrid, 50, 30, NULL, NULL);
+    console_grid_init(&bottomGrid, 40, 30, NULL, NULL);
+
+    // parse config once; the loop only reads the in-memory table
+    static ConfigStore config;
+    config_store_load(&config, CONFIG_PATH);
+    bool battery_saver = config_store_get_bool(&config, "battery_saver", false);
+    static ConfigWatch configWatch;
+    config_watch_start(&configWatch, CONFIG_PATH);
+    static ConfigWriter configWriter;
+    config_writer_init(&configWriter, &config, &configWatch);
+    static ConfigSnapshots configSnapshots;
+    config_snapshot_init(&configSnapshots, CONFIG_PATH);
+    configWriter.snapshots = &configSnapshots;
+
+    sensors_init();
+    sensors_start_worker();
 
     while(aptMainLoop()) {
         hidScanInput();
         u32 kDown = hidKeysDown();
         if(kDown & KEY_START) break;
+        sensors_poll();
+        config_writer_poll(&configWriter, platform_ms());
+        if(config_watch_poll(&configWatch, &config, platform_ms(), NULL, NULL))
+            battery_saver = config_store_get_bool(&config, "battery_saver", battery_saver);
 
-        bool battery_saver = read_bool_config(CONFIG_PATH, "battery_saver", false);
-
-        consoleSelect(GFX_TOP);
-        printf("\x1b[2J");
-        printf("Battery: %d%%\n", get_battery_percent());
-        printf("Battery Saver: %s\n", battery_saver?"ON":"OFF");
-        printf("Free Memory: %u bytes\n", get_free_memory());
-        printf("SD Card Free: %llu bytes\n", get_sd_free());
+        console_grid_begin(&topGrid);
+        console_grid_printf(&topGrid, "3DS System Enhancer - Advanced Settings\n");
+        console_grid_printf(&topGrid, "Press START to exit\n\n");
+        console_grid_printf(&topGrid, "Battery: %d%%\n", (u8)sensors_get(SENSOR_BATTERY));
+        console_grid_printf(&topGrid, "Battery Saver: %s\n", battery_saver?"ON":"OFF");
+        console_grid_printf(&topGrid, "Free Memory: %lu bytes\n", (unsigned long)sensors_get(SENSOR_FREE_MEM));
+        console_grid_printf(&topGrid, "SD Card Free: %llu bytes\n", sensors_get(SENSOR_SD_FREE));
+        consoleSelect(topConsole);
+        console_grid_flush(&topGrid);
 
-        consoleSelect(GFX_BOTTOM);
-        printf("\x1b[2J");
-        printf("Press START to exit overlay\n");
-        printf("Press SELECT to toggle battery saver\n");
+        console_grid_begin(&bottomGrid);
+        console_grid_printf(&bottomGrid, "Press START to exit overlay\n");
+        console_grid_printf(&bottomGrid, "Press SELECT to toggle battery saver\n");
+        consoleSelect(bottomConsole);
+        console_grid_flush(&bottomGrid);
 
         if(kDown & KEY_SELECT) {
             battery_saver = !battery_saver;
             set_battery_saver(battery_saver);
-            write_bool_config(CONFIG_PATH, "battery_saver", battery_saver);
+            config_writer_set_bool(&configWriter, "battery_saver", battery_saver, platform_ms());
         }
 
         gfxFlushBuffers();
@@ -43,6 +70,8 @@ int main() {
         gspWaitForVBlank();
     }
 
+    sensors_stop_worker();
+    config_writer_flush(&configWriter);
     gfxExit();
     return 0;
 }
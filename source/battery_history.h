@@ -0,0 +1,251 @@
+#ifndef BATTERY_HISTORY_H
+#define BATTERY_HISTORY_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "platform.h"
+#include "config_store.h"
+
+// Persisted battery history with time-to-empty estimation.
+// Samples are stored as a base (time, percent) plus a fixed ring of
+// 3-byte deltas (seconds since the previous sample, percent change); when
+// the ring is full the oldest delta is folded into the base. A sample is
+// recorded when the level changes or every BH_FLAT_S seconds while flat.
+// The whole history is BH_FILE_MAX bytes on SD and is rewritten (through
+// config_write_atomic) at most every BH_SAVE_S seconds.
+//
+// A gap too long for one delta (the app was closed overnight) is bridged by
+// break deltas, dp == BH_BREAK, that carry only time; a level change across
+// the gap is stored in front of them with dt_s 0. The history survives the
+// restart and the new samples start a new segment. Only a gap over
+// BH_MAX_BREAKS breaks, or a clock that went backwards, starts over.
+//
+// From the current discharge segment (samples since the last charge or
+// break) a least-squares fit over the last BH_WINDOW_S seconds gives a smoothed
+// percentage and the time to empty. Everything works on (time, percent)
+// pairs, so recorded traces can be replayed on the host.
+
+#define BH_MAGIC      0x48425345u  // "ESBH"
+#define BH_VERSION    2            // 2: break deltas
+#define BH_DELTAS     512
+#define BH_FLAT_S     300          // sample at least every 5 min
+#define BH_WINDOW_S   3600         // regression window
+#define BH_MIN_SPAN_S 600          // need 10 min for a slope
+#define BH_SAVE_S     600          // persist at most every 10 min
+#define BH_FILE_MAX   (16 + BH_DELTAS * 3)
+#define BH_BREAK      (-128)       // dp of a break delta
+#define BH_MAX_BREAKS 32           // ~24 days; older history is dropped
+
+typedef struct {
+    u16 dt_s;
+    s8 dp;
+} BatteryDelta;
+
+typedef struct {
+    u32 base_time;            // platform_wall_s() of the oldest sample
+    u8 base_pct;
+    BatteryDelta deltas[BH_DELTAS];
+    int count;                // deltas in use
+    int head;                 // index of the oldest delta
+    u32 last_time;            // newest sample
+    u8 last_pct;
+    bool empty;
+
+    // estimate, refreshed on every new sample
+    float slope;              // percent per second, < 0 while discharging
+    float fit_pct;            // fitted level at last_time
+    float tte_min;            // < 0 when unknown
+    bool have_fit;
+
+    u32 saved_time;
+    bool dirty;
+} BatteryHistory;
+
+static inline void battery_history_init(BatteryHistory* bh) {
+    memset(bh, 0, sizeof(*bh));
+    bh->empty = true;
+    bh->tte_min = -1.0f;
+}
+
+static inline const BatteryDelta* battery_history_delta(const BatteryHistory* bh, int i) {
+    return &bh->deltas[(bh->head + i) % BH_DELTAS];
+}
+
+// Level change of a delta; a break has none.
+static inline int bh_delta_dp(const BatteryDelta* d) {
+    return d->dp == BH_BREAK ? 0 : d->dp;
+}
+
+// Fit level = a + slope * t over the discharge segment inside the window.
+static inline void battery_history_estimate(BatteryHistory* bh) {
+    bh->have_fit = false;
+    bh->tte_min = -1.0f;
+    if(bh->empty) return;
+
+    // walk newest to oldest, reconstructing absolute samples relative to last_time
+    float sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int n = 0;
+    s32 t = 0;
+    int pct = bh->last_pct;
+    for(int i = bh->count; i >= 0; i--) {
+        if(-t > BH_WINDOW_S) break;
+        float x = (float)t;
+        sx += x; sy += pct; sxx += x * x; sxy += x * pct;
+        n++;
+        if(i == 0) break;
+        const BatteryDelta* d = battery_history_delta(bh, i - 1);
+        if(d->dp > 0 || d->dp == BH_BREAK) break;  // charged or closed before this: segment starts here
+        t -= d->dt_s;
+        pct -= d->dp;
+    }
+    float span = -(float)t;
+    if(n < 2 || span < BH_MIN_SPAN_S) return;
+    float den = n * sxx - sx * sx;
+    if(den == 0) return;
+    bh->slope = (n * sxy - sx * sy) / den;
+    bh->fit_pct = (sy - bh->slope * sx) / n;    // value at x = 0, the newest sample
+    bh->have_fit = true;
+    if(bh->slope < 0) bh->tte_min = bh->fit_pct / -bh->slope / 60.0f;
+}
+
+// Append a delta, folding the oldest one into the base when the ring is full.
+static inline void bh_push(BatteryHistory* bh, u16 dt_s, s8 dp) {
+    if(bh->count == BH_DELTAS) {
+        const BatteryDelta* old = &bh->deltas[bh->head];
+        bh->base_time += old->dt_s;
+        bh->base_pct = (u8)(bh->base_pct + bh_delta_dp(old));
+        bh->head = (bh->head + 1) % BH_DELTAS;
+        bh->count--;
+    }
+    BatteryDelta* d = &bh->deltas[(bh->head + bh->count) % BH_DELTAS];
+    d->dt_s = dt_s;
+    d->dp = dp;
+    bh->count++;
+}
+
+// Record a reading. Cheap when nothing needs storing; returns true if a
+// sample was added.
+static inline bool battery_history_add(BatteryHistory* bh, u32 now, u8 pct) {
+    if(bh->empty || now < bh->last_time || now - bh->last_time > (u32)BH_MAX_BREAKS * 0xFFFF) {
+        // first sample, clock went backwards, or the history is too old to bridge
+        battery_history_init(bh);
+        bh->base_time = bh->last_time = now;
+        bh->base_pct = bh->last_pct = pct;
+        bh->empty = false;
+        bh->dirty = true;
+        battery_history_estimate(bh);
+        return true;
+    }
+    if(pct == bh->last_pct && now - bh->last_time < BH_FLAT_S) return false;
+
+    u32 gap = now - bh->last_time;
+    if(gap <= 0xFFFF) {
+        bh_push(bh, (u16)gap, (s8)(pct - bh->last_pct));
+    } else {
+        // no fit may draw a line across the gap: the new level goes in at
+        // the old time, the breaks carry the time
+        if(pct != bh->last_pct) bh_push(bh, 0, (s8)(pct - bh->last_pct));
+        for(; gap > 0xFFFF; gap -= 0xFFFF) bh_push(bh, 0xFFFF, BH_BREAK);
+        bh_push(bh, (u16)gap, BH_BREAK);
+    }
+    bh->last_time = now;
+    bh->last_pct = pct;
+    bh->dirty = true;
+    battery_history_estimate(bh);
+    return true;
+}
+
+// Smoothed level at time now, from the fit (raw level if there is none).
+static inline float battery_history_smoothed(const BatteryHistory* bh, u32 now) {
+    if(!bh->have_fit) return bh->last_pct;
+    float v = bh->fit_pct + bh->slope * (float)(s32)(now - bh->last_time);
+    if(v < 0) v = 0;
+    if(v > 100) v = 100;
+    return v;
+}
+
+// Minutes to empty at time now, < 0 when unknown.
+static inline float battery_history_tte(const BatteryHistory* bh, u32 now) {
+    if(bh->tte_min < 0) return -1.0f;
+    float left = bh->tte_min - (float)(s32)(now - bh->last_time) / 60.0f;
+    return left > 0 ? left : 0;
+}
+
+// "2h 05m" / "--"
+static inline int battery_history_format_tte(char* buf, size_t n, float minutes) {
+    if(minutes < 0) return snprintf(buf, n, "--");
+    int m = (int)(minutes + 0.5f);
+    return snprintf(buf, n, "%dh %02dm", m / 60, m % 60);
+}
+
+static inline void bh_put32(u8* p, u32 v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; }
+static inline u32 bh_get32(const u8* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24); }
+
+// Write the history through a temp file. Returns false on I/O error.
+static inline bool battery_history_save(BatteryHistory* bh, const char* path) {
+    u8 buf[BH_FILE_MAX];
+    bh_put32(buf, BH_MAGIC);
+    buf[4] = BH_VERSION;
+    buf[5] = bh->base_pct;
+    buf[6] = bh->count & 0xFF;
+    buf[7] = bh->count >> 8;
+    bh_put32(buf + 8, bh->base_time);
+    bh_put32(buf + 12, bh->empty ? 0 : 1);
+    u8* p = buf + 16;
+    for(int i = 0; i < bh->count; i++) {
+        const BatteryDelta* d = battery_history_delta(bh, i);
+        p[0] = d->dt_s & 0xFF;
+        p[1] = d->dt_s >> 8;
+        p[2] = (u8)d->dp;
+        p += 3;
+    }
+    bool ok = config_write_atomic(path, (const char*)buf, p - buf);
+    if(ok) {
+        bh->dirty = false;
+        bh->saved_time = bh->last_time;
+    }
+    return ok;
+}
+
+// Save only if something changed and BH_SAVE_S passed since the last save.
+static inline void battery_history_maybe_save(BatteryHistory* bh, const char* path, u32 now) {
+    if(bh->dirty && now - bh->saved_time >= BH_SAVE_S) battery_history_save(bh, path);
+}
+
+static inline bool battery_history_load(BatteryHistory* bh, const char* path) {
+    battery_history_init(bh);
+    FILE* f = fopen(path, "rb");
+    if(!f) {
+        // the save died between remove and rename
+        char tmp[160];
+        snprintf(tmp, sizeof(tmp), "%s" CONFIG_TMP_SUFFIX, path);
+        f = fopen(tmp, "rb");
+        if(!f) return false;
+    }
+    u8 buf[BH_FILE_MAX];
+    size_t len = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    // version 1 files have no breaks and read the same
+    if(len < 16 || bh_get32(buf) != BH_MAGIC || buf[4] < 1 || buf[4] > BH_VERSION) return false;
+    int count = buf[6] | (buf[7] << 8);
+    if(count > BH_DELTAS || len < 16 + (size_t)count * 3 || bh_get32(buf + 12) == 0) return false;
+
+    bh->base_time = bh->last_time = bh_get32(buf + 8);
+    bh->base_pct = bh->last_pct = buf[5];
+    const u8* p = buf + 16;
+    for(int i = 0; i < count; i++, p += 3) {
+        BatteryDelta* d = &bh->deltas[i];
+        d->dt_s = p[0] | (p[1] << 8);
+        d->dp = (s8)p[2];
+        bh->last_time += d->dt_s;
+        bh->last_pct = (u8)(bh->last_pct + bh_delta_dp(d));
+    }
+    bh->count = count;
+    bh->empty = false;
+    bh->saved_time = bh->last_time;
+    battery_history_estimate(bh);
+    return true;
+}
+
+#endif
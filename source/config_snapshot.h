@@ -0,0 +1,384 @@
+#ifndef CONFIG_SNAPSHOT_H
+#define CONFIG_SNAPSHOT_H
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "platform.h"
+#include "config_store.h"
+#include "config_watch.h"
+
+// Versioned config snapshots.
+// config.snap (next to config.json) holds one full copy of the config, the
+// base, followed by up to CONFIG_SNAP_MAX snapshots, oldest first. Each
+// snapshot only stores the keys where it differs from the base; "-key"
+// marks a key the snapshot does not have:
+//
+//   base 1700000000 8
+//   battery_saver=false
+//   brightness=100
+//   theme="night"
+//   .
+//   snap 7 1700000420
+//   brightness=60
+//   -theme
+//   .
+//
+// Taking a snapshot diffs against the in-memory base and appends one block,
+// which is cheap enough for the config writer to do before every save.
+// The file is only rewritten (atomically, through config_write_atomic) to
+// delete or prune, to drop the oldest quarter when full, or to move the
+// base forward once a diff reaches CONFIG_SNAP_REBASE lines. A block cut
+// short by a crash has no "." line and is dropped on the next load.
+// Values are written as JSON literals (config_entry_encode), as in the
+// change journal; older files with bare values still read.
+
+#define CONFIG_SNAP_MAX       16
+#define CONFIG_SNAP_KEEP      4      // what a prune leaves
+#define CONFIG_SNAP_REBASE    12     // diff lines that trigger a new base
+#define CONFIG_SNAP_FILE_MAX  8192
+#define CONFIG_SNAP_LINE      (CONFIG_KEY_LEN + CONFIG_VALUE_LEN + 8)
+
+typedef struct {
+    u32 id;
+    u32 time;                 // platform_wall_s()
+    u32 hash;                 // of the whole config, see config_snapshot_hash
+    u16 off, len;             // its diff lines in ConfigSnapshots.text
+    u16 changes;              // against the base
+} ConfigSnapInfo;
+
+typedef struct {
+    char path[128];
+    ConfigStore base;
+    u32 base_time;
+    ConfigSnapInfo snaps[CONFIG_SNAP_MAX];
+    int count;
+    u32 next_id;
+    char text[CONFIG_SNAP_FILE_MAX];   // the file as loaded or last written
+    int text_len;
+    long long mtime, size;    // stat() of the file when text was read
+    u32 failures;             // appends or rewrites that did not reach the SD card
+} ConfigSnapshots;
+
+// Order-independent hash of every key=value pair, to skip duplicate snapshots.
+static inline u32 config_snapshot_hash(const ConfigStore* cs) {
+    u32 h = 0;
+    for(int i = 0; i < CONFIG_STORE_SLOTS; i++) {
+        const ConfigEntry* e = &cs->slots[i];
+        if(e->type == CONFIG_NONE) continue;
+        char v[CONFIG_VALUE_LEN], line[CONFIG_SNAP_LINE];
+        config_entry_encode(e, v, sizeof(v));
+        snprintf(line, sizeof(line), "%s=%s", e->key, v);
+        h += config_hash(line);
+    }
+    return h;
+}
+
+// Copy the next complete line of [*p, end) into buf. -1 at the end or on a
+// line without its '\n'.
+static inline int config_snap_line(const char** p, const char* end, char* buf, size_t cap) {
+    const char* nl = memchr(*p, '\n', end - *p);
+    if(!nl) return -1;
+    size_t n = nl - *p;
+    size_t c = n < cap - 1 ? n : cap - 1;
+    memcpy(buf, *p, c);
+    buf[c] = '\0';
+    *p = nl + 1;
+    return (int)n;
+}
+
+// "key=<literal>" into cs
+static inline void config_snap_set_line(ConfigStore* cs, char* line) {
+    char* eq = strchr(line, '=');
+    if(!eq || eq == line) return;
+    *eq = '\0';
+    config_store_set_encoded(cs, line, eq + 1);
+}
+
+static inline bool config_snap_removes(const char* p, const char* end, const char* key) {
+    char line[CONFIG_SNAP_LINE];
+    while(config_snap_line(&p, end, line, sizeof(line)) >= 0)
+        if(line[0] == '-' && strcmp(line + 1, key) == 0) return true;
+    return false;
+}
+
+// Rebuild snapshot i (0 = oldest) into out.
+static inline void config_snapshot_get(const ConfigSnapshots* ss, int i, ConfigStore* out) {
+    const ConfigSnapInfo* s = &ss->snaps[i];
+    const char* p = ss->text + s->off;
+    const char* end = p + s->len;
+    config_store_clear(out);
+    for(int k = 0; k < CONFIG_STORE_SLOTS; k++) {
+        const ConfigEntry* e = &ss->base.slots[k];
+        if(e->type == CONFIG_NONE || config_snap_removes(p, end, e->key)) continue;
+        ConfigEntry* o = config_store_entry(out, e->key);
+        if(o) *o = *e;
+    }
+    char line[CONFIG_SNAP_LINE];
+    while(config_snap_line(&p, end, line, sizeof(line)) >= 0)
+        if(line[0] != '-') config_snap_set_line(out, line);
+}
+
+static inline bool config_snap_put(char* buf, size_t cap, int* len, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + *len, cap - *len, fmt, ap);
+    va_end(ap);
+    if(n < 0 || (size_t)n >= cap - *len) return false;
+    *len += n;
+    return true;
+}
+
+// Lines turning base into cs. Returns the line count, -1 if buf is too small.
+static inline int config_snap_diff(const ConfigStore* base, const ConfigStore* cs, char* buf, size_t cap, int* len) {
+    int changes = 0;
+    for(int i = 0; i < CONFIG_STORE_SLOTS; i++) {
+        const ConfigEntry* e = &cs->slots[i];
+        if(e->type == CONFIG_NONE) continue;
+        const ConfigEntry* b = config_store_find(base, e->key);
+        if(b && config_entry_equal(b, e)) continue;
+        char v[CONFIG_VALUE_LEN];
+        config_entry_encode(e, v, sizeof(v));
+        if(!config_snap_put(buf, cap, len, "%s=%s\n", e->key, v)) return -1;
+        changes++;
+    }
+    for(int i = 0; i < CONFIG_STORE_SLOTS; i++) {
+        const ConfigEntry* b = &base->slots[i];
+        if(b->type == CONFIG_NONE || config_store_find(cs, b->key)) continue;
+        if(!config_snap_put(buf, cap, len, "-%s\n", b->key)) return -1;
+        changes++;
+    }
+    return changes;
+}
+
+// Index ss->text. Stops at the first incomplete or unreadable block and
+// returns false if that left anything behind.
+static inline bool config_snap_parse(ConfigSnapshots* ss) {
+    static ConfigStore tmp;
+    config_store_clear(&ss->base);
+    ss->base_time = 0;
+    ss->count = 0;
+    ss->next_id = 1;
+
+    const char* p = ss->text;
+    const char* end = ss->text + ss->text_len;
+    const char* line_start = p;
+    char line[CONFIG_SNAP_LINE];
+    enum { OUTSIDE, IN_BASE, IN_SNAP } state = OUTSIDE;
+    bool have_base = false;
+    int valid = 0;
+    ConfigSnapInfo cur;
+    while(config_snap_line(&p, end, line, sizeof(line)) >= 0) {
+        unsigned long a, b;
+        if(state == OUTSIDE) {
+            if(!have_base && sscanf(line, "base %lu %lu", &a, &b) == 2) {
+                ss->base_time = (u32)a;
+                ss->next_id = (u32)b;
+                state = IN_BASE;
+            } else if(have_base && ss->count < CONFIG_SNAP_MAX && sscanf(line, "snap %lu %lu", &a, &b) == 2) {
+                memset(&cur, 0, sizeof(cur));
+                cur.id = (u32)a;
+                cur.time = (u32)b;
+                cur.off = (u16)(p - ss->text);
+                state = IN_SNAP;
+            } else {
+                break;
+            }
+        } else if(strcmp(line, ".") == 0) {
+            if(state == IN_SNAP) {
+                cur.len = (u16)(line_start - ss->text - cur.off);
+                ss->snaps[ss->count++] = cur;
+                if(cur.id >= ss->next_id) ss->next_id = cur.id + 1;
+            }
+            have_base = true;
+            state = OUTSIDE;
+            valid = (int)(p - ss->text);
+        } else if(state == IN_BASE) {
+            config_snap_set_line(&ss->base, line);
+        } else {
+            cur.changes++;
+        }
+        line_start = p;
+    }
+    if(!have_base) config_store_clear(&ss->base);
+    for(int i = 0; i < ss->count; i++) {
+        config_snapshot_get(ss, i, &tmp);
+        ss->snaps[i].hash = config_snapshot_hash(&tmp);
+    }
+    bool clean = valid == ss->text_len;
+    ss->text_len = valid;
+    return clean;
+}
+
+static inline void config_snap_written(ConfigSnapshots* ss) {
+    if(!config_stat(ss->path, &ss->mtime, &ss->size)) ss->mtime = ss->size = -1;
+}
+
+// Read and index the file. A torn last block is cut off on disk, too.
+static inline bool config_snapshot_load(ConfigSnapshots* ss) {
+    ss->text_len = 0;
+    ss->mtime = ss->size = -1;
+    FILE* f = fopen(ss->path, "r");
+    if(!f) {
+        char tmp[sizeof(ss->path) + 4];
+        snprintf(tmp, sizeof(tmp), "%s" CONFIG_TMP_SUFFIX, ss->path);
+        f = fopen(tmp, "r");
+    }
+    if(f) {
+        ss->text_len = (int)fread(ss->text, 1, sizeof(ss->text), f);
+        fclose(f);
+    }
+    if(!config_snap_parse(ss)) {
+        if(!config_write_atomic(ss->path, ss->text, ss->text_len)) ss->failures++;
+    }
+    config_snap_written(ss);
+    return ss->text_len > 0;
+}
+
+// foo/config.json -> foo/config.snap
+static inline void config_snapshot_init(ConfigSnapshots* ss, const char* config_path) {
+    memset(ss, 0, sizeof(*ss));
+    snprintf(ss->path, sizeof(ss->path), "%s", config_path);
+    char* dot = strrchr(ss->path, '.');
+    char* slash = strrchr(ss->path, '/');
+    if(dot && (!slash || dot > slash)) *dot = '\0';
+    strncat(ss->path, ".snap", sizeof(ss->path) - strlen(ss->path) - 1);
+    config_snapshot_load(ss);
+}
+
+// Re-read the file if another app wrote it since. Returns true if it did.
+static inline bool config_snapshot_refresh(ConfigSnapshots* ss) {
+    long long mtime = -1, size = -1;
+    config_stat(ss->path, &mtime, &size);
+    if(mtime == ss->mtime && size == ss->size) return false;
+    config_snapshot_load(ss);
+    return true;
+}
+
+// Write a new file: new_base, the snapshots with keep[i] set re-diffed
+// against it, then add (if not NULL) as the newest snapshot. Drops the
+// oldest kept snapshots while the result does not fit.
+static inline bool config_snap_rewrite(ConfigSnapshots* ss, const ConfigStore* new_base, u32 base_time,
+                                       bool* keep, const ConfigStore* add, u32 add_time) {
+    static char out[CONFIG_SNAP_FILE_MAX];
+    static ConfigStore tmp;
+    u32 next_id = ss->next_id + (add ? 1 : 0);
+    for(;;) {
+        int len = 0;
+        bool ok = config_snap_put(out, sizeof(out), &len, "base %lu %lu\n", (unsigned long)base_time, (unsigned long)next_id);
+        for(int i = 0; ok && i < CONFIG_STORE_SLOTS; i++) {
+            const ConfigEntry* e = &new_base->slots[i];
+            if(e->type == CONFIG_NONE) continue;
+            char v[CONFIG_VALUE_LEN];
+            config_entry_encode(e, v, sizeof(v));
+            ok = config_snap_put(out, sizeof(out), &len, "%s=%s\n", e->key, v);
+        }
+        ok = ok && config_snap_put(out, sizeof(out), &len, ".\n");
+        for(int i = 0; ok && i <= ss->count; i++) {
+            const ConfigStore* s = add;
+            u32 id = ss->next_id, t = add_time;
+            if(i < ss->count) {
+                if(!keep[i]) continue;
+                config_snapshot_get(ss, i, &tmp);
+                s = &tmp;
+                id = ss->snaps[i].id;
+                t = ss->snaps[i].time;
+            }
+            if(!s) continue;
+            ok = config_snap_put(out, sizeof(out), &len, "snap %lu %lu\n", (unsigned long)id, (unsigned long)t) &&
+                 config_snap_diff(new_base, s, out, sizeof(out), &len) >= 0 &&
+                 config_snap_put(out, sizeof(out), &len, ".\n");
+        }
+        if(ok) {
+            if(!config_write_atomic(ss->path, out, len)) {
+                ss->failures++;
+                return false;
+            }
+            memcpy(ss->text, out, len);
+            ss->text_len = len;
+            config_snap_parse(ss);
+            config_snap_written(ss);
+            return true;
+        }
+        // too big: give up the oldest snapshot we were keeping
+        int i = 0;
+        while(i < ss->count && !keep[i]) i++;
+        if(i == ss->count) return false;
+        keep[i] = false;
+    }
+}
+
+// Record cs as the newest snapshot unless it equals the newest one already.
+// Returns the snapshot's id, 0 on failure.
+static inline u32 config_snapshot_take(ConfigSnapshots* ss, const ConfigStore* cs, u32 now) {
+    config_snapshot_refresh(ss);
+    if(ss->count && ss->snaps[ss->count - 1].hash == config_snapshot_hash(cs)) return ss->snaps[ss->count - 1].id;
+
+    char block[CONFIG_SNAP_FILE_MAX / 4];
+    int len = 0, head = 0;
+    int changes = -1;
+    if(ss->text_len > 0 && config_snap_put(block, sizeof(block), &len, "snap %lu %lu\n",
+                                           (unsigned long)ss->next_id, (unsigned long)now)) {
+        head = len;
+        changes = config_snap_diff(&ss->base, cs, block, sizeof(block), &len);
+    }
+    if(changes >= 0 && changes < CONFIG_SNAP_REBASE && ss->count < CONFIG_SNAP_MAX &&
+       config_snap_put(block, sizeof(block), &len, ".\n") && ss->text_len + len <= (int)sizeof(ss->text)) {
+        // the common case: one append
+        FILE* f = fopen(ss->path, "a");
+        bool ok = f && fwrite(block, 1, len, f) == (size_t)len;
+        if(f) ok = fclose(f) == 0 && ok;
+        if(!ok) {
+            ss->failures++;
+            return 0;
+        }
+        ConfigSnapInfo* s = &ss->snaps[ss->count++];
+        s->id = ss->next_id++;
+        s->time = now;
+        s->hash = config_snapshot_hash(cs);
+        s->off = (u16)(ss->text_len + head);
+        s->len = (u16)(len - head - 2);     // without the "." line
+        s->changes = (u16)changes;
+        memcpy(ss->text + ss->text_len, block, len);
+        ss->text_len += len;
+        config_snap_written(ss);
+        return s->id;
+    }
+
+    // new base at cs; when full, drop the oldest quarter at once so the
+    // next few snapshots are appends again
+    bool keep[CONFIG_SNAP_MAX];
+    int drop = ss->count == CONFIG_SNAP_MAX ? CONFIG_SNAP_MAX / 4 : 0;
+    for(int i = 0; i < ss->count; i++) keep[i] = i >= drop;
+    u32 id = ss->next_id;
+    return config_snap_rewrite(ss, cs, now, keep, cs, now) ? id : 0;
+}
+
+static inline bool config_snapshot_delete(ConfigSnapshots* ss, int index) {
+    if(index < 0 || index >= ss->count) return false;
+    bool keep[CONFIG_SNAP_MAX];
+    for(int i = 0; i < ss->count; i++) keep[i] = i != index;
+    return config_snap_rewrite(ss, &ss->base, ss->base_time, keep, NULL, 0);
+}
+
+// Keep only the newest n snapshots.
+static inline bool config_snapshot_prune(ConfigSnapshots* ss, int n) {
+    if(ss->count <= n) return true;
+    bool keep[CONFIG_SNAP_MAX];
+    for(int i = 0; i < ss->count; i++) keep[i] = i >= ss->count - n;
+    return config_snap_rewrite(ss, &ss->base, ss->base_time, keep, NULL, 0);
+}
+
+// "#12 10-17 14:03"
+static inline int config_snapshot_label(const ConfigSnapshots* ss, int index, char* buf, size_t n) {
+    const ConfigSnapInfo* s = &ss->snaps[index];
+    time_t t = (time_t)s->time;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    return snprintf(buf, n, "#%lu %02d-%02d %02d:%02d", (unsigned long)s->id,
+                    tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min);
+}
+
+#endif
@@ -0,0 +1,422 @@
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#ifdef __3DS__
+#include <3ds.h>
+#endif
+#include "json_parser.h"
+
+// Parse-once config store.
+// The config file is read in one bulk read and parsed into a small
+// open-addressed table of typed keys, so lookups never touch the SD card.
+// config_store_reload_if_changed() stats the file and only re-parses when
+// its size or mtime moved.
+//
+// A load reports how it went in status. Values the table cannot hold as
+// they are in the file (a full table, a key or string too long, arrays,
+// null, non-integer numbers) are counted in dropped; the table is then
+// fine to read from but must not be written back over the file.
+
+#define CONFIG_STORE_SLOTS    64   // power of two
+#define CONFIG_STORE_MAX_KEYS 48   // keep the table at most 3/4 full
+#define CONFIG_KEY_LEN        32
+#define CONFIG_STR_LEN        48
+#define CONFIG_FILE_MAX       4096
+#define CONFIG_TMP_SUFFIX     ".tmp"  // see config_write_atomic()
+
+typedef enum {
+    CONFIG_NONE = 0,
+    CONFIG_BOOL,
+    CONFIG_INT,
+    CONFIG_STRING
+} ConfigType;
+
+typedef struct {
+    char key[CONFIG_KEY_LEN];
+    uint8_t type;            // ConfigType, CONFIG_NONE marks a free slot
+    union {
+        bool b;
+        int i;
+        char s[CONFIG_STR_LEN];
+    } v;
+} ConfigEntry;
+
+typedef enum {
+    CONFIG_LOAD_OK = 0,
+    CONFIG_LOAD_MISSING,      // no file (and no .tmp)
+    CONFIG_LOAD_TOO_BIG,      // CONFIG_FILE_MAX bytes or more; not parsed
+    CONFIG_LOAD_SYNTAX        // malformed; keys before error_pos were kept
+} ConfigLoadStatus;
+
+typedef struct {
+    ConfigEntry slots[CONFIG_STORE_SLOTS];
+    int count;
+    int dropped;              // values not stored as they were, see above
+    char path[128];
+    bool loaded;              // file existed and was parsed
+    uint8_t status;           // ConfigLoadStatus of the last load
+    uint32_t error_pos;       // byte offset of a syntax error
+    long long mtime;          // stat() of the last load
+    long long size;
+} ConfigStore;
+
+static inline uint32_t config_hash(const char* key) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    while(*key) {
+        h ^= (uint8_t)*key++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Returns the slot holding key, or the free slot where it would go.
+static inline ConfigEntry* config_store_slot(ConfigStore* cs, const char* key) {
+    uint32_t i = config_hash(key) & (CONFIG_STORE_SLOTS - 1);
+    for(;;) {
+        ConfigEntry* e = &cs->slots[i];
+        if(e->type == CONFIG_NONE || strcmp(e->key, key) == 0) return e;
+        i = (i + 1) & (CONFIG_STORE_SLOTS - 1);
+    }
+}
+
+static inline const ConfigEntry* config_store_find(const ConfigStore* cs, const char* key) {
+    const ConfigEntry* e = config_store_slot((ConfigStore*)cs, key);
+    return e->type == CONFIG_NONE ? NULL : e;
+}
+
+// Get (or create) the entry for key. NULL (and counted as dropped) if the
+// key is too long or the table is full.
+static inline ConfigEntry* config_store_entry(ConfigStore* cs, const char* key) {
+    if(strlen(key) >= CONFIG_KEY_LEN) {
+        cs->dropped++;
+        return NULL;
+    }
+    ConfigEntry* e = config_store_slot(cs, key);
+    if(e->type == CONFIG_NONE) {
+        if(cs->count >= CONFIG_STORE_MAX_KEYS) {
+            cs->dropped++;
+            return NULL;
+        }
+        strcpy(e->key, key);
+        cs->count++;
+    }
+    return e;
+}
+
+static inline void config_store_set_bool(ConfigStore* cs, const char* key, bool val) {
+    ConfigEntry* e = config_store_entry(cs, key);
+    if(!e) return;
+    e->type = CONFIG_BOOL;
+    e->v.b = val;
+}
+
+static inline void config_store_set_int(ConfigStore* cs, const char* key, int val) {
+    ConfigEntry* e = config_store_entry(cs, key);
+    if(!e) return;
+    e->type = CONFIG_INT;
+    e->v.i = val;
+}
+
+static inline void config_store_set_string(ConfigStore* cs, const char* key, const char* val) {
+    ConfigEntry* e = config_store_entry(cs, key);
+    if(!e) return;
+    e->type = CONFIG_STRING;
+    if(snprintf(e->v.s, sizeof(e->v.s), "%s", val) >= (int)sizeof(e->v.s)) cs->dropped++;
+}
+
+// Set key from its textual value, inferring the type.
+static inline void config_store_set_text(ConfigStore* cs, const char* key, const char* val) {
+    if(strcmp(val, "true") == 0) { config_store_set_bool(cs, key, true); return; }
+    if(strcmp(val, "false") == 0) { config_store_set_bool(cs, key, false); return; }
+    char* end;
+    errno = 0;
+    long n = strtol(val, &end, 10);
+    if(*val && *end == '\0' && errno != ERANGE && n >= INT32_MIN && n <= INT32_MAX)
+        config_store_set_int(cs, key, (int)n);
+    else config_store_set_string(cs, key, val);
+}
+
+// A value as a JSON literal (true, 42, "text"), so it keeps its type and a
+// string can hold any byte without breaking the line it is written on. The
+// change journal and the snapshot file store values this way.
+#define CONFIG_VALUE_LEN JSON_QUOTE_LEN(CONFIG_STR_LEN)
+
+static inline bool config_entry_encode(const ConfigEntry* e, char* buf, size_t n) {
+    if(e->type == CONFIG_BOOL) return (size_t)snprintf(buf, n, "%s", e->v.b ? "true" : "false") < n;
+    if(e->type == CONFIG_INT) return (size_t)snprintf(buf, n, "%d", e->v.i) < n;
+    return json_quote(buf, n, e->v.s) < n;
+}
+
+// Set key from config_entry_encode() text. Anything else is taken as plain
+// text like config_store_set_text(), which is how lines written before
+// values were encoded read back.
+static inline void config_store_set_encoded(ConfigStore* cs, const char* key, const char* text) {
+    char tmp[CONFIG_VALUE_LEN];
+    size_t n = strlen(text);
+    if(n < sizeof(tmp)) {
+        memcpy(tmp, text, n + 1);
+        JsonLexer lx;
+        json_lexer_init(&lx, tmp, n);
+        JsonToken t = json_next(&lx);
+        long v;
+        if(json_next(&lx) == JSON_DONE) {
+            if(t == JSON_TRUE || t == JSON_FALSE) {
+                config_store_set_bool(cs, key, t == JSON_TRUE);
+                return;
+            }
+            if(t == JSON_NUMBER && json_token_int(&lx, &v) && v >= INT32_MIN && v <= INT32_MAX) {
+                config_store_set_int(cs, key, (int)v);
+                return;
+            }
+            if(t == JSON_STRING && strlen(lx.str) == lx.len) {
+                config_store_set_string(cs, key, lx.str);
+                return;
+            }
+        }
+    }
+    config_store_set_text(cs, key, text);
+}
+
+static inline bool config_store_get_bool(const ConfigStore* cs, const char* key, bool default_val) {
+    const ConfigEntry* e = config_store_find(cs, key);
+    if(!e) return default_val;
+    if(e->type == CONFIG_BOOL) return e->v.b;
+    if(e->type == CONFIG_INT) return e->v.i != 0;
+    return default_val;
+}
+
+static inline int config_store_get_int(const ConfigStore* cs, const char* key, int default_val) {
+    const ConfigEntry* e = config_store_find(cs, key);
+    if(!e) return default_val;
+    if(e->type == CONFIG_INT) return e->v.i;
+    if(e->type == CONFIG_BOOL) return e->v.b ? 1 : 0;
+    return default_val;
+}
+
+static inline const char* config_store_get_string(const ConfigStore* cs, const char* key, const char* default_val) {
+    const ConfigEntry* e = config_store_find(cs, key);
+    return (e && e->type == CONFIG_STRING) ? e->v.s : default_val;
+}
+
+static inline void config_store_clear(ConfigStore* cs) {
+    memset(cs->slots, 0, sizeof(cs->slots));
+    cs->count = 0;
+    cs->dropped = 0;
+}
+
+static inline char* config_trim(char* s) {
+    while(*s == ' ' || *s == '\t') s++;
+    char* end = s + strlen(s);
+    while(end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) *--end = '\0';
+    return s;
+}
+
+// Parse key=value lines out of an in-memory buffer (modified in place).
+static inline void config_store_parse(ConfigStore* cs, char* text) {
+    char* line = text;
+    while(line && *line) {
+        char* next = strchr(line, '\n');
+        if(next) *next++ = '\0';
+        char* eq = strchr(line, '=');
+        if(eq) {
+            *eq = '\0';
+            char* k = config_trim(line);
+            char* v = config_trim(eq + 1);
+            if(*k) config_store_set_text(cs, k, v);
+        }
+        line = next;
+    }
+}
+
+// Walk a JSON document into the table. Nested objects are flattened into
+// dotted keys ({"theme":{"bg":1}} -> "theme.bg"); arrays, null and empty
+// objects are skipped and non-integer numbers are kept as strings, all
+// counted as dropped. Keys parsed before a syntax error are kept.
+// Modifies text.
+static inline bool config_store_parse_json(ConfigStore* cs, char* text, size_t len) {
+    JsonLexer lx;
+    json_lexer_init(&lx, text, len);
+    char path[CONFIG_KEY_LEN];
+    size_t base[JSON_MAX_DEPTH + 1];     // per object level: 0 at the top, else prefix length + 1
+    unsigned long long members = 0;      // bit d: the object at depth d has a member
+    size_t keylen = 0;
+    bool key_ok = false;
+    int skip = 0;                         // nesting inside an array
+    for(;;) {
+        JsonToken t = json_next(&lx);
+        if(t == JSON_DONE) return true;
+        if(t == JSON_ERROR) {
+            cs->error_pos = (uint32_t)lx.pos;
+            return false;
+        }
+        if(skip) {
+            if(t == JSON_OBJECT_BEGIN || t == JSON_ARRAY_BEGIN) skip++;
+            else if(t == JSON_OBJECT_END || t == JSON_ARRAY_END) skip--;
+            continue;
+        }
+        switch(t) {
+            case JSON_OBJECT_BEGIN:
+                base[lx.depth] = lx.depth == 1 ? 0 : (key_ok ? keylen + 1 : sizeof(path) + 1);
+                members &= ~(1ULL << lx.depth);
+                break;
+            case JSON_OBJECT_END:
+                if(lx.depth && !(members >> (lx.depth + 1) & 1)) cs->dropped++;
+                break;
+            case JSON_ARRAY_BEGIN:
+                skip = 1;
+                cs->dropped++;
+                break;
+            case JSON_KEY: {
+                members |= 1ULL << lx.depth;
+                size_t b = base[lx.depth];
+                // a NUL from \u0000 would cut the key short
+                key_ok = b <= sizeof(path) && b + lx.len < sizeof(path) && strlen(lx.str) == lx.len;
+                if(!key_ok) break;
+                if(b) path[b - 1] = '.';
+                memcpy(path + b, lx.str, lx.len + 1);
+                keylen = b + lx.len;
+                break;
+            }
+            case JSON_STRING:
+                if(!key_ok || strlen(lx.str) != lx.len) cs->dropped++;
+                if(key_ok) config_store_set_string(cs, path, lx.str);
+                break;
+            case JSON_NUMBER: {
+                if(!key_ok) {
+                    cs->dropped++;
+                    break;
+                }
+                long n;
+                if(json_token_int(&lx, &n) && n >= INT32_MIN && n <= INT32_MAX) {
+                    config_store_set_int(cs, path, (int)n);
+                } else {
+                    char num[CONFIG_STR_LEN];
+                    snprintf(num, sizeof(num), "%.*s", (int)lx.len, lx.str);
+                    config_store_set_string(cs, path, num);
+                    cs->dropped++;
+                }
+                break;
+            }
+            case JSON_TRUE:
+            case JSON_FALSE:
+                if(key_ok) config_store_set_bool(cs, path, t == JSON_TRUE);
+                else cs->dropped++;
+                break;
+            case JSON_NULL:
+                cs->dropped++;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// config.json is JSON; files from older versions are key=value lines.
+static inline bool config_store_parse_any(ConfigStore* cs, char* text, size_t len) {
+    const char* p = text;
+    while(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+    if(*p == '{') return config_store_parse_json(cs, text, len);
+    config_store_parse(cs, text);
+    return true;
+}
+
+// libctru's stat() reports an mtime of 0 on the SD card, so a same-size
+// edit would never be noticed; the FAT timestamp comes from sdmc_getmtime().
+static inline bool config_stat(const char* path, long long* mtime, long long* size) {
+    struct stat st;
+    if(stat(path, &st) != 0) return false;
+    *mtime = (long long)st.st_mtime;
+    *size = (long long)st.st_size;
+#ifdef __3DS__
+    u64 t;
+    if(R_SUCCEEDED(sdmc_getmtime(path, &t))) *mtime = (long long)t;
+#endif
+    return true;
+}
+
+// Write data to path through path.tmp. Returns false if the old file is untouched.
+static inline bool config_write_atomic(const char* path, const char* data, size_t len) {
+    char tmp[160];
+    snprintf(tmp, sizeof(tmp), "%s" CONFIG_TMP_SUFFIX, path);
+    FILE* f = fopen(tmp, "w");
+    if(!f) return false;
+    bool ok = fwrite(data, 1, len, f) == len;
+    ok = fflush(f) == 0 && ok;
+    ok = fclose(f) == 0 && ok;
+    if(!ok) {
+        remove(tmp);
+        return false;
+    }
+    // POSIX rename replaces the target; the 3DS SD archive refuses to, so
+    // fall back to remove + rename there
+    if(rename(tmp, path) == 0) return true;
+    remove(path);
+    return rename(tmp, path) == 0;
+}
+
+// (Re)load the whole file. Keys are replaced, not merged. Returns false
+// unless the whole file was read and parsed; status says why.
+static inline bool config_store_load(ConfigStore* cs, const char* path) {
+    if(path != cs->path) snprintf(cs->path, sizeof(cs->path), "%s", path);
+    config_store_clear(cs);
+    cs->loaded = false;
+    cs->status = CONFIG_LOAD_MISSING;
+    cs->error_pos = 0;
+    cs->mtime = cs->size = -1;
+
+    FILE* f = fopen(cs->path, "r");
+    if(!f) {
+        // the writer died between removing the old file and renaming the
+        // new one into place; the complete new file is still under .tmp
+        char tmp[sizeof(cs->path) + 4];
+        snprintf(tmp, sizeof(tmp), "%s" CONFIG_TMP_SUFFIX, cs->path);
+        f = fopen(tmp, "r");
+        if(!f) return false;
+    }
+    char text[CONFIG_FILE_MAX + 1];
+    size_t n = fread(text, 1, CONFIG_FILE_MAX, f);
+    fclose(f);
+    text[n] = '\0';
+    config_stat(cs->path, &cs->mtime, &cs->size);
+
+    if(n >= CONFIG_FILE_MAX) {
+        cs->status = CONFIG_LOAD_TOO_BIG;
+        return false;
+    }
+    if(!config_store_parse_any(cs, text, n)) {
+        cs->status = CONFIG_LOAD_SYNTAX;
+        return false;
+    }
+    cs->status = CONFIG_LOAD_OK;
+    cs->loaded = true;
+    return true;
+}
+
+// "too large", "syntax error at byte 37", ... for messages.
+static inline int config_store_format_status(const ConfigStore* cs, char* buf, size_t n) {
+    switch(cs->status) {
+        case CONFIG_LOAD_OK: return snprintf(buf, n, "ok");
+        case CONFIG_LOAD_MISSING: return snprintf(buf, n, "cannot open");
+        case CONFIG_LOAD_TOO_BIG: return snprintf(buf, n, "too large (%d bytes max)", CONFIG_FILE_MAX - 1);
+        default: return snprintf(buf, n, "syntax error at byte %lu", (unsigned long)cs->error_pos);
+    }
+}
+
+// Re-parse only if the file's size or mtime changed since the last load
+// (a bad file is not retried until it changes). Returns true when the
+// table was reloaded.
+static inline bool config_store_reload_if_changed(ConfigStore* cs) {
+    long long mtime, size;
+    if(!config_stat(cs->path, &mtime, &size)) return false;
+    if(mtime == cs->mtime && size == cs->size) return false;
+    return config_store_load(cs, cs->path);
+}
+
+#endif
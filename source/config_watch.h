@@ -0,0 +1,199 @@
+#ifndef CONFIG_WATCH_H
+#define CONFIG_WATCH_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "platform.h"
+#include "config_store.h"
+
+// Config change notification between the apps.
+// Every writer of config.json also rewrites a small journal next to it
+// (config.gen): a generation counter followed by the keys that changed in
+// that generation, and a terminating "." line so a half-written journal
+// is ignored. Watchers read the journal every CONFIG_WATCH_PERIOD_MS and,
+// when the generation moved by one, apply just the listed keys. If they
+// missed a generation they reload the config and diff it against the old
+// table. Either way the callback fires once per changed key.
+//
+//   gen=42
+//   battery_saver=true
+//   theme="night"
+//   .
+//
+// Values are JSON literals (config_entry_encode), so a string keeps its
+// type and cannot end its line early. Keys this app changed but has not
+// saved yet (is_local, set by the config writer) are not overwritten.
+
+#define CONFIG_WATCH_PERIOD_MS 500
+#define CONFIG_JOURNAL_MAX     1024
+
+typedef void (*ConfigChangeFn)(const char* key, const ConfigEntry* e, void* ctx);
+typedef bool (*ConfigKeyFn)(const char* key, void* ctx);
+
+typedef struct {
+    char journal[128];
+    u32 gen;                  // last generation applied or published
+    u32 last_check_ms;
+    bool checked;
+    u32 reloads;              // full reloads after a missed generation
+    ConfigKeyFn is_local;     // optional: keys with unsaved local edits
+    void* local_ctx;
+} ConfigWatch;
+
+static inline bool config_watch_local(const ConfigWatch* w, const char* key) {
+    return w->is_local && w->is_local(key, w->local_ctx);
+}
+
+// The journal lives next to the config: foo/config.json -> foo/config.gen
+static inline void config_watch_init(ConfigWatch* w, const char* config_path) {
+    memset(w, 0, sizeof(*w));
+    snprintf(w->journal, sizeof(w->journal), "%s", config_path);
+    char* dot = strrchr(w->journal, '.');
+    char* slash = strrchr(w->journal, '/');
+    if(dot && (!slash || dot > slash)) *dot = '\0';
+    strncat(w->journal, ".gen", sizeof(w->journal) - strlen(w->journal) - 1);
+}
+
+static inline u32 config_journal_read(const ConfigWatch* w, char* text, size_t cap);
+
+// Start from the current generation: the caller has just loaded the config.
+static inline void config_watch_start(ConfigWatch* w, const char* config_path) {
+    config_watch_init(w, config_path);
+    char text[CONFIG_JOURNAL_MAX];
+    w->gen = config_journal_read(w, text, sizeof(text));
+}
+
+// Read the journal into text. Returns its generation, 0 if missing or torn.
+static inline u32 config_journal_read(const ConfigWatch* w, char* text, size_t cap) {
+    FILE* f = fopen(w->journal, "r");
+    if(!f) return 0;
+    size_t n = fread(text, 1, cap - 1, f);
+    fclose(f);
+    text[n] = '\0';
+    unsigned gen;
+    if(sscanf(text, "gen=%u", &gen) != 1) return 0;
+    if(n < 2 || strcmp(text + n - 2, ".\n") != 0) return 0;
+    return gen;
+}
+
+static inline void config_entry_text(const ConfigEntry* e, char* buf, size_t n) {
+    switch(e->type) {
+        case CONFIG_BOOL: snprintf(buf, n, "%s", e->v.b ? "true" : "false"); break;
+        case CONFIG_INT: snprintf(buf, n, "%d", e->v.i); break;
+        default: snprintf(buf, n, "%s", e->v.s); break;
+    }
+}
+
+// Announce that keys changed in cs (already written to config.json).
+// A key list longer than a reader's buffer is left out and the generation
+// skips one, so watchers reload the whole file instead.
+static inline bool config_watch_publish(ConfigWatch* w, const ConfigStore* cs, const char* const* keys, int nkeys) {
+    char text[CONFIG_JOURNAL_MAX];
+    u32 gen = config_journal_read(w, text, sizeof(text));
+    if(gen < w->gen) gen = w->gen;
+    gen++;
+
+    size_t len = snprintf(text, sizeof(text), "gen=%lu\n", (unsigned long)gen);
+    for(int i = 0; i < nkeys && len < sizeof(text); i++) {
+        const ConfigEntry* e = config_store_find(cs, keys[i]);
+        if(!e) continue;
+        char v[CONFIG_VALUE_LEN];
+        config_entry_encode(e, v, sizeof(v));
+        len += snprintf(text + len, sizeof(text) - len, "%s=%s\n", keys[i], v);
+    }
+    if(len + 2 >= sizeof(text)) {
+        gen++;
+        len = snprintf(text, sizeof(text), "gen=%lu\n", (unsigned long)gen);
+    }
+    len += snprintf(text + len, sizeof(text) - len, ".\n");
+
+    FILE* f = fopen(w->journal, "w");
+    if(!f) return false;
+    bool ok = fwrite(text, 1, len, f) == len;
+    if(fclose(f) != 0) ok = false;
+    if(!ok) return false;
+    w->gen = gen;             // our own change needs no reload
+    return true;
+}
+
+// "battery_saver=1" and "battery_saver=true" are the same setting
+static inline bool config_entry_equal(const ConfigEntry* a, const ConfigEntry* b) {
+    if(a->type != CONFIG_STRING && b->type != CONFIG_STRING) {
+        int x = a->type == CONFIG_BOOL ? a->v.b : a->v.i;
+        int y = b->type == CONFIG_BOOL ? b->v.b : b->v.i;
+        return x == y;
+    }
+    return a->type == b->type && strcmp(a->v.s, b->v.s) == 0;
+}
+
+// Reload the whole file and report keys whose value changed or appeared.
+static inline int config_watch_reload(ConfigWatch* w, ConfigStore* cs, ConfigChangeFn fn, void* ctx) {
+    static ConfigStore old;
+    old = *cs;
+    if(!config_store_load(cs, cs->path)) {
+        *cs = old;            // keep the last good table
+        return 0;
+    }
+    w->reloads++;
+    // unsaved local edits win until the writer commits them
+    for(int i = 0; i < CONFIG_STORE_SLOTS; i++) {
+        const ConfigEntry* o = &old.slots[i];
+        if(o->type == CONFIG_NONE || !config_watch_local(w, o->key)) continue;
+        ConfigEntry* e = config_store_entry(cs, o->key);
+        if(e) {
+            e->type = o->type;
+            e->v = o->v;
+        }
+    }
+    int changed = 0;
+    for(int i = 0; i < CONFIG_STORE_SLOTS; i++) {
+        const ConfigEntry* e = &cs->slots[i];
+        if(e->type == CONFIG_NONE) continue;
+        const ConfigEntry* o = config_store_find(&old, e->key);
+        if(o && config_entry_equal(o, e)) continue;
+        if(fn) fn(e->key, e, ctx);
+        changed++;
+    }
+    return changed;
+}
+
+// Cheap enough for the frame loop: does nothing until the period elapsed,
+// then one small read. Returns the number of keys that changed.
+static inline int config_watch_poll(ConfigWatch* w, ConfigStore* cs, u32 now_ms, ConfigChangeFn fn, void* ctx) {
+    if(w->checked && now_ms - w->last_check_ms < CONFIG_WATCH_PERIOD_MS) return 0;
+    w->checked = true;
+    w->last_check_ms = now_ms;
+
+    char text[CONFIG_JOURNAL_MAX];
+    u32 gen = config_journal_read(w, text, sizeof(text));
+    if(gen == 0 || gen == w->gen) return 0;
+
+    if(gen != w->gen + 1) {
+        // we missed a generation: the journal alone is not enough
+        w->gen = gen;
+        return config_watch_reload(w, cs, fn, ctx);
+    }
+    w->gen = gen;
+
+    int changed = 0;
+    char* line = strchr(text, '\n');
+    while(line && *++line && *line != '.') {
+        char* next = strchr(line, '\n');
+        if(next) *next = '\0';
+        char* eq = strchr(line, '=');
+        if(eq) {
+            *eq = '\0';
+            if(!config_watch_local(w, line)) {
+                config_store_set_encoded(cs, line, eq + 1);
+                const ConfigEntry* e = config_store_find(cs, line);
+                if(e && fn) fn(line, e, ctx);
+                changed++;
+            }
+        }
+        line = next;
+    }
+    return changed;
+}
+
+#endif
@@ -0,0 +1,268 @@
+#ifndef CONFIG_WRITER_H
+#define CONFIG_WRITER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "platform.h"
+#include "config_store.h"
+#include "config_watch.h"
+#include "config_snapshot.h"
+
+// Write-back config writer.
+// Setters update the in-memory table and mark the key dirty; nothing
+// touches the SD card until the keys have been quiet for
+// CONFIG_WRITE_DEBOUNCE_MS (or have waited CONFIG_WRITE_MAX_DELAY_MS), or
+// the app calls config_writer_flush() before it exits. A commit re-reads
+// config.json so keys this app never touched survive, overlays the dirty
+// keys, writes the result as JSON to config.json.tmp and renames it into
+// place.
+// A crash leaves either the old file or the complete new one (as .tmp when
+// it hit between remove and rename; config_store_load() picks that up).
+// A file the commit cannot read back in full (a syntax error, too large,
+// values the table cannot hold) is never overwritten: the commit fails and
+// the keys stay dirty until the file is fixed.
+// With a snapshot store attached, the version on disk is snapshotted right
+// before it is replaced.
+
+#define CONFIG_WRITE_DEBOUNCE_MS  1000
+#define CONFIG_WRITE_MAX_DELAY_MS 5000
+#define CONFIG_WRITER_MAX_DIRTY   CONFIG_STORE_MAX_KEYS  // any set of keys goes out in one commit
+
+typedef struct {
+    ConfigStore* cs;
+    ConfigWatch* watch;       // optional: announce commits to other apps
+    ConfigSnapshots* snapshots;  // optional: snapshot before every commit
+    char dirty[CONFIG_WRITER_MAX_DIRTY][CONFIG_KEY_LEN];
+    int ndirty;
+    u32 first_dirty_ms;
+    u32 last_dirty_ms;
+    u32 commits;
+    u32 sets;                 // setter calls; sets - commits were coalesced
+    u32 failures;
+} ConfigWriter;
+
+static inline bool config_writer_is_dirty(const char* key, void* ctx) {
+    const ConfigWriter* w = (const ConfigWriter*)ctx;
+    for(int i = 0; i < w->ndirty; i++)
+        if(strcmp(w->dirty[i], key) == 0) return true;
+    return false;
+}
+
+// With a watch, changes announced by other apps skip the keys still dirty
+// here, so a local edit is not lost before it is committed.
+static inline void config_writer_init(ConfigWriter* w, ConfigStore* cs, ConfigWatch* watch) {
+    memset(w, 0, sizeof(*w));
+    w->cs = cs;
+    w->watch = watch;
+    if(watch) {
+        watch->is_local = config_writer_is_dirty;
+        watch->local_ctx = w;
+    }
+}
+
+// Drop dirty keys the store no longer holds (a reload replaced the table);
+// a commit could not write them anyway.
+static inline void config_writer_compact(ConfigWriter* w) {
+    int n = 0;
+    for(int i = 0; i < w->ndirty; i++) {
+        if(!config_store_find(w->cs, w->dirty[i])) continue;
+        if(n != i) memcpy(w->dirty[n], w->dirty[i], CONFIG_KEY_LEN);
+        n++;
+    }
+    w->ndirty = n;
+}
+
+// The dirty set holds as many keys as the store, so marking never forces a
+// commit: every key stays dirty until a commit writes it.
+static inline void config_writer_mark(ConfigWriter* w, const char* key, u32 now_ms) {
+    w->sets++;
+    w->last_dirty_ms = now_ms;
+    if(!config_store_find(w->cs, key)) {
+        w->failures++;        // the store had no room for it
+        return;
+    }
+    if(config_writer_is_dirty(key, w)) return;
+    if(w->ndirty == CONFIG_WRITER_MAX_DIRTY) config_writer_compact(w);
+    if(w->ndirty == 0) w->first_dirty_ms = now_ms;
+    snprintf(w->dirty[w->ndirty++], CONFIG_KEY_LEN, "%s", key);
+}
+
+static inline void config_writer_set_bool(ConfigWriter* w, const char* key, bool val, u32 now_ms) {
+    config_store_set_bool(w->cs, key, val);
+    config_writer_mark(w, key, now_ms);
+}
+
+static inline void config_writer_set_int(ConfigWriter* w, const char* key, int val, u32 now_ms) {
+    config_store_set_int(w->cs, key, val);
+    config_writer_mark(w, key, now_ms);
+}
+
+static inline void config_writer_set_string(ConfigWriter* w, const char* key, const char* val, u32 now_ms) {
+    config_store_set_string(w->cs, key, val);
+    config_writer_mark(w, key, now_ms);
+}
+
+static inline void config_writer_set_entry(ConfigWriter* w, const ConfigEntry* e, u32 now_ms) {
+    if(e->type == CONFIG_BOOL) config_writer_set_bool(w, e->key, e->v.b, now_ms);
+    else if(e->type == CONFIG_INT) config_writer_set_int(w, e->key, e->v.i, now_ms);
+    else if(e->type == CONFIG_STRING) config_writer_set_string(w, e->key, e->v.s, now_ms);
+}
+
+static inline int config_writer_key_cmp(const void* a, const void* b) {
+    return strcmp((*(const ConfigEntry* const*)a)->key, (*(const ConfigEntry* const*)b)->key);
+}
+
+// Number of leading dotted segments a and b share ("a.b.c", "a.b.d" -> 2).
+static inline int config_common_segments(const char* a, const char* b) {
+    int n = 0;
+    for(;; a++, b++) {
+        if(*a != *b) return n;
+        if(*a == '\0') return n;
+        if(*a == '.') n++;
+    }
+}
+
+// Serialize a table as JSON, turning dotted keys back into nested objects.
+// Keys are sorted, so every object's members are contiguous. Returns bytes,
+// -1 if it does not fit.
+static inline int config_writer_format(const ConfigStore* cs, char* buf, size_t cap) {
+    const ConfigEntry* keys[CONFIG_STORE_MAX_KEYS];
+    int n = 0;
+    for(int i = 0; i < CONFIG_STORE_SLOTS && n < CONFIG_STORE_MAX_KEYS; i++)
+        if(cs->slots[i].type != CONFIG_NONE) keys[n++] = &cs->slots[i];
+    qsort(keys, n, sizeof(keys[0]), config_writer_key_cmp);
+
+    size_t len = 0;
+#define CW_OUT(...) do { \
+        int m_ = snprintf(buf + len, cap - len, __VA_ARGS__); \
+        if(m_ < 0 || (size_t)m_ >= cap - len) return -1; \
+        len += m_; \
+    } while(0)
+    CW_OUT("{");
+    int open = 0;             // nested objects currently open
+    const char* prev = NULL;
+    for(int i = 0; i < n; i++) {
+        const char* key = keys[i]->key;
+        int shared = prev ? config_common_segments(prev, key) : 0;
+        if(shared > open) shared = open;
+        for(; open > shared; open--) CW_OUT("\n%*s}", open * 2, "");
+        if(prev) CW_OUT(",");
+
+        // open objects for the segments this key adds
+        const char* seg = key;
+        for(int s = 0; s < shared; s++) seg = strchr(seg, '.') + 1;
+        const char* dot;
+        while((dot = strchr(seg, '.')) != NULL) {
+            char name[CONFIG_KEY_LEN];
+            snprintf(name, sizeof(name), "%.*s", (int)(dot - seg), seg);
+            char q[JSON_QUOTE_LEN(CONFIG_KEY_LEN)];
+            if(json_quote(q, sizeof(q), name) >= sizeof(q)) return -1;
+            CW_OUT("\n%*s%s: {", (open + 1) * 2, "", q);
+            open++;
+            seg = dot + 1;
+        }
+
+        char q[JSON_QUOTE_LEN(CONFIG_STR_LEN)];
+        if(json_quote(q, sizeof(q), seg) >= sizeof(q)) return -1;
+        CW_OUT("\n%*s%s: ", (open + 1) * 2, "", q);
+        const ConfigEntry* e = keys[i];
+        if(e->type == CONFIG_BOOL) CW_OUT("%s", e->v.b ? "true" : "false");
+        else if(e->type == CONFIG_INT) CW_OUT("%d", e->v.i);
+        else {
+            if(json_quote(q, sizeof(q), e->v.s) >= sizeof(q)) return -1;
+            CW_OUT("%s", q);
+        }
+        prev = key;
+    }
+    for(; open > 0; open--) CW_OUT("\n%*s}", open * 2, "");
+    CW_OUT("\n}\n");
+#undef CW_OUT
+    return (int)len;
+}
+
+// Commit the dirty keys now. Returns true if nothing was pending or the write succeeded.
+static inline bool config_writer_commit(ConfigWriter* w) {
+    if(w->ndirty == 0) return true;
+
+    // start from what is on disk so other apps' keys survive
+    static ConfigStore merged;
+    bool read = config_store_load(&merged, w->cs->path) || merged.status == CONFIG_LOAD_MISSING;
+    if(!read || merged.dropped) {
+        w->failures++;
+        return false;
+    }
+    if(w->snapshots && merged.loaded) config_snapshot_take(w->snapshots, &merged, platform_wall_s());
+    for(int i = 0; i < w->ndirty; i++) {
+        const ConfigEntry* e = config_store_find(w->cs, w->dirty[i]);
+        ConfigEntry* m = e ? config_store_entry(&merged, e->key) : NULL;
+        if(m) {
+            m->type = e->type;
+            m->v = e->v;
+        }
+    }
+    if(merged.dropped) {      // no room for a dirty key
+        w->failures++;
+        return false;
+    }
+
+    char buf[CONFIG_FILE_MAX];
+    int len = config_writer_format(&merged, buf, sizeof(buf));
+    if(len < 0 || !config_write_atomic(w->cs->path, buf, len)) {
+        w->failures++;
+        return false;         // keys stay dirty, the next poll retries
+    }
+    config_stat(w->cs->path, &w->cs->mtime, &w->cs->size);
+    w->commits++;
+
+    if(w->watch) {
+        const char* keys[CONFIG_WRITER_MAX_DIRTY];
+        for(int i = 0; i < w->ndirty; i++) keys[i] = w->dirty[i];
+        config_watch_publish(w->watch, w->cs, keys, w->ndirty);
+    }
+    w->ndirty = 0;
+    return true;
+}
+
+// Roll back to snapshot index (0 = oldest). Every key that differs is set
+// and all of them go out in one commit like any other save, so the version
+// being replaced is snapshotted in turn and a restore can itself be undone.
+// fn sees each changed key. Keys the snapshot lacks are left alone; the
+// writer never deletes. Returns the number of keys changed, -1 on failure
+// (the keys stay dirty and the next poll retries).
+static inline int config_writer_restore(ConfigWriter* w, ConfigSnapshots* ss, int index, u32 now_ms,
+                                        ConfigChangeFn fn, void* ctx) {
+    static ConfigStore snap;
+    config_snapshot_refresh(ss);
+    if(index < 0 || index >= ss->count) return -1;
+    config_snapshot_get(ss, index, &snap);
+    int changed = 0;
+    u32 failures = w->failures;
+    for(int i = 0; i < CONFIG_STORE_SLOTS; i++) {
+        const ConfigEntry* e = &snap.slots[i];
+        if(e->type == CONFIG_NONE) continue;
+        const ConfigEntry* cur = config_store_find(w->cs, e->key);
+        if(cur && config_entry_equal(cur, e)) continue;
+        config_writer_set_entry(w, e, now_ms);
+        if(fn) fn(e->key, e, ctx);
+        changed++;
+    }
+    return config_writer_commit(w) && w->failures == failures ? changed : -1;
+}
+
+// Call every frame; commits once the keys settled.
+static inline void config_writer_poll(ConfigWriter* w, u32 now_ms) {
+    if(w->ndirty == 0) return;
+    if(now_ms - w->last_dirty_ms >= CONFIG_WRITE_DEBOUNCE_MS ||
+       now_ms - w->first_dirty_ms >= CONFIG_WRITE_MAX_DELAY_MS) {
+        if(!config_writer_commit(w)) w->first_dirty_ms = w->last_dirty_ms = now_ms;  // back off
+    }
+}
+
+// Before exit: write whatever is pending.
+static inline bool config_writer_flush(ConfigWriter* w) {
+    return config_writer_commit(w);
+}
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef CONSOLE_DIFF_H
+#define CONSOLE_DIFF_H
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include "platform.h"
+
+// Diffing text console.
+// Apps print into an in-memory cell grid instead of clearing the console
+// with "\x1b[2J" every frame. console_grid_flush() compares the grid with
+// what is already on screen and emits only the changed span of each row,
+// positioned with "\x1b[row;colH". A flush with no changed cell emits
+// nothing. Output goes to stdout (the selected libctru console) unless an
+// emit callback is given, so the diff can be checked against a mock screen.
+
+#define CONSOLE_MAX_COLS 50   // top screen console is 50x30, bottom 40x30
+#define CONSOLE_MAX_ROWS 30
+
+typedef void (*ConsoleEmit)(const char* data, size_t len, void* ctx);
+
+typedef struct {
+    char cur[CONSOLE_MAX_ROWS][CONSOLE_MAX_COLS];
+    char shown[CONSOLE_MAX_ROWS][CONSOLE_MAX_COLS];
+    int cols, rows;
+    int cx, cy;               // write cursor in cur
+    bool dirty;               // some cell of cur differs from shown
+    bool cleared;             // the real console was cleared once
+    ConsoleEmit emit;
+    void* ctx;
+    u32 flushes;              // flushes that emitted anything
+    u32 cells_emitted;
+} ConsoleGrid;
+
+static inline void console_grid_init(ConsoleGrid* g, int cols, int rows, ConsoleEmit emit, void* ctx) {
+    memset(g, 0, sizeof(*g));
+    g->cols = cols > CONSOLE_MAX_COLS ? CONSOLE_MAX_COLS : cols;
+    g->rows = rows > CONSOLE_MAX_ROWS ? CONSOLE_MAX_ROWS : rows;
+    memset(g->cur, ' ', sizeof(g->cur));
+    memset(g->shown, ' ', sizeof(g->shown));
+    g->emit = emit;
+    g->ctx = ctx;
+}
+
+static inline void console_grid_write(ConsoleGrid* g, const char* data, size_t len) {
+    if(g->emit) g->emit(data, len, g->ctx);
+    else fwrite(data, 1, len, stdout);
+}
+
+// Start a new screen: blank the grid and home the cursor. Emits nothing.
+static inline void console_grid_begin(ConsoleGrid* g) {
+    for(int r = 0; r < g->rows; r++) memset(g->cur[r], ' ', g->cols);
+    g->cx = g->cy = 0;
+    g->dirty = true;          // unknown until the next flush compares
+}
+
+static inline void console_grid_goto(ConsoleGrid* g, int col, int row) {
+    g->cx = col;
+    g->cy = row;
+}
+
+// Write text at the cursor. '\n' starts a new row; long lines wrap.
+static inline void console_grid_puts(ConsoleGrid* g, const char* s) {
+    for(; *s; s++) {
+        if(*s == '\n') { g->cx = 0; g->cy++; continue; }
+        if(g->cx >= g->cols) { g->cx = 0; g->cy++; }
+        if(g->cy >= g->rows) return;
+        // printing the bottom-right cell would scroll the console
+        if(g->cy == g->rows - 1 && g->cx == g->cols - 1) return;
+        g->cur[g->cy][g->cx++] = *s;
+    }
+}
+
+static inline void console_grid_printf(ConsoleGrid* g, const char* fmt, ...) {
+    char buf[CONSOLE_MAX_COLS * 4];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    console_grid_puts(g, buf);
+}
+
+// Emit the changed span of every changed row. Returns cells emitted.
+static inline u32 console_grid_flush(ConsoleGrid* g) {
+    if(!g->cleared) {
+        console_grid_write(g, "\x1b[2J", 4);
+        g->cleared = true;
+    }
+    if(!g->dirty) return 0;
+
+    u32 cells = 0;
+    char esc[16];
+    for(int r = 0; r < g->rows; r++) {
+        if(memcmp(g->cur[r], g->shown[r], g->cols) == 0) continue;
+        int first = 0, last = g->cols - 1;
+        while(g->cur[r][first] == g->shown[r][first]) first++;
+        while(g->cur[r][last] == g->shown[r][last]) last--;
+        int n = snprintf(esc, sizeof(esc), "\x1b[%d;%dH", r + 1, first + 1);
+        console_grid_write(g, esc, n);
+        console_grid_write(g, &g->cur[r][first], last - first + 1);
+        memcpy(&g->shown[r][first], &g->cur[r][first], last - first + 1);
+        cells += last - first + 1;
+    }
+    g->dirty = false;
+    if(cells) {
+        g->flushes++;
+        g->cells_emitted += cells;
+    }
+    return cells;
+}
+
+#endif
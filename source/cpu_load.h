@@ -0,0 +1,183 @@
+#ifndef CPU_LOAD_H
+#define CPU_LOAD_H
+
+#include <stdbool.h>
+#include <string.h>
+#include "platform.h"
+
+// Per-core CPU load measurement.
+// A lowest-priority probe thread per core spins for a short window and
+// accumulates the time it actually got to run: consecutive clock reads
+// closer than CPU_LOAD_GAP_US apart count as idle time, longer gaps mean
+// something of higher priority had the core. load = 1 - idle / wall.
+// The probe only spins for CPU_LOAD_WINDOW_MS out of every
+// CPU_LOAD_PERIOD_MS, so it does not keep the core awake between samples.
+//
+// Samples go through a single-producer/single-consumer ring per core; the
+// render thread drains it in cpu_load_update() and keeps a rolling average.
+// The accumulator and estimator are plain functions of a clock trace so
+// they can be checked on the host.
+
+#define CPU_LOAD_MAX_CORES 2
+#define CPU_LOAD_RING      64   // power of two
+#define CPU_LOAD_AVG_N     8    // samples in the rolling average
+#define CPU_LOAD_GAP_US    20
+#define CPU_LOAD_WINDOW_MS 50
+#define CPU_LOAD_PERIOD_MS 250
+#define CPU_LOAD_SYSCORE   30   // percent of core 1 claimed for its probe
+
+typedef struct {
+    u64 last_us;
+    u64 idle_us;
+    u64 start_us;
+} IdleAccumulator;
+
+typedef struct {
+    u32 time_ms;
+    float load;               // percent, 0-100
+} CpuSample;
+
+typedef struct {
+    CpuSample ring[CPU_LOAD_RING];
+    u32 head;                 // written by the probe thread
+    u32 tail;                 // written by the consumer
+    u32 dropped;              // samples lost to a full ring
+} CpuSampleRing;
+
+typedef struct {
+    CpuSampleRing ring;
+    PlatformThread probe;
+    int core;
+
+    // consumer side
+    float window[CPU_LOAD_AVG_N];
+    int count;
+    int next;
+    float last;
+    float avg;
+} CpuCore;
+
+typedef struct {
+    CpuCore cores[CPU_LOAD_MAX_CORES];
+    int core_count;
+    bool running;             // atomic
+} CpuLoad;
+
+static CpuLoad cpu_load;
+
+// --- estimator -------------------------------------------------------
+
+static inline void idle_acc_begin(IdleAccumulator* a, u64 now_us) {
+    a->start_us = a->last_us = now_us;
+    a->idle_us = 0;
+}
+
+// Feed one clock read taken by the probe.
+static inline void idle_acc_step(IdleAccumulator* a, u64 now_us) {
+    u64 d = now_us - a->last_us;
+    if(d <= CPU_LOAD_GAP_US) a->idle_us += d;
+    a->last_us = now_us;
+}
+
+// Load in percent over the accumulated window.
+static inline float idle_acc_load(const IdleAccumulator* a) {
+    u64 wall = a->last_us - a->start_us;
+    if(wall == 0) return 0.0f;
+    float load = 100.0f * (1.0f - (float)a->idle_us / (float)wall);
+    if(load < 0.0f) load = 0.0f;
+    if(load > 100.0f) load = 100.0f;
+    return load;
+}
+
+// --- lock-free SPSC ring ----------------------------------------------
+
+static inline bool cpu_ring_push(CpuSampleRing* r, CpuSample s) {
+    u32 head = r->head;
+    u32 tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    if(head - tail >= CPU_LOAD_RING) { r->dropped++; return false; }
+    r->ring[head & (CPU_LOAD_RING - 1)] = s;
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static inline bool cpu_ring_pop(CpuSampleRing* r, CpuSample* out) {
+    u32 tail = r->tail;
+    u32 head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    if(tail == head) return false;
+    *out = r->ring[tail & (CPU_LOAD_RING - 1)];
+    __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Add one sample to a core's rolling average.
+static inline void cpu_core_add(CpuCore* c, float load) {
+    c->window[c->next] = load;
+    c->next = (c->next + 1) % CPU_LOAD_AVG_N;
+    if(c->count < CPU_LOAD_AVG_N) c->count++;
+    float sum = 0;
+    for(int i = 0; i < c->count; i++) sum += c->window[i];
+    c->avg = sum / c->count;
+    c->last = load;
+}
+
+// --- probe threads ----------------------------------------------------
+
+static void cpu_load_probe(void* arg) {
+    CpuCore* c = (CpuCore*)arg;
+    IdleAccumulator acc;
+    while(__atomic_load_n(&cpu_load.running, __ATOMIC_ACQUIRE)) {
+        u64 now = platform_perf_us();
+        idle_acc_begin(&acc, now);
+        while(now - acc.start_us < CPU_LOAD_WINDOW_MS * 1000ULL) {
+            now = platform_perf_us();
+            idle_acc_step(&acc, now);
+        }
+        CpuSample s = { (u32)(now / 1000), idle_acc_load(&acc) };
+        cpu_ring_push(&c->ring, s);
+        platform_sleep_ms(CPU_LOAD_PERIOD_MS - CPU_LOAD_WINDOW_MS);
+    }
+}
+
+// Claim CPU_LOAD_SYSCORE of core 1, then start one probe per available
+// core. Returns the number of cores probed.
+static inline int cpu_load_start(void) {
+    memset(&cpu_load, 0, sizeof(cpu_load));
+    platform_claim_syscore(CPU_LOAD_SYSCORE);
+    int cores = platform_core_count();
+    if(cores > CPU_LOAD_MAX_CORES) cores = CPU_LOAD_MAX_CORES;
+    __atomic_store_n(&cpu_load.running, true, __ATOMIC_RELEASE);
+    for(int i = 0; i < cores; i++) {
+        CpuCore* c = &cpu_load.cores[cpu_load.core_count];
+        c->core = i;
+        if(platform_thread_start_idle(&c->probe, cpu_load_probe, c, i)) cpu_load.core_count++;
+    }
+    return cpu_load.core_count;
+}
+
+static inline void cpu_load_stop(void) {
+    __atomic_store_n(&cpu_load.running, false, __ATOMIC_RELEASE);
+    for(int i = 0; i < cpu_load.core_count; i++) platform_thread_join(&cpu_load.cores[i].probe);
+    cpu_load.core_count = 0;
+}
+
+// Drain the probe rings; call once per frame from the render thread.
+// Returns true if any new sample arrived.
+static inline bool cpu_load_update(void) {
+    bool fresh = false;
+    for(int i = 0; i < cpu_load.core_count; i++) {
+        CpuCore* c = &cpu_load.cores[i];
+        CpuSample s;
+        while(cpu_ring_pop(&c->ring, &s)) {
+            cpu_core_add(c, s.load);
+            fresh = true;
+        }
+    }
+    return fresh;
+}
+
+// Rolling average in percent for core index i (0 if not probed).
+static inline float cpu_load_avg(int i) {
+    return i < cpu_load.core_count ? cpu_load.cores[i].avg : 0.0f;
+}
+
+#endif
@@ -8,9 +8,23 @@
 #include <stdbool.h>
 #include <string.h>
 #include "system_utils.h"
-#include "json_parser.h"
+#include "config_store.h"
+#include "status_text.h"
+#include "sensors.h"
+#include "text_cache.h"
+#include "scene.h"
+#include "battery_history.h"
+#include "config_watch.h"
+#include "config_writer.h"
+#include "config_snapshot.h"
+#include "ui_page.h"
+#include "sd_index.h"
+#include "mem_track.h"
+#include "input.h"
 
 #define CONFIG_PATH "/3ds/system_enhancer/config.json"
+#define PERF_LOG_FLAG "/3ds/system_enhancer/perf_log.flag"
+#define BATTERY_HISTORY_PATH "/3ds/system_enhancer/battery_history.bin"
 
 #define SCREEN_W 400
 #define SCREEN_H 240
@@ -20,63 +34,338 @@ typedef enum {
     PAGE_DISPLAY,
     PAGE_POWER,
     PAGE_PERFORMANCE,
+    PAGE_MEMORY,
     PAGE_ADVANCED,
     PAGE_COUNT
 } Page;
 
 // UI state
-static Page currentPage = PAGE_MAIN;
-static int cursor = 0;
+static ConfigStore config;
+static ConfigWatch configWatch;
+static ConfigWriter configWriter;
+static ConfigSnapshots snapshots;   // config.snap: the version before each save
+static int snapshotAge;             // Advanced page selection, 0 = newest
+static char snapshotStatus[48];     // outcome of the last snapshot action
+static u32 snapshotActions;
 static bool battery_saver = false;
 static int brightness = 100; // 0-100 (we store in config)
-static bool show_help = false;
+static BatteryHistory batteryHistory;
+static bool perf_logging = false; // perf_log.flag present: the overlay logs telemetry
+static SdIndex sdIndex;             // SD usage per directory, walked on a worker
+static Input input;                 // HID sampled on its own thread; D-pad repeats
+
+// Sensor readings of the current frame, shown by the page tables
+static int batt;
+static u32 mem;
+static u64 sd;
+static u32 wall;
 
 // Helpers to read/write config keys
 static void load_settings() {
-    battery_saver = read_bool_config(CONFIG_PATH, "battery_saver", false);
-    // brightness stored as key "brightness", as 0/100 integer
-    FILE *f = fopen(CONFIG_PATH, "r");
-    if(!f) return;
-    char line[128];
-    while(fgets(line, sizeof(line), f)) {
-        char k[64], v[64];
-        if(sscanf(line, "%63[^=]=%63s", k, v) == 2) {
-            if(strcmp(k, "brightness") == 0) {
-                brightness = atoi(v);
-            }
-        }
-    }
-    fclose(f);
+    // one bulk read + parse; both keys come from the same in-memory table
+    config_store_load(&config, CONFIG_PATH);
+    config_watch_start(&configWatch, CONFIG_PATH);
+    config_writer_init(&configWriter, &config, &configWatch);
+    config_snapshot_init(&snapshots, CONFIG_PATH);
+    configWriter.snapshots = &snapshots;
+    battery_saver = config_store_get_bool(&config, "battery_saver", false);
+    brightness = config_store_get_int(&config, "brightness", 100);
 }
 
+// Only marks the keys dirty; configWriter batches them into one SD write
 static void save_settings() {
-    // we will write both keys (simple overwrite file)
-    FILE *f = fopen(CONFIG_PATH, "w");
-    if(!f) return;
-    fprintf(f, "battery_saver=%d\n", battery_saver?1:0);
-    fprintf(f, "brightness=%d\n", brightness);
-    fclose(f);
-}
-
-// draw a small label with optional highlight
-static void draw_label(C2D_TextBuf textBuf, float x, float y, const char* text, bool highlight) {
-    C2D_Text textObj;
-    C2D_TextBufClear(textBuf);
-    C2D_TextBufAdd(textBuf, text);
-    textObj = C2D_TextParse(textBuf);
-    float sx = highlight ? 1.05f : 1.0f;
-    u32 color = highlight ? C2D_Color32(255,255,0,255) : C2D_Color32(255,255,255,255);
-    C2D_DrawText(&textObj, C2D_WithColor, x, y, 0.5f, sx, sx, color);
-}
-
-// draw a slider (x,y,width) with value 0..100
-static void draw_slider(float x, float y, float w, int value) {
-    float filled = (w * value) / 100.0f;
-    C2D_DrawRectSolid(x, y, 0, filled, 10, C2D_Color32(0,160,255,255));
-    C2D_DrawRectOutline(x, y, 0, w, 10, C2D_Color32(255,255,255,255), 2.0f);
-    char buf[32];
-    snprintf(buf, sizeof(buf), "%d%%", value);
-    C2D_DrawTextBuf(C2D_TextBufNew(), x+w+8, y-2, 0, 0.6f, 0.6f, buf, C2D_Color32(255,255,255,255));
+    u32 now = platform_ms();
+    config_writer_set_bool(&configWriter, "battery_saver", battery_saver, now);
+    config_writer_set_int(&configWriter, "brightness", brightness, now);
+}
+
+// The overlay toggled something while we run: follow it
+static void on_config_change(const char* key, const ConfigEntry* e, void* ctx) {
+    (void)e; (void)ctx;
+    if(strcmp(key, "battery_saver") == 0) {
+        battery_saver = config_store_get_bool(&config, key, false);
+        set_battery_saver(battery_saver);
+    } else if(strcmp(key, "brightness") == 0) {
+        brightness = config_store_get_int(&config, key, 100);
+        platform_set_brightness(brightness, brightness);
+    }
+}
+
+// Text: constant strings are interned once, dynamic lines live in slots
+// that re-parse only when their contents change.
+static TextCache textCache;
+static TextSlot textSlots[UI_MAX_SLOTS];
+
+// Retained scene: the top screen is only redrawn when one of these changes
+enum {
+    W_NAV = 0,     // page, focus, help overlay
+    W_BATTERY,
+    W_SAVER,
+    W_BRIGHTNESS,
+    W_MEMORY,
+    W_SD,
+    W_SENSOR_STATS,
+    W_HISTORY,
+    W_SNAPSHOTS,
+    W_SD_INDEX,
+    W_MEM_TRACK,
+    W_COUNT
+};
+static Scene scene;
+
+static void on_apt_event(APT_HookType hook, void* param) {
+    (void)param;
+    if(hook == APTHOOK_ONRESTORE || hook == APTHOOK_ONWAKEUP) scene_invalidate(&scene);
+    // HOME may close us while suspended: get pending settings onto SD first
+    if(hook == APTHOOK_ONSUSPEND || hook == APTHOOK_ONSLEEP) config_writer_flush(&configWriter);
+}
+
+// Dynamic text of the page tables
+
+static void text_battery(const UiWidget* w, char* buf, size_t n) { (void)w; status_battery(buf, n, (u8)batt); }
+static void text_saver(const UiWidget* w, char* buf, size_t n) { (void)w; status_saver(buf, n, battery_saver); }
+static void text_free_mem(const UiWidget* w, char* buf, size_t n) { (void)w; status_free_mem(buf, n, mem); }
+
+static void text_brightness(const UiWidget* w, char* buf, size_t n) {
+    (void)w;
+    snprintf(buf, n, "Brightness: %d%% (adjust on Display page)", brightness);
+}
+
+static void text_history(const UiWidget* w, char* buf, size_t n) {
+    (void)w;
+    char tte[16];
+    battery_history_format_tte(tte, sizeof(tte), battery_history_tte(&batteryHistory, wall));
+    snprintf(buf, n, "Smoothed: %d%%  Time to empty: %s", (int)battery_history_smoothed(&batteryHistory, wall), tte);
+}
+
+static void text_sd_free(const UiWidget* w, char* buf, size_t n) {
+    (void)w;
+    if(sd) status_sd_free(buf, n, sd);
+    else snprintf(buf, n, "SD free: ...");
+}
+
+// per-sensor sample cost, for tuning the periods
+static void text_sensor_stats(const UiWidget* w, char* buf, size_t n) {
+    sensors_format_stats((SensorId)w->arg, buf, n);
+}
+
+// SD usage index: progress or totals, then the biggest top-level folders
+static void text_sd_index(const UiWidget* w, char* buf, size_t n) {
+    (void)w;
+    sd_index_status(&sdIndex, buf, (int)n);
+}
+
+static void text_sd_top(const UiWidget* w, char* buf, size_t n) {
+    (void)w;
+    sd_index_top(&sdIndex, 3, buf, (int)n);
+}
+
+static void text_frames(const UiWidget* w, char* buf, size_t n) {
+    (void)w;
+    char latency[40];
+    input_format_latency(&input, latency, sizeof(latency));
+    snprintf(buf, n, "Frames drawn %lu, skipped %lu, %s",
+             (unsigned long)scene.frames_rendered, (unsigned long)scene.frames_skipped, latency);
+}
+
+// Memory page: process/system figures, then what each subsystem holds
+static void text_mem_process(const UiWidget* w, char* buf, size_t n) {
+    (void)w;
+    mem_format_process(buf, n);
+}
+
+static void text_mem_total(const UiWidget* w, char* buf, size_t n) {
+    (void)w;
+    mem_track_format_total(buf, n);
+}
+
+static void text_mem_sub(const UiWidget* w, char* buf, size_t n) {
+    mem_track_format((MemSubsystem)w->arg, buf, n);
+}
+
+// Actions of the page tables
+
+static void on_brightness(UiApp* app, UiWidget* w) {
+    (void)app; (void)w;
+    platform_set_brightness(brightness, brightness);
+    save_settings();
+}
+
+static void on_battery_saver(UiApp* app, UiWidget* w) {
+    (void)app; (void)w;
+    set_battery_saver(battery_saver);
+    save_settings();
+}
+
+// toggle telemetry logging in the overlay (perf_log.bin)
+static void on_perf_logging(UiApp* app, UiWidget* w) {
+    (void)app; (void)w;
+    if(!perf_logging) {
+        perf_logging = remove(PERF_LOG_FLAG) != 0;
+    } else {
+        FILE *f = fopen(PERF_LOG_FLAG, "w");
+        if(f) { fprintf(f,"1\n"); fclose(f); }
+        else perf_logging = false;
+    }
+}
+
+static void on_open_display(UiApp* app, UiWidget* w) {
+    (void)w;
+    ui_goto_page(app, PAGE_DISPLAY);
+}
+
+static void on_launch_overlay(UiApp* app, UiWidget* w) {
+    (void)app; (void)w;
+    // We can't start another .3dsx from here easily; instead we write a "launch" flag.
+    FILE *f = fopen("/3ds/system_enhancer/launch_overlay.flag","w");
+    if(f) { fprintf(f,"1\n"); fclose(f); }
+}
+
+// Snapshots on the Advanced page. The list slider counts back from the
+// newest snapshot; its range follows the store.
+enum { ADV_SNAPSHOT_LIST = 1 };
+static UiPage pages[PAGE_COUNT];
+
+static int snapshot_index(void) {
+    return snapshots.count - 1 - snapshotAge;
+}
+
+static void sync_snapshots(void) {
+    UiWidget* w = &pages[PAGE_ADVANCED].widgets[ADV_SNAPSHOT_LIST];
+    w->max = snapshots.count > 0 ? snapshots.count - 1 : 0;
+    if(snapshotAge > w->max) snapshotAge = w->max;
+}
+
+static void text_snapshots(const UiWidget* w, char* buf, size_t n) {
+    (void)w;
+    snprintf(buf, n, "Snapshots: %d of %d, one before every save. %s",
+             snapshots.count, CONFIG_SNAP_MAX, snapshotStatus);
+}
+
+static void text_snapshot_sel(const UiWidget* w, char* buf, size_t n) {
+    (void)w;
+    if(snapshots.count == 0) {
+        snprintf(buf, n, "No snapshots yet");
+        return;
+    }
+    // how far the selected version is from what is set now
+    static ConfigStore snap;
+    config_snapshot_get(&snapshots, snapshot_index(), &snap);
+    int differ = 0;
+    for(int i = 0; i < CONFIG_STORE_SLOTS; i++) {
+        const ConfigEntry* e = &snap.slots[i];
+        const ConfigEntry* cur = e->type != CONFIG_NONE ? config_store_find(&config, e->key) : NULL;
+        if(e->type != CONFIG_NONE && !(cur && config_entry_equal(cur, e))) differ++;
+    }
+    char label[32];
+    config_snapshot_label(&snapshots, snapshot_index(), label, sizeof(label));
+    snprintf(buf, n, "%s  %d key%s differ%s", label, differ, differ == 1 ? "" : "s", differ == 1 ? "s" : "");
+}
+
+static void on_snapshot_restore(UiApp* app, UiWidget* w) {
+    (void)app; (void)w;
+    if(snapshots.count == 0) return;
+    u32 id = snapshots.snaps[snapshot_index()].id;
+    int n = config_writer_restore(&configWriter, &snapshots, snapshot_index(), platform_ms(), on_config_change, NULL);
+    if(n < 0) snprintf(snapshotStatus, sizeof(snapshotStatus), "Restore failed");
+    else snprintf(snapshotStatus, sizeof(snapshotStatus), "Restored #%lu (%d keys)", (unsigned long)id, n);
+    snapshotAge = 0;          // the version we replaced is the newest now
+    snapshotActions++;
+}
+
+static void on_snapshot_delete(UiApp* app, UiWidget* w) {
+    (void)app; (void)w;
+    if(snapshots.count == 0) return;
+    u32 id = snapshots.snaps[snapshot_index()].id;
+    bool ok = config_snapshot_delete(&snapshots, snapshot_index());
+    snprintf(snapshotStatus, sizeof(snapshotStatus), ok ? "Deleted #%lu" : "Delete of #%lu failed", (unsigned long)id);
+    snapshotActions++;
+}
+
+static void on_snapshot_prune(UiApp* app, UiWidget* w) {
+    (void)app; (void)w;
+    bool ok = config_snapshot_prune(&snapshots, CONFIG_SNAP_KEEP);
+    snprintf(snapshotStatus, sizeof(snapshotStatus), ok ? "Pruned" : "Prune failed");
+    snapshotActions++;
+}
+
+static void on_quick_save(UiApp* app, UiWidget* w) {
+    (void)app; (void)w;
+    save_settings();
+    config_writer_flush(&configWriter);
+}
+
+static UiPage pages[PAGE_COUNT] = {
+    [PAGE_MAIN] = { .tab = "[Main]  (L/R to change)", .title = "Overview", .widgets = {
+        { .kind = UI_INFO, .text = text_battery },
+        { .kind = UI_INFO, .text = text_saver },
+        { .kind = UI_INFO, .text = text_brightness },
+        { .kind = UI_ACTION, .label = "Display settings", .on_change = on_open_display },
+        { .kind = UI_ACTION, .label = "Request overlay launch", .on_change = on_launch_overlay },
+    } },
+    [PAGE_DISPLAY] = { .tab = "[Display]  (L/R to change)", .title = "Display Settings", .widgets = {
+        { .kind = UI_SLIDER, .label = "Brightness", .value = &brightness,
+          .min = 0, .max = 100, .step = 10, .flags = UI_F_EDIT, .on_change = on_brightness },
+    } },
+    [PAGE_POWER] = { .tab = "[Power]  (L/R to change)", .title = "Power & Battery", .widgets = {
+        { .kind = UI_TOGGLE, .label = "Battery Saver", .flag = &battery_saver, .on_change = on_battery_saver },
+        { .kind = UI_SLIDER, .label = "Battery level", .value = &batt, .min = 0, .max = 100 },
+        { .kind = UI_INFO, .text = text_history },
+    } },
+    [PAGE_PERFORMANCE] = { .tab = "[Performance]  (L/R to change)", .title = "Performance", .widgets = {
+        { .kind = UI_INFO, .text = text_free_mem },
+        { .kind = UI_INFO, .text = text_sd_free },
+        { .kind = UI_TOGGLE, .label = "Overlay telemetry log", .flag = &perf_logging, .on_change = on_perf_logging },
+        { .kind = UI_INFO, .text = text_sensor_stats, .arg = SENSOR_BATTERY, .flags = UI_F_SMALL },
+        { .kind = UI_INFO, .text = text_sensor_stats, .arg = SENSOR_FREE_MEM, .flags = UI_F_SMALL },
+        { .kind = UI_INFO, .text = text_sensor_stats, .arg = SENSOR_SD_FREE, .flags = UI_F_SMALL },
+        { .kind = UI_INFO, .text = text_frames, .flags = UI_F_SMALL },
+        { .kind = UI_INFO, .text = text_sd_index, .flags = UI_F_SMALL },
+        { .kind = UI_INFO, .text = text_sd_top, .flags = UI_F_SMALL },
+    } },
+    [PAGE_MEMORY] = { .tab = "[Memory]  (L/R to change)", .title = "Memory", .widgets = {
+        { .kind = UI_INFO, .text = text_mem_process, .flags = UI_F_SMALL },
+        { .kind = UI_INFO, .text = text_mem_total, .flags = UI_F_SMALL },
+        { .kind = UI_INFO, .text = text_mem_sub, .arg = MEM_TEXT, .flags = UI_F_SMALL },
+        { .kind = UI_INFO, .text = text_mem_sub, .arg = MEM_CONFIG, .flags = UI_F_SMALL },
+        { .kind = UI_INFO, .text = text_mem_sub, .arg = MEM_SD_INDEX, .flags = UI_F_SMALL },
+        { .kind = UI_INFO, .text = text_mem_sub, .arg = MEM_UI, .flags = UI_F_SMALL },
+        { .kind = UI_INFO, .text = text_mem_sub, .arg = MEM_OTHER, .flags = UI_F_SMALL },
+    } },
+    [PAGE_ADVANCED] = { .tab = "[Advanced]  (L/R to change)", .title = "Advanced", .widgets = {
+        { .kind = UI_INFO, .text = text_snapshots, .flags = UI_F_SMALL },
+        [ADV_SNAPSHOT_LIST] = { .kind = UI_SLIDER, .label = "Snapshot", .text = text_snapshot_sel,
+          .value = &snapshotAge, .min = 0, .max = 0, .step = 1, .flags = UI_F_EDIT },
+        { .kind = UI_ACTION, .label = "Restore selected snapshot", .on_change = on_snapshot_restore },
+        { .kind = UI_ACTION, .label = "Delete selected snapshot", .on_change = on_snapshot_delete },
+        { .kind = UI_ACTION, .label = "Prune to the newest 4", .on_change = on_snapshot_prune },
+        { .kind = UI_ACTION, .label = "Quick save to config (writes now)", .on_change = on_quick_save },
+    } },
+};
+static UiApp ui = { "Enhanced Settings", pages, PAGE_COUNT, PAGE_MAIN, 0, false };
+static UiDrawList drawList;
+
+// Submit the sorted draw list: per layer, every rect and then every text
+static void submit_draw_list(const UiDrawList* dl) {
+    int layers = ui_layer_count(dl);
+    for(int l = 0; l < layers; l++) {
+        for(int i = 0; i < dl->rect_count; i++) {
+            const UiRect* r = &dl->rects[i];
+            if(r->layer != l) continue;
+            if(r->outline) C2D_DrawRectOutline(r->x, r->y, 0, r->w, r->h, r->color, 2.0f);
+            else C2D_DrawRectSolid(r->x, r->y, 0, r->w, r->h, r->color);
+        }
+        for(int i = 0; i < dl->text_count; i++) {
+            const UiText* t = &dl->texts[i];
+            if(t->layer != l) continue;
+            if(t->str) {
+                text_cache_draw(&textCache, t->str, t->x, t->y, t->scale, t->color);
+            } else {
+                text_slot_set(&textSlots[t->slot], dl->slot_text[t->slot]);
+                text_slot_draw(&textSlots[t->slot], t->x, t->y, t->scale, t->color);
+            }
+        }
+    }
 }
 
 int main(int argc, char **argv) {
@@ -91,156 +380,130 @@ int main(int argc, char **argv) {
     // load persisted settings
     load_settings();
     set_battery_saver(battery_saver);
-    gfxSetBrightness(GFX_TOP, brightness);
-    gfxSetBrightness(GFX_BOTTOM, brightness);
+    platform_set_brightness(brightness, brightness);
+
+    // battery/memory are sampled on their own periods, SD free on a worker
+    sensors_init();
+    sensors_start_worker();
+    // rescans only the folders that changed since the saved index
+    if(sd_index_init(&sdIndex, "/", SD_INDEX_FILE)) sd_index_start(&sdIndex);
+    battery_history_load(&batteryHistory, BATTERY_HISTORY_PATH);
+
+    FILE *flag = fopen(PERF_LOG_FLAG, "r");
+    if(flag) { fclose(flag); perf_logging = true; }
 
-    // Text buffers reused across frames
-    C2D_TextBuf titleBuf = C2D_TextBufNew();
-    C2D_TextBuf itemBuf = C2D_TextBufNew();
-    C2D_TextBuf infoBuf = C2D_TextBufNew();
+    // Fixed-size text buffers, allocated once
+    text_cache_init(&textCache);
+    for(int i = 0; i < UI_MAX_SLOTS; i++) text_slot_init(&textSlots[i]);
+    ui_layout(&ui);
+
+    // the fixed tables; heap and citro2d buffers are counted as they come
+    mem_track_static(MEM_CONFIG, sizeof(config) + sizeof(configWatch) + sizeof(configWriter) + sizeof(snapshots));
+    mem_track_static(MEM_SD_INDEX, sizeof(sdIndex));
+    mem_track_static(MEM_TEXT, sizeof(textCache) + sizeof(textSlots));
+    mem_track_static(MEM_UI, sizeof(pages) + sizeof(drawList) + sizeof(scene));
+    mem_track_static(MEM_OTHER, sizeof(batteryHistory));
+    mem_track_mark();
+
+    aptHookCookie aptCookie;
+    aptHook(&aptCookie, on_apt_event, NULL);
+    scene_init(&scene);
+
+    // holding Left/Right walks a slider, faster the longer it is held
+    InputConfig inputConfig;
+    input_config_defaults(&inputConfig, KEY_UP | KEY_DOWN | KEY_LEFT | KEY_RIGHT);
+    input_config_load(&inputConfig, &config);
+    input_init(&input, &inputConfig);
+    input_start(&input);
 
-    u32 lastTick = svcGetSystemTick();
     while(aptMainLoop()) {
-        hidScanInput();
-        u32 kDown = hidKeysDown();
-        u32 kHeld = hidKeysHeld();
+        // Navigation and edits, one queued press or repeat at a time: L/R
+        // change page, Left/Right the focused slider (or the page), Up/Down
+        // move the focus, A toggles/activates
+        u32 kDown = 0;
+        InputEvent ev;
+        while(input_next(&input, &ev)) {
+            if(ev.type == INPUT_RELEASE) continue;
+            if(ev.type == INPUT_PRESS) kDown |= ev.key;
+            ui_input(&ui, ui_keys(ev.key));
+        }
 
         if(kDown & KEY_START) break;
-        if(kDown & KEY_L) { // quick save
-            save_settings();
-        }
-        if(kDown & KEY_SELECT) {
-            show_help = !show_help;
-        }
+        sensors_poll();
+        // another app saved: it snapshotted the version it replaced
+        if(config_watch_poll(&configWatch, &config, platform_ms(), on_config_change, NULL) > 0)
+            config_snapshot_refresh(&snapshots);
+        if(kDown & KEY_X) on_quick_save(&ui, NULL);
+        config_writer_poll(&configWriter, platform_ms());
 
-        // Navigation: left/right change page, up/down move cursor, A toggles/activates
-        if(kDown & KEY_RIGHT) {
-            currentPage = (currentPage + 1) % PAGE_COUNT;
-            cursor = 0;
-        } else if(kDown & KEY_LEFT) {
-            currentPage = (currentPage - 1 + PAGE_COUNT) % PAGE_COUNT;
-            cursor = 0;
-        } else if(kDown & KEY_DOWN) {
-            cursor++;
-        } else if(kDown & KEY_UP) {
-            cursor--;
+        // push visible state; skip the frame if nothing changed
+        int nav[4] = { ui.page, ui.focus, ui.help, perf_logging };
+        batt = (u8)sensors_get(SENSOR_BATTERY);
+        mem = (u32)sensors_get(SENSOR_FREE_MEM);
+        sd = sensors_valid(SENSOR_SD_FREE) ? sensors_get(SENSOR_SD_FREE) : 0;
+        wall = platform_wall_s();
+        battery_history_add(&batteryHistory, wall, (u8)batt);
+        battery_history_maybe_save(&batteryHistory, BATTERY_HISTORY_PATH, wall);
+        int history[2] = { (int)battery_history_smoothed(&batteryHistory, wall),
+                           (int)battery_history_tte(&batteryHistory, wall) };
+        u32 sampleCount = 0;
+        if(ui.page == PAGE_PERFORMANCE)
+            for(int i = 0; i < SENSOR_COUNT; i++) sampleCount += sensors.s[i].samples;
+        scene_update(&scene, W_NAV, nav, sizeof(nav));
+        scene_update(&scene, W_BATTERY, &batt, sizeof(batt));
+        scene_update(&scene, W_SAVER, &battery_saver, sizeof(battery_saver));
+        scene_update(&scene, W_BRIGHTNESS, &brightness, sizeof(brightness));
+        scene_update(&scene, W_MEMORY, &mem, sizeof(mem));
+        scene_update(&scene, W_SD, &sd, sizeof(sd));
+        scene_update(&scene, W_SENSOR_STATS, &sampleCount, sizeof(sampleCount));
+        scene_update(&scene, W_HISTORY, history, sizeof(history));
+        sync_snapshots();
+        u32 snapState[4] = { (u32)snapshots.count, snapshots.next_id, (u32)snapshotAge, snapshotActions };
+        scene_update(&scene, W_SNAPSHOTS, snapState, sizeof(snapState));
+        u32 indexState[3] = { __atomic_load_n(&sdIndex.generation, __ATOMIC_ACQUIRE),
+                              (u32)__atomic_load_n(&sdIndex.state, __ATOMIC_ACQUIRE),
+                              ui.page == PAGE_PERFORMANCE ? __atomic_load_n(&sdIndex.visited, __ATOMIC_RELAXED) : 0 };
+        scene_update(&scene, W_SD_INDEX, indexState, sizeof(indexState));
+        u32 memState[4] = { mem_tracker.live_bytes, mem_tracker.peak_bytes, 0, 0 };
+        if(ui.page == PAGE_MEMORY) {
+            PlatformMemInfo m;
+            platform_mem_info(&m);
+            memState[2] = m.heap_used;
+            memState[3] = m.app_used;
         }
-        if(cursor < 0) cursor = 0;
-        if(cursor > 5) cursor = 5; // safety upper limit
-
-        // Page interactions
-        if(currentPage == PAGE_MAIN) {
-            if(kDown & KEY_A) {
-                // A opens the first page (Display)
-                currentPage = PAGE_DISPLAY;
-                cursor = 0;
-            }
-            if(kDown & KEY_Y) {
-                // Launch graphical overlay immediately
-                // Attempt to launch overlay app by asking user to run it from HOME.
-                // We can't start another .3dsx from here easily; instead we write a "launch" flag.
-                FILE *f = fopen("/3ds/system_enhancer/launch_overlay.flag","w");
-                if(f) { fprintf(f,"1\n"); fclose(f); }
-            }
-        } else if(currentPage == PAGE_DISPLAY) {
-            if(kDown & KEY_LEFT) { brightness = (brightness - 10); if(brightness < 0) brightness = 0; gfxSetBrightness(GFX_TOP, brightness); gfxSetBrightness(GFX_BOTTOM, brightness); }
-            if(kDown & KEY_RIGHT) { brightness = (brightness + 10); if(brightness > 100) brightness = 100; gfxSetBrightness(GFX_TOP, brightness); gfxSetBrightness(GFX_BOTTOM, brightness); }
-            if(kDown & KEY_A) {
-                // confirm save
-                save_settings();
-            }
-        } else if(currentPage == PAGE_POWER) {
-            if(kDown & KEY_A) {
-                battery_saver = !battery_saver;
-                set_battery_saver(battery_saver);
-                save_settings();
-            }
-        } else if(currentPage == PAGE_PERFORMANCE) {
-            // nothing toggleable yet; maybe future logging
-            if(kDown & KEY_A) {
-                // toggle a demo log file
-                FILE *f = fopen("/3ds/system_enhancer/perf_log.flag","w");
-                if(f) { fprintf(f,"1\n"); fclose(f); }
-            }
-        } else if(currentPage == PAGE_ADVANCED) {
-            if(kDown & KEY_A) {
-                // export config: copy config file to /3ds/system_enhancer/config_backup.txt
-                FILE *in = fopen(CONFIG_PATH, "r");
-                FILE *out = fopen("/3ds/system_enhancer/config_backup.txt", "w");
-                if(in && out) {
-                    char buf[256];
-                    while(fgets(buf, sizeof(buf), in)) fputs(buf, out);
-                    fclose(in); fclose(out);
-                }
-            }
+        scene_update(&scene, W_MEM_TRACK, memState, sizeof(memState));
+        if(!scene_should_render(&scene)) {
+            scene_end_frame(&scene, false);
+            input_frame_end(&input, false);
+            gspWaitForVBlank();
+            input_vblank(&input, platform_perf_us());
+            continue;
         }
 
         // draw UI
+        ui_emit(&ui, &drawList);
+        // SYNCDRAW waits for the vblank, so the last frame is on screen now
         C3D_FrameBegin(C3D_FRAME_SYNCDRAW);
-        C2D_TargetClear(top, C2D_Color32(8,8,16,255));
+        input_vblank(&input, platform_perf_us());
+        C2D_TargetClear(top, UI_COLOR_BG);
         C2D_SceneBegin(top);
+        submit_draw_list(&drawList);
+        C3D_FrameEnd(0);
+        input_frame_end(&input, true);
+        scene_end_frame(&scene, true);
+    }
 
-        // Title
-        C2D_Text title = C2D_TextParse(C2D_TextBufAdd(titleBuf, "Enhanced Settings"));
-        C2D_DrawText(&title, C2D_WithColor, 16, 8, 0, 1.2f, 1.2f, C2D_Color32(200,200,255,255));
-
-        // Page indicator
-        const char* pageNames[PAGE_COUNT] = { "Main", "Display", "Power", "Performance", "Advanced" };
-        char pageLabel[64];
-        snprintf(pageLabel, sizeof(pageLabel), "[%s]  (Left/Right to change)", pageNames[currentPage]);
-        C2D_DrawTextBuf(itemBuf, 16, 36, 0, 0.6f, 0.6f, pageLabel, C2D_Color32(200,200,200,255));
-
-        // Draw current page contents
-        switch(currentPage) {
-            case PAGE_MAIN: {
-                C2D_DrawTextBuf(itemBuf, 24, 60, 0, 0.9f, 0.9f, "Overview", C2D_Color32(255,255,255,255));
-                char line[128];
-                snprintf(line, sizeof(line), "Battery: %d%%", get_battery_percent());
-                C2D_DrawTextBuf(infoBuf, 24, 90, 0, 0.8f, 0.8f, line, C2D_Color32(255,255,255,255));
-                snprintf(line, sizeof(line), "Battery Saver: %s", battery_saver ? "ON" : "OFF");
-                C2D_DrawTextBuf(infoBuf, 24, 110, 0, 0.8f, 0.8f, line, C2D_Color32(255,255,255,255));
-                snprintf(line, sizeof(line), "Brightness: %d%% (Left/Right to adjust on Display page)", brightness);
-                C2D_DrawTextBuf(infoBuf, 24, 130, 0, 0.7f, 0.7f, line, C2D_Color32(220,220,220,255));
-                C2D_DrawTextBuf(infoBuf, 24, 160, 0, 0.7f, 0.7f, "Press Y to request overlay launch, A to go to Display.", C2D_Color32(200,200,200,255));
-                break;
-            }
-
-            case PAGE_DISPLAY: {
-                C2D_DrawTextBuf(itemBuf, 24, 60, 0, 0.9f, 0.9f, "Display Settings", C2D_Color32(255,255,255,255));
-                C2D_DrawTextBuf(infoBuf, 24, 90, 0, 0.7f, 0.7f, "Brightness (Left/Right to change, A to save)", C2D_Color32(200,200,200,255));
-                draw_slider(24, 120, 220, brightness);
-                break;
-            }
-
-            case PAGE_POWER: {
-                C2D_DrawTextBuf(itemBuf, 24, 60, 0, 0.9f, 0.9f, "Power & Battery", C2D_Color32(255,255,255,255));
-                char bs[64];
-                snprintf(bs, sizeof(bs), "Battery Saver: %s (A to toggle)", battery_saver ? "ON" : "OFF");
-                C2D_DrawTextBuf(infoBuf, 24, 90, 0, 0.8f, 0.8f, bs, C2D_Color32(255,255,255,255));
-                // battery bar preview
-                int batt = get_battery_percent();
-                draw_slider(24, 120, 220, batt);
-                break;
-            }
-
-            case PAGE_PERFORMANCE: {
-                C2D_DrawTextBuf(itemBuf, 24, 60, 0, 0.9f, 0.9f, "Performance", C2D_Color32(255,255,255,255));
-                char perf[128];
-                snprintf(perf, sizeof(perf), "Free mem: %u bytes", get_free_memory());
-                C2D_DrawTextBuf(infoBuf, 24, 90, 0, 0.7f, 0.7f, perf, C2D_Color32(200,200,200,255));
-                u64 sd = get_sd_free();
-                char sdbuf[128];
-                snprintf(sdbuf, sizeof(sdbuf), "SD free: %llu bytes", sd);
-                C2D_DrawTextBuf(infoBuf, 24, 110, 0, 0.7f, 0.7f, sdbuf, C2D_Color32(200,200,200,255));
-                C2D_DrawTextBuf(infoBuf, 24, 140, 0, 0.7f, 0.7f, "Press A to mark perf logging flag", C2D_Color32(200,200,200,255));
-                break;
-            }
-
-            case PAGE_ADVANCED: {
-                C2D_DrawTextBuf(itemBuf, 24, 60, 0, 0.9f, 0.9f, "Advanced", C2D_Color32(255,255,255,255));
-                C2D_DrawTextBuf(infoBuf, 24, 90, 0, 0.7f, 0.7f, "A: Backup config to config_backup.txt", C2D_Color32(200,200,200,255));
-                C2D_DrawTextBuf(infoBuf, 24, 110, 0, 0.7f, 0.7f, "L: Quick save to config (writes now)", C2D_Color32(200,200,200,255));
-                break;
-            }
-            default: break;
-        }
+    aptUnhook(&aptCookie);
+    input_stop(&input);
+    config_writer_flush(&configWriter);
+    sensors_stop_worker();
+    sd_index_stop(&sdIndex);
+    sd_index_free(&sdIndex);
+    if(batteryHistory.dirty) battery_history_save(&batteryHistory, BATTERY_HISTORY_PATH);
+    for(int i = 0; i < UI_MAX_SLOTS; i++) text_slot_free(&textSlots[i]);
+    text_cache_free(&textCache);
+    C2D_Fini();
+    C3D_Fini();
+    gfxExit();
+    return 0;
+}
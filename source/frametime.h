@@ -0,0 +1,150 @@
+#ifndef FRAMETIME_H
+#define FRAMETIME_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "platform.h"
+
+// Frame-time instrumentation.
+// The loop stamps frame begin, CPU done, GPU done and vblank (in
+// microseconds, see platform_perf_us). Frame interval, CPU time and
+// GPU time each go into a fixed-size histogram of FT_BIN_US wide bins, so
+// memory stays constant however long the overlay runs. Percentiles are
+// read back from the bins.
+
+#define FT_BIN_US        250       // 0.25 ms resolution
+#define FT_BINS          256       // up to 64 ms, longer goes to overflow
+#define FT_VBLANK_US     16713     // 59.83 Hz LCD refresh
+
+typedef struct {
+    u32 bins[FT_BINS];
+    u32 overflow;
+    u32 count;
+    u32 max_us;
+    u64 sum_us;
+} FrameHist;
+
+typedef enum {
+    FT_BEGIN = 0,
+    FT_CPU_DONE,
+    FT_GPU_DONE,
+    FT_VBLANK,
+    FT_STAMP_COUNT
+} FrameStamp;
+
+typedef struct {
+    u64 stamp[FT_STAMP_COUNT];
+    u64 last_vblank;
+    FrameHist interval;       // vblank to vblank
+    FrameHist cpu;            // begin to CPU done
+    FrameHist gpu;            // CPU done to GPU done
+    u32 missed_vblanks;
+    float fps;                // smoothed, from recent intervals
+    u32 last_us;              // most recent interval
+} FrameTimer;
+
+static inline void frame_hist_add(FrameHist* h, u32 us) {
+    u32 bin = us / FT_BIN_US;
+    if(bin < FT_BINS) h->bins[bin]++;
+    else h->overflow++;
+    h->count++;
+    h->sum_us += us;
+    if(us > h->max_us) h->max_us = us;
+}
+
+// Upper edge of the bin holding the p-th percentile (0-100), in us.
+// Overflowed samples report max_us.
+static inline u32 frame_hist_percentile(const FrameHist* h, float p) {
+    if(h->count == 0) return 0;
+    u32 rank = (u32)((p / 100.0f) * (h->count - 1)) + 1;
+    u32 seen = 0;
+    for(u32 i = 0; i < FT_BINS; i++) {
+        seen += h->bins[i];
+        if(seen >= rank) {
+            u32 edge = (i + 1) * FT_BIN_US;
+            return edge < h->max_us ? edge : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+static inline u32 frame_hist_mean(const FrameHist* h) {
+    return h->count ? (u32)(h->sum_us / h->count) : 0;
+}
+
+static inline void frame_timer_init(FrameTimer* ft) {
+    memset(ft, 0, sizeof(*ft));
+}
+
+static inline void frame_timer_reset(FrameTimer* ft) {
+    u64 last = ft->last_vblank;
+    frame_timer_init(ft);
+    ft->last_vblank = last;
+}
+
+static inline void frame_timer_mark(FrameTimer* ft, FrameStamp s, u64 us) {
+    ft->stamp[s] = us;
+}
+
+// Close a frame at vblank. rendered is false for frames the scene skipped;
+// those only contribute to the interval histogram.
+static inline void frame_timer_end(FrameTimer* ft, u64 vblank_us, bool rendered) {
+    ft->stamp[FT_VBLANK] = vblank_us;
+    if(rendered) {
+        frame_hist_add(&ft->cpu, (u32)(ft->stamp[FT_CPU_DONE] - ft->stamp[FT_BEGIN]));
+        if(ft->stamp[FT_GPU_DONE] >= ft->stamp[FT_CPU_DONE])
+            frame_hist_add(&ft->gpu, (u32)(ft->stamp[FT_GPU_DONE] - ft->stamp[FT_CPU_DONE]));
+    }
+    if(ft->last_vblank) {
+        u32 interval = (u32)(vblank_us - ft->last_vblank);
+        frame_hist_add(&ft->interval, interval);
+        ft->last_us = interval;
+        if(interval) {
+            float inst = 1000000.0f / interval;
+            ft->fps = ft->fps ? ft->fps * 0.9f + inst * 0.1f : inst;
+        }
+        // anything past 1.5 refresh periods lost at least one vblank
+        if(interval > FT_VBLANK_US + FT_VBLANK_US / 2)
+            ft->missed_vblanks += (interval + FT_VBLANK_US / 2) / FT_VBLANK_US - 1;
+    }
+    ft->last_vblank = vblank_us;
+}
+
+static inline float frame_timer_fps(const FrameTimer* ft) {
+    return ft->fps;
+}
+
+// "p50 16.8 p95 17.0 p99 33.5 max 40.1 ms, 3 missed"
+static inline int frame_timer_format(const FrameTimer* ft, char* buf, size_t n) {
+    const FrameHist* h = &ft->interval;
+    return snprintf(buf, n, "p50 %.1f p95 %.1f p99 %.1f max %.1f ms, %lu missed",
+                    frame_hist_percentile(h, 50) / 1000.0f,
+                    frame_hist_percentile(h, 95) / 1000.0f,
+                    frame_hist_percentile(h, 99) / 1000.0f,
+                    h->max_us / 1000.0f, (unsigned long)ft->missed_vblanks);
+}
+
+static inline void frame_hist_dump(FILE* f, const char* name, const FrameHist* h) {
+    fprintf(f, "[%s] count=%lu mean_us=%lu p50_us=%lu p95_us=%lu p99_us=%lu max_us=%lu overflow=%lu\n",
+            name, (unsigned long)h->count, (unsigned long)frame_hist_mean(h),
+            (unsigned long)frame_hist_percentile(h, 50), (unsigned long)frame_hist_percentile(h, 95),
+            (unsigned long)frame_hist_percentile(h, 99), (unsigned long)h->max_us,
+            (unsigned long)h->overflow);
+    for(u32 i = 0; i < FT_BINS; i++)
+        if(h->bins[i]) fprintf(f, "%lu %lu\n", (unsigned long)(i * FT_BIN_US), (unsigned long)h->bins[i]);
+}
+
+// Write all three histograms as text. Returns false if the file can't be opened.
+static inline bool frame_timer_dump(const FrameTimer* ft, const char* path) {
+    FILE* f = fopen(path, "w");
+    if(!f) return false;
+    fprintf(f, "missed_vblanks=%lu\n", (unsigned long)ft->missed_vblanks);
+    frame_hist_dump(f, "interval", &ft->interval);
+    frame_hist_dump(f, "cpu", &ft->cpu);
+    frame_hist_dump(f, "gpu", &ft->gpu);
+    fclose(f);
+    return true;
+}
+
+#endif
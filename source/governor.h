@@ -0,0 +1,185 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "platform.h"
+#include "config_store.h"
+
+// Adaptive battery-saver governor.
+// Tracks battery history, estimates the discharge rate and picks a tier
+// (normal / saver / critical). Each tier sets screen brightness, the
+// overlay refresh period and the battery polling period. Tier changes use
+// hysteresis on both the battery level and the predicted runtime, plus a
+// minimum dwell time, so the governor does not flap around a threshold.
+// Everything is configured through config.json (gov_* keys) and the logic
+// only depends on (time, percent) samples, so host/governor_sim can replay
+// recorded discharge curves through it.
+
+typedef enum {
+    GOV_NORMAL = 0,
+    GOV_SAVER,
+    GOV_CRITICAL,
+    GOV_TIER_COUNT
+} GovTier;
+
+typedef struct {
+    int brightness;           // percent, both screens
+    int refresh_ms;           // overlay readout refresh period
+    int poll_ms;              // battery sensor period
+} GovTierSettings;
+
+typedef struct {
+    bool enabled;
+    int target_min;           // runtime we want to reach from now
+    int saver_pct;            // battery level that forces saver
+    int critical_pct;         // battery level that forces critical
+    int hyst_pct;             // hysteresis, percent points / percent of target
+    int dwell_ms;             // minimum time between tier changes
+    GovTierSettings tier[GOV_TIER_COUNT];
+} GovConfig;
+
+#define GOV_HISTORY      32
+#define GOV_MIN_SPAN_MS  (5 * 60 * 1000)  // need 5 min of history for a rate
+
+typedef struct {
+    u32 time_ms;
+    u8 percent;
+} GovSample;
+
+typedef struct {
+    GovConfig cfg;
+    GovSample history[GOV_HISTORY];
+    int count;
+    int next;
+    GovTier tier;
+    GovTier floor;            // manual saver toggle forces at least this tier
+    u32 last_change_ms;
+    u32 switches;
+    float rate_pct_per_h;     // 0 when unknown
+    float runtime_min;        // predicted, < 0 when unknown
+} Governor;
+
+static inline void governor_config_defaults(GovConfig* c) {
+    c->enabled = true;
+    c->target_min = 180;
+    c->saver_pct = 30;
+    c->critical_pct = 10;
+    c->hyst_pct = 5;
+    c->dwell_ms = 60 * 1000;
+    c->tier[GOV_NORMAL]   = (GovTierSettings){ 100, 250, 2000 };
+    c->tier[GOV_SAVER]    = (GovTierSettings){  80, 500, 5000 };
+    c->tier[GOV_CRITICAL] = (GovTierSettings){  50, 1000, 10000 };
+}
+
+static inline void governor_config_load(GovConfig* c, const ConfigStore* cs) {
+    static const char* names[GOV_TIER_COUNT] = { "normal", "saver", "critical" };
+    governor_config_defaults(c);
+    c->enabled = config_store_get_bool(cs, "gov_enabled", c->enabled);
+    c->target_min = config_store_get_int(cs, "gov_target_min", c->target_min);
+    c->saver_pct = config_store_get_int(cs, "gov_saver_pct", c->saver_pct);
+    c->critical_pct = config_store_get_int(cs, "gov_critical_pct", c->critical_pct);
+    c->hyst_pct = config_store_get_int(cs, "gov_hyst_pct", c->hyst_pct);
+    c->dwell_ms = config_store_get_int(cs, "gov_dwell_ms", c->dwell_ms);
+    for(int i = 0; i < GOV_TIER_COUNT; i++) {
+        char key[CONFIG_KEY_LEN];
+        GovTierSettings* t = &c->tier[i];
+        snprintf(key, sizeof(key), "gov_%s_brightness", names[i]);
+        t->brightness = config_store_get_int(cs, key, t->brightness);
+        snprintf(key, sizeof(key), "gov_%s_refresh_ms", names[i]);
+        t->refresh_ms = config_store_get_int(cs, key, t->refresh_ms);
+        snprintf(key, sizeof(key), "gov_%s_poll_ms", names[i]);
+        t->poll_ms = config_store_get_int(cs, key, t->poll_ms);
+    }
+}
+
+static inline void governor_init(Governor* g, const GovConfig* cfg) {
+    memset(g, 0, sizeof(*g));
+    g->cfg = *cfg;
+    g->runtime_min = -1.0f;
+}
+
+static inline const char* governor_tier_name(GovTier t) {
+    static const char* names[GOV_TIER_COUNT] = { "normal", "saver", "critical" };
+    return names[t];
+}
+
+static inline const GovTierSettings* governor_settings(const Governor* g) {
+    return &g->cfg.tier[g->tier];
+}
+
+// Discharge rate from the oldest and newest sample in the window.
+static inline void governor_estimate(Governor* g) {
+    g->rate_pct_per_h = 0.0f;
+    g->runtime_min = -1.0f;
+    if(g->count < 2) return;
+    const GovSample* newest = &g->history[(g->next + GOV_HISTORY - 1) % GOV_HISTORY];
+    const GovSample* oldest = &g->history[g->count < GOV_HISTORY ? 0 : g->next];
+    u32 span = newest->time_ms - oldest->time_ms;
+    if(span < GOV_MIN_SPAN_MS || newest->percent >= oldest->percent) return;
+    g->rate_pct_per_h = (oldest->percent - newest->percent) * 3600000.0f / span;
+    g->runtime_min = newest->percent * 60.0f / g->rate_pct_per_h;
+}
+
+static inline GovTier governor_pick(const Governor* g, u8 percent) {
+    const GovConfig* c = &g->cfg;
+    bool in_critical = g->tier == GOV_CRITICAL;
+    bool in_saver = g->tier >= GOV_SAVER;
+
+    // leave a tier only once we are clearly past its entry threshold
+    int critical_at = c->critical_pct + (in_critical ? c->hyst_pct : 0);
+    if(percent <= critical_at) return GOV_CRITICAL;
+
+    int saver_at = c->saver_pct + (in_saver ? c->hyst_pct : 0);
+    if(percent <= saver_at) return GOV_SAVER;
+
+    if(g->runtime_min >= 0) {
+        float target = (float)c->target_min;
+        if(in_saver) target *= 1.0f + c->hyst_pct / 100.0f;
+        if(g->runtime_min < target) return GOV_SAVER;
+    }
+    return GOV_NORMAL;
+}
+
+// Feed one battery reading. Returns true when the tier changed.
+static inline bool governor_update(Governor* g, u32 now_ms, u8 percent) {
+    // one history entry per level change, or per minute while flat
+    const GovSample* last = g->count ? &g->history[(g->next + GOV_HISTORY - 1) % GOV_HISTORY] : NULL;
+    if(!last || last->percent != percent || now_ms - last->time_ms >= 60000) {
+        g->history[g->next] = (GovSample){ now_ms, percent };
+        g->next = (g->next + 1) % GOV_HISTORY;
+        if(g->count < GOV_HISTORY) g->count++;
+        governor_estimate(g);
+    }
+    if(!g->cfg.enabled) return false;
+
+    GovTier want = governor_pick(g, percent);
+    if(want < g->floor) want = g->floor;
+    if(want == g->tier) return false;
+    // critical is entered immediately, everything else respects the dwell time
+    bool urgent = want == GOV_CRITICAL || g->switches == 0;
+    if(!urgent && now_ms - g->last_change_ms < (u32)g->cfg.dwell_ms) return false;
+    g->tier = want;
+    g->last_change_ms = now_ms;
+    g->switches++;
+    return true;
+}
+
+// Manual battery saver: never run below the saver tier while it is on.
+// A user action, so it applies at once. Returns true when the tier changed.
+static inline bool governor_set_floor(Governor* g, u32 now_ms, bool saver) {
+    g->floor = saver ? GOV_SAVER : GOV_NORMAL;
+    GovTier want = g->floor;
+    if(g->cfg.enabled && g->count) {
+        GovTier picked = governor_pick(g, g->history[(g->next + GOV_HISTORY - 1) % GOV_HISTORY].percent);
+        if(picked > want) want = picked;
+    }
+    if(want == g->tier) return false;
+    g->tier = want;
+    g->last_change_ms = now_ms;
+    g->switches++;
+    return true;
+}
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "platform.h"
+#include "config_store.h"
+
+// Input sampling, key repeat and input latency.
+// A sampler thread reads the held keys every INPUT_SAMPLE_MS, independent of
+// the frame rate, and turns edges into timestamped events on a
+// single-producer/single-consumer queue: PRESS and RELEASE per key, plus
+// REPEAT while a key in repeat_mask stays held. The first repeat comes after
+// delay_ms; each further one comes sooner by accel_pct, down to min_ms.
+//
+// The render loop drains the queue. input_frame_end() notes whether the frame
+// drawn after consuming events was submitted, and input_vblank(), called
+// right after the loop's next vblank wait, records how long the oldest of
+// those events waited: the input-to-photon latency, up to the vblank the
+// frame is shown on.
+//
+// input_sample() is a pure function of (time, held keys), so host tools can
+// replay scripted key traces through it without the thread.
+
+#define INPUT_QUEUE_LEN   64      // power of two
+#define INPUT_SAMPLE_MS   4
+#define INPUT_KEYS        32
+
+typedef enum {
+    INPUT_PRESS = 0,
+    INPUT_REPEAT,
+    INPUT_RELEASE
+} InputEventType;
+
+typedef struct {
+    u64 time_us;              // when the sampler saw it
+    u32 key;                  // one key bit
+    u8 type;                  // InputEventType
+    u8 repeat;                // 1 for the first REPEAT, saturates at 255
+} InputEvent;
+
+typedef struct {
+    u32 repeat_mask;          // keys that repeat while held
+    u32 delay_ms;             // press to first repeat
+    u32 interval_ms;          // first repeat to second
+    u32 min_ms;               // fastest repeat
+    u32 accel_pct;            // each interval is this % of the previous one
+} InputConfig;
+
+typedef struct {
+    InputConfig cfg;
+
+    // sampler only
+    u32 held;
+    u64 next_repeat_us[INPUT_KEYS];
+    u32 interval_us[INPUT_KEYS];
+    u8 repeats[INPUT_KEYS];
+
+    // queue; head is written by the sampler, tail by the consumer
+    InputEvent queue[INPUT_QUEUE_LEN];
+    u32 head;
+    u32 tail;
+    u32 dropped;              // queue was full; atomic
+
+    // consumer only
+    u64 pending_us;           // oldest event not yet drawn, 0 if none
+    u64 submitted_us;         // oldest event of a frame waiting for its vblank
+    u32 latency_last_us;
+    u32 latency_max_us;
+    u64 latency_total_us;
+    u32 latency_count;
+
+    PlatformThread sampler;
+    bool running;             // sampler active; atomic
+} Input;
+
+static inline void input_config_defaults(InputConfig* c, u32 repeat_mask) {
+    c->repeat_mask = repeat_mask;
+    c->delay_ms = 400;
+    c->interval_ms = 150;
+    c->min_ms = 40;
+    c->accel_pct = 85;
+}
+
+static inline void input_config_load(InputConfig* c, const ConfigStore* cs) {
+    c->delay_ms = config_store_get_int(cs, "input_repeat_delay_ms", c->delay_ms);
+    c->interval_ms = config_store_get_int(cs, "input_repeat_ms", c->interval_ms);
+    c->min_ms = config_store_get_int(cs, "input_repeat_min_ms", c->min_ms);
+    c->accel_pct = config_store_get_int(cs, "input_repeat_accel_pct", c->accel_pct);
+    if(c->min_ms < INPUT_SAMPLE_MS) c->min_ms = INPUT_SAMPLE_MS;
+    if(c->interval_ms < c->min_ms) c->interval_ms = c->min_ms;
+    if(c->accel_pct > 100) c->accel_pct = 100;
+}
+
+static inline void input_init(Input* in, const InputConfig* cfg) {
+    memset(in, 0, sizeof(*in));
+    in->cfg = *cfg;
+}
+
+static inline void input_push(Input* in, u64 now_us, u32 key, InputEventType type, u8 repeat) {
+    u32 head = in->head;
+    if(head - __atomic_load_n(&in->tail, __ATOMIC_ACQUIRE) >= INPUT_QUEUE_LEN) {
+        __atomic_add_fetch(&in->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    InputEvent* e = &in->queue[head & (INPUT_QUEUE_LEN - 1)];
+    e->time_us = now_us;
+    e->key = key;
+    e->type = (u8)type;
+    e->repeat = repeat;
+    __atomic_store_n(&in->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Feed one sample of the held keys.
+static inline void input_sample(Input* in, u64 now_us, u32 held) {
+    u32 pressed = held & ~in->held;
+    u32 released = in->held & ~held;
+    in->held = held;
+    for(int k = 0; k < INPUT_KEYS; k++) {
+        u32 bit = 1u << k;
+        if(released & bit) input_push(in, now_us, bit, INPUT_RELEASE, 0);
+        if(pressed & bit) {
+            input_push(in, now_us, bit, INPUT_PRESS, 0);
+            in->next_repeat_us[k] = now_us + in->cfg.delay_ms * 1000ULL;
+            in->interval_us[k] = in->cfg.interval_ms * 1000;
+            in->repeats[k] = 0;
+        } else if((held & bit & in->cfg.repeat_mask) && now_us >= in->next_repeat_us[k]) {
+            if(in->repeats[k] < 255) in->repeats[k]++;
+            input_push(in, now_us, bit, INPUT_REPEAT, in->repeats[k]);
+            // a late sample does not cause a burst of catch-up repeats
+            in->next_repeat_us[k] = now_us + in->interval_us[k];
+            u32 next = (u32)((u64)in->interval_us[k] * in->cfg.accel_pct / 100);
+            in->interval_us[k] = next > in->cfg.min_ms * 1000 ? next : in->cfg.min_ms * 1000;
+        }
+    }
+}
+
+// Next queued event; false when the queue is empty.
+static inline bool input_next(Input* in, InputEvent* e) {
+    u32 tail = in->tail;
+    if(tail == __atomic_load_n(&in->head, __ATOMIC_ACQUIRE)) return false;
+    *e = in->queue[tail & (INPUT_QUEUE_LEN - 1)];
+    __atomic_store_n(&in->tail, tail + 1, __ATOMIC_RELEASE);
+    if(e->type != INPUT_RELEASE && !in->pending_us) in->pending_us = e->time_us;
+    return true;
+}
+
+// Drain the queue into one mask of pressed and repeated keys, for loops
+// that only look at "keys down this frame".
+static inline u32 input_keys_down(Input* in) {
+    u32 down = 0;
+    InputEvent e;
+    while(input_next(in, &e))
+        if(e.type != INPUT_RELEASE) down |= e.key;
+    return down;
+}
+
+// Call after every frame. A drawn frame will show the consumed events at
+// the next vblank; a skipped one means they changed nothing visible, so
+// they are not counted.
+static inline void input_frame_end(Input* in, bool rendered) {
+    if(!in->pending_us) return;
+    if(rendered && !in->submitted_us) in->submitted_us = in->pending_us;
+    in->pending_us = 0;
+}
+
+// Call right after every vblank wait: the frame submitted before it is on
+// screen now.
+static inline void input_vblank(Input* in, u64 now_us) {
+    if(!in->submitted_us) return;
+    u32 lat = (u32)(now_us - in->submitted_us);
+    in->latency_last_us = lat;
+    if(lat > in->latency_max_us) in->latency_max_us = lat;
+    in->latency_total_us += lat;
+    in->latency_count++;
+    in->submitted_us = 0;
+}
+
+// "input 21.4 ms avg, 38.0 max"
+static inline int input_format_latency(const Input* in, char* buf, size_t n) {
+    if(!in->latency_count) return snprintf(buf, n, "input -");
+    return snprintf(buf, n, "input %.1f ms avg, %.1f max",
+                    in->latency_total_us / 1000.0 / in->latency_count, in->latency_max_us / 1000.0);
+}
+
+static void input_sampler(void* arg) {
+    Input* in = (Input*)arg;
+    while(__atomic_load_n(&in->running, __ATOMIC_ACQUIRE)) {
+        input_sample(in, platform_perf_us(), platform_keys_held());
+        platform_sleep_ms(INPUT_SAMPLE_MS);
+    }
+}
+
+// From here on the sampler is the only caller of platform_keys_held(). It
+// runs above the render loop, which would otherwise delay every sample
+// behind a whole frame; each wakeup is a few microseconds.
+static inline bool input_start(Input* in) {
+    __atomic_store_n(&in->running, true, __ATOMIC_RELEASE);
+    if(!platform_thread_start_high(&in->sampler, input_sampler, in)) {
+        __atomic_store_n(&in->running, false, __ATOMIC_RELEASE);
+        return false;
+    }
+    return true;
+}
+
+static inline void input_stop(Input* in) {
+    if(!in->running) return;
+    __atomic_store_n(&in->running, false, __ATOMIC_RELEASE);
+    platform_thread_join(&in->sampler);
+}
+
+#endif
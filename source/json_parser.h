@@ -2,8 +2,10 @@
 #define JSON_PARSER_H
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <errno.h>
 
 // Very tiny key=value parser for config files
 static inline bool read_bool_config(const char* path, const char* key, bool default_val) {
@@ -15,7 +17,7 @@ static inline bool read_bool_config(const char* path, const char* key, bool defa
         if(sscanf(line, "%63[^=]=%63s", k, v) == 2) {
             if(strcmp(k, key)==0) {
                 fclose(f);
-                return (strcmp(v,"1")==0);
+                return (strcmp(v,"1")==0 || strcmp(v,"true")==0);
             }
         }
     }
@@ -23,11 +25,279 @@ static inline bool read_bool_config(const char* path, const char* key, bool defa
     return default_val;
 }
 
-static inline void write_bool_config(const char* path, const char* key, bool val) {
-    FILE *f = fopen(path, "w");
-    if(!f) return;
-    fprintf(f,"%s=%d\n", key, val ? 1 : 0);
-    fclose(f);
+// Streaming JSON tokenizer.
+// Pulls one token at a time out of a caller-owned buffer in a single pass
+// and never allocates: strings are unescaped in place and NUL-terminated,
+// so JSON_KEY / JSON_STRING tokens point straight into the buffer. Numbers
+// point at their text (not terminated; use json_token_int). Nesting is
+// tracked in a bit stack, JSON_MAX_DEPTH levels deep. Any syntax error
+// yields JSON_ERROR with pos set; the lexer stays in that state.
+
+#define JSON_MAX_DEPTH 32
+
+typedef enum {
+    JSON_ERROR = 0,
+    JSON_OBJECT_BEGIN,
+    JSON_OBJECT_END,
+    JSON_ARRAY_BEGIN,
+    JSON_ARRAY_END,
+    JSON_KEY,
+    JSON_STRING,
+    JSON_NUMBER,
+    JSON_TRUE,
+    JSON_FALSE,
+    JSON_NULL,
+    JSON_DONE
+} JsonToken;
+
+typedef enum {
+    JSON_WANT_VALUE = 0,      // document start, after ':' / ',' in an array
+    JSON_WANT_ELEMENT,        // after '[': a value or ']'
+    JSON_WANT_MEMBER,         // after '{': a key or '}'
+    JSON_WANT_KEY,            // after ',' in an object
+    JSON_WANT_SEP,            // after a value: ',' or a closer
+    JSON_FINISHED,
+    JSON_FAILED
+} JsonState;
+
+typedef struct {
+    char* p;
+    char* end;
+    char* start;
+    unsigned int stack;       // bit d set: level d is an object
+    int depth;
+    JsonState state;
+    // current token
+    char* str;
+    size_t len;
+    size_t pos;               // error offset
+} JsonLexer;
+
+static inline void json_lexer_init(JsonLexer* lx, char* buf, size_t len) {
+    memset(lx, 0, sizeof(*lx));
+    lx->p = lx->start = buf;
+    lx->end = buf + len;
+}
+
+static inline JsonToken json_fail(JsonLexer* lx) {
+    lx->state = JSON_FAILED;
+    lx->pos = lx->p - lx->start;
+    return JSON_ERROR;
+}
+
+static inline void json_skip_ws(JsonLexer* lx) {
+    while(lx->p < lx->end && (*lx->p == ' ' || *lx->p == '\t' || *lx->p == '\n' || *lx->p == '\r')) lx->p++;
+}
+
+static inline int json_hex(char c) {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// p is just past the opening quote. Unescapes in place.
+static inline bool json_scan_string(JsonLexer* lx) {
+    char* dst = lx->p;
+    lx->str = dst;
+    while(lx->p < lx->end) {
+        char c = *lx->p++;
+        if(c == '"') {
+            *dst = '\0';
+            lx->len = dst - lx->str;
+            return true;
+        }
+        if((unsigned char)c < 0x20) return false;
+        if(c != '\\') { *dst++ = c; continue; }
+        if(lx->p >= lx->end) return false;
+        c = *lx->p++;
+        switch(c) {
+            case '"': case '\\': case '/': *dst++ = c; break;
+            case 'b': *dst++ = '\b'; break;
+            case 'f': *dst++ = '\f'; break;
+            case 'n': *dst++ = '\n'; break;
+            case 'r': *dst++ = '\r'; break;
+            case 't': *dst++ = '\t'; break;
+            case 'u': {
+                if(lx->end - lx->p < 4) return false;
+                unsigned cp = 0;
+                for(int i = 0; i < 4; i++) {
+                    int h = json_hex(lx->p[i]);
+                    if(h < 0) return false;
+                    cp = cp << 4 | h;
+                }
+                lx->p += 4;
+                // six input bytes always cover the UTF-8 output; surrogates
+                // are not paired up, they come out as '?'
+                if(cp < 0x80) *dst++ = (char)cp;
+                else if(cp < 0x800) { *dst++ = (char)(0xC0 | cp >> 6); *dst++ = (char)(0x80 | (cp & 0x3F)); }
+                else if(cp >= 0xD800 && cp < 0xE000) *dst++ = '?';
+                else { *dst++ = (char)(0xE0 | cp >> 12); *dst++ = (char)(0x80 | ((cp >> 6) & 0x3F)); *dst++ = (char)(0x80 | (cp & 0x3F)); }
+                break;
+            }
+            default: return false;
+        }
+    }
+    return false;
+}
+
+static inline bool json_is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+static inline bool json_scan_number(JsonLexer* lx) {
+    char* p = lx->p;
+    char* end = lx->end;
+    lx->str = p;
+    if(p < end && *p == '-') p++;
+    if(p >= end || !json_is_digit(*p)) return false;
+    if(*p == '0') p++;
+    else while(p < end && json_is_digit(*p)) p++;
+    if(p < end && *p == '.') {
+        if(++p >= end || !json_is_digit(*p)) return false;
+        while(p < end && json_is_digit(*p)) p++;
+    }
+    if(p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        if(p < end && (*p == '+' || *p == '-')) p++;
+        if(p >= end || !json_is_digit(*p)) return false;
+        while(p < end && json_is_digit(*p)) p++;
+    }
+    lx->len = p - lx->str;
+    lx->p = p;
+    return true;
+}
+
+static inline bool json_in_object(const JsonLexer* lx) {
+    return lx->depth > 0 && (lx->stack >> (lx->depth - 1) & 1);
+}
+
+static inline JsonToken json_after_value(JsonLexer* lx, JsonToken t) {
+    lx->state = lx->depth == 0 ? JSON_FINISHED : JSON_WANT_SEP;
+    return t;
+}
+
+static inline bool json_match(JsonLexer* lx, const char* word, size_t n) {
+    if((size_t)(lx->end - lx->p) < n || memcmp(lx->p, word, n) != 0) return false;
+    lx->str = lx->p;
+    lx->len = n;
+    lx->p += n;
+    return true;
+}
+
+static inline JsonToken json_next(JsonLexer* lx) {
+    if(lx->state == JSON_FAILED) return JSON_ERROR;
+    json_skip_ws(lx);
+    if(lx->state == JSON_FINISHED) return lx->p == lx->end ? JSON_DONE : json_fail(lx);
+    if(lx->p >= lx->end) return json_fail(lx);
+
+    char c = *lx->p;
+    if(lx->state == JSON_WANT_SEP) {
+        bool obj = json_in_object(lx);
+        if(c == ',') {
+            lx->p++;
+            lx->state = obj ? JSON_WANT_KEY : JSON_WANT_VALUE;
+            return json_next(lx);
+        }
+        if(c != (obj ? '}' : ']')) return json_fail(lx);
+        lx->p++;
+        lx->depth--;
+        return json_after_value(lx, obj ? JSON_OBJECT_END : JSON_ARRAY_END);
+    }
+
+    if(lx->state == JSON_WANT_MEMBER || lx->state == JSON_WANT_KEY) {
+        if(c == '}' && lx->state == JSON_WANT_MEMBER) {     // empty object
+            lx->p++;
+            lx->depth--;
+            return json_after_value(lx, JSON_OBJECT_END);
+        }
+        if(c != '"') return json_fail(lx);
+        lx->p++;
+        if(!json_scan_string(lx)) return json_fail(lx);
+        json_skip_ws(lx);
+        if(lx->p >= lx->end || *lx->p != ':') return json_fail(lx);
+        lx->p++;
+        lx->state = JSON_WANT_VALUE;
+        return JSON_KEY;
+    }
+
+    if(lx->state == JSON_WANT_ELEMENT) {
+        if(c == ']') {
+            lx->p++;
+            lx->depth--;
+            return json_after_value(lx, JSON_ARRAY_END);
+        }
+        lx->state = JSON_WANT_VALUE;
+    }
+
+    // JSON_WANT_VALUE
+    switch(c) {
+        case '{':
+        case '[':
+            if(lx->depth == JSON_MAX_DEPTH) return json_fail(lx);
+            lx->p++;
+            if(c == '{') lx->stack |= 1u << lx->depth;
+            else lx->stack &= ~(1u << lx->depth);
+            lx->depth++;
+            if(c == '{') {
+                lx->state = JSON_WANT_MEMBER;
+                return JSON_OBJECT_BEGIN;
+            }
+            lx->state = JSON_WANT_ELEMENT;
+            return JSON_ARRAY_BEGIN;
+        case '"':
+            lx->p++;
+            if(!json_scan_string(lx)) return json_fail(lx);
+            return json_after_value(lx, JSON_STRING);
+        case 't': if(!json_match(lx, "true", 4)) return json_fail(lx); return json_after_value(lx, JSON_TRUE);
+        case 'f': if(!json_match(lx, "false", 5)) return json_fail(lx); return json_after_value(lx, JSON_FALSE);
+        case 'n': if(!json_match(lx, "null", 4)) return json_fail(lx); return json_after_value(lx, JSON_NULL);
+        default:
+            if(!json_scan_number(lx)) return json_fail(lx);
+            return json_after_value(lx, JSON_NUMBER);
+    }
+}
+
+// Integer value of a JSON_NUMBER token; false if it is not a plain integer
+// or does not fit a long.
+static inline bool json_token_int(const JsonLexer* lx, long* out) {
+    char tmp[24];
+    if(lx->len == 0 || lx->len >= sizeof(tmp)) return false;
+    memcpy(tmp, lx->str, lx->len);
+    tmp[lx->len] = '\0';
+    char* end;
+    errno = 0;
+    *out = strtol(tmp, &end, 10);
+    return *end == '\0' && errno != ERANGE;
+}
+
+// Buffer size that holds any string of len bytes quoted: every byte may
+// become \u00XX, plus the quotes and the NUL.
+#define JSON_QUOTE_LEN(len) (6 * (len) + 3)
+
+// Append s to buf as a JSON string literal. Returns the length it needed;
+// a result >= cap means it was cut off.
+static inline size_t json_quote(char* buf, size_t cap, const char* s) {
+    size_t n = 0;
+#define JSON_PUT(ch) do { if(n + 1 < cap) buf[n] = (ch); n++; } while(0)
+    JSON_PUT('"');
+    for(; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if(c == '"' || c == '\\') { JSON_PUT('\\'); JSON_PUT(c); }
+        else if(c == '\n') { JSON_PUT('\\'); JSON_PUT('n'); }
+        else if(c == '\t') { JSON_PUT('\\'); JSON_PUT('t'); }
+        else if(c < 0x20) {
+            static const char hex[] = "0123456789abcdef";
+            JSON_PUT('\\'); JSON_PUT('u'); JSON_PUT('0'); JSON_PUT('0');
+            JSON_PUT(hex[c >> 4]); JSON_PUT(hex[c & 15]);
+        }
+        else JSON_PUT(c);
+    }
+    JSON_PUT('"');
+#undef JSON_PUT
+    if(cap) buf[n < cap ? n : cap - 1] = '\0';
+    return n;
 }
 
 #endif
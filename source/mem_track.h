@@ -0,0 +1,249 @@
+#ifndef MEM_TRACK_H
+#define MEM_TRACK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include "platform.h"
+
+// Memory accounting.
+// Long-lived memory is charged to a subsystem: heap blocks from mem_alloc(),
+// buffers other libraries allocate for us (mem_track_add(), e.g. citro2d
+// text buffers) and the big static tables (mem_track_static()). Each
+// subsystem keeps its live bytes, block count and high-water mark.
+// mem_track_mark() records the totals once startup is done, so the UI can
+// show how far a long session drifted from them; a flat footprint reads
+// "+0" for hours.
+//
+// Transient data of a frame goes to a MemArena instead: a bump allocator
+// that is reset once per frame and never frees anything on its own.
+//
+// The counters are not atomic; allocate from the main thread only.
+
+typedef enum {
+    MEM_TEXT = 0,
+    MEM_CONFIG,
+    MEM_SD_INDEX,
+    MEM_THEME,
+    MEM_UI,
+    MEM_FRAME,
+    MEM_OTHER,
+    MEM_SUB_COUNT
+} MemSubsystem;
+
+typedef struct {
+    const char* name;
+    u32 static_bytes;         // fixed tables, registered once
+    u32 live_bytes;           // heap and foreign buffers held now
+    u32 live_blocks;
+    u32 peak_bytes;           // high-water mark of live_bytes
+    u32 allocs;
+    u32 frees;
+    u32 failures;
+} MemSubStats;
+
+typedef struct {
+    MemSubStats sub[MEM_SUB_COUNT];
+    u32 live_bytes;           // all subsystems
+    u32 peak_bytes;
+    bool marked;
+    u32 mark_live;            // totals at mem_track_mark()
+    u32 mark_heap;
+} MemTracker;
+
+static MemTracker mem_tracker = {
+    .sub = {
+        [MEM_TEXT]     = { "text" },
+        [MEM_CONFIG]   = { "config" },
+        [MEM_SD_INDEX] = { "sd index" },
+        [MEM_THEME]    = { "themes" },
+        [MEM_UI]       = { "ui" },
+        [MEM_FRAME]    = { "frame arena" },
+        [MEM_OTHER]    = { "other" },
+    },
+};
+
+// Heap blocks carry their size and owner in front of the payload.
+typedef struct {
+    u32 size;
+    u32 sub;
+    u64 pad;                  // keeps the payload 16-byte aligned
+} MemBlockHeader;
+
+static inline void mem_track_add(MemSubsystem sub, u32 bytes) {
+    MemSubStats* s = &mem_tracker.sub[sub];
+    s->live_bytes += bytes;
+    s->live_blocks++;
+    s->allocs++;
+    if(s->live_bytes > s->peak_bytes) s->peak_bytes = s->live_bytes;
+    mem_tracker.live_bytes += bytes;
+    if(mem_tracker.live_bytes > mem_tracker.peak_bytes) mem_tracker.peak_bytes = mem_tracker.live_bytes;
+}
+
+static inline void mem_track_remove(MemSubsystem sub, u32 bytes) {
+    MemSubStats* s = &mem_tracker.sub[sub];
+    s->live_bytes -= bytes;
+    s->live_blocks--;
+    s->frees++;
+    mem_tracker.live_bytes -= bytes;
+}
+
+static inline void mem_track_static(MemSubsystem sub, u32 bytes) {
+    mem_tracker.sub[sub].static_bytes += bytes;
+}
+
+static inline void* mem_alloc(MemSubsystem sub, u32 size) {
+    MemBlockHeader* h = (MemBlockHeader*)malloc(sizeof(MemBlockHeader) + size);
+    if(!h) {
+        mem_tracker.sub[sub].failures++;
+        return NULL;
+    }
+    h->size = size;
+    h->sub = sub;
+    mem_track_add(sub, size);
+    return h + 1;
+}
+
+static inline void* mem_calloc(MemSubsystem sub, u32 size) {
+    void* p = mem_alloc(sub, size);
+    if(p) memset(p, 0, size);
+    return p;
+}
+
+static inline void mem_free(void* p) {
+    if(!p) return;
+    MemBlockHeader* h = (MemBlockHeader*)p - 1;
+    mem_track_remove((MemSubsystem)h->sub, h->size);
+    free(h);
+}
+
+// Call when startup allocations are done; drift is measured from here.
+static inline void mem_track_mark(void) {
+    PlatformMemInfo m;
+    platform_mem_info(&m);
+    mem_tracker.marked = true;
+    mem_tracker.mark_live = mem_tracker.live_bytes;
+    mem_tracker.mark_heap = m.heap_used;
+}
+
+// "12.3K", "1.5M"
+static inline int mem_format_bytes(char* buf, size_t n, u32 bytes) {
+    if(bytes >= (1u << 20)) return snprintf(buf, n, "%.1fM", bytes / (double)(1u << 20));
+    if(bytes >= 1024) return snprintf(buf, n, "%.1fK", bytes / 1024.0);
+    return snprintf(buf, n, "%luB", (unsigned long)bytes);
+}
+
+static inline int mem_format_drift(char* buf, size_t n, u32 now, u32 then) {
+    char size[16];
+    mem_format_bytes(size, sizeof(size), now >= then ? now - then : then - now);
+    return snprintf(buf, n, "%s%s", now >= then ? "+" : "-", size);
+}
+
+// "text: 4.0K in 4 (peak 4.0K) + 20.1K static"
+static inline int mem_track_format(MemSubsystem sub, char* buf, size_t n) {
+    const MemSubStats* s = &mem_tracker.sub[sub];
+    char live[16], peak[16], fixed[16];
+    mem_format_bytes(live, sizeof(live), s->live_bytes);
+    mem_format_bytes(peak, sizeof(peak), s->peak_bytes);
+    mem_format_bytes(fixed, sizeof(fixed), s->static_bytes);
+    return snprintf(buf, n, "%s: %s in %lu (peak %s) + %s static%s", s->name, live,
+                    (unsigned long)s->live_blocks, peak, fixed, s->failures ? ", FAILED" : "");
+}
+
+// "Tracked 24.1K (peak 24.1K), +0B since start; heap +0B"
+static inline int mem_track_format_total(char* buf, size_t n) {
+    PlatformMemInfo m;
+    platform_mem_info(&m);
+    char live[16], peak[16], drift[24], heap[24];
+    mem_format_bytes(live, sizeof(live), mem_tracker.live_bytes);
+    mem_format_bytes(peak, sizeof(peak), mem_tracker.peak_bytes);
+    if(!mem_tracker.marked)
+        return snprintf(buf, n, "Tracked %s (peak %s)", live, peak);
+    mem_format_drift(drift, sizeof(drift), mem_tracker.live_bytes, mem_tracker.mark_live);
+    mem_format_drift(heap, sizeof(heap), m.heap_used, mem_tracker.mark_heap);
+    return snprintf(buf, n, "Tracked %s (peak %s), %s since start; heap %s", live, peak, drift, heap);
+}
+
+// "App memory 12.1M / 64.0M, heap 310.2K, linear free 20.0M"
+static inline int mem_format_process(char* buf, size_t n) {
+    PlatformMemInfo m;
+    platform_mem_info(&m);
+    char used[16], total[16], heap[16], linear[16];
+    mem_format_bytes(used, sizeof(used), m.app_used);
+    mem_format_bytes(total, sizeof(total), m.app_total);
+    mem_format_bytes(heap, sizeof(heap), m.heap_used);
+    mem_format_bytes(linear, sizeof(linear), m.linear_free);
+    return snprintf(buf, n, "App memory %s / %s, heap %s, linear free %s", used, total, heap, linear);
+}
+
+// Per-frame bump allocator. Everything handed out is valid until the next
+// mem_arena_reset(); a request that does not fit returns NULL and counts
+// as an overflow instead of falling back to the heap.
+
+#define MEM_ARENA_ALIGN 8
+
+typedef struct {
+    u8* base;
+    u32 size;
+    u32 used;
+    u32 peak;                 // most used in one frame
+    u32 overflows;
+    u32 frames;
+} MemArena;
+
+static inline bool mem_arena_init(MemArena* a, u32 size) {
+    memset(a, 0, sizeof(*a));
+    a->base = (u8*)mem_alloc(MEM_FRAME, size);
+    if(a->base) a->size = size;
+    return a->base != NULL;
+}
+
+static inline void mem_arena_free(MemArena* a) {
+    mem_free(a->base);
+    a->base = NULL;
+    a->size = a->used = 0;
+}
+
+static inline void mem_arena_reset(MemArena* a) {
+    if(a->used > a->peak) a->peak = a->used;
+    a->used = 0;
+    a->frames++;
+}
+
+static inline void* mem_arena_alloc(MemArena* a, u32 size) {
+    u32 at = (a->used + MEM_ARENA_ALIGN - 1) & ~(u32)(MEM_ARENA_ALIGN - 1);
+    if(at > a->size || size > a->size - at) {
+        a->overflows++;
+        return NULL;
+    }
+    a->used = at + size;
+    return a->base + at;
+}
+
+// Format into the arena. Never NULL: an overflow yields "".
+static inline const char* mem_arena_printf(MemArena* a, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    char* s = len >= 0 ? (char*)mem_arena_alloc(a, (u32)len + 1) : NULL;
+    if(!s) return "";
+    va_start(ap, fmt);
+    vsnprintf(s, (size_t)len + 1, fmt, ap);
+    va_end(ap);
+    return s;
+}
+
+// "Frame arena: 212B of 4.0K (peak 380B), 0 overflows"
+static inline int mem_arena_format(const MemArena* a, char* buf, size_t n) {
+    char used[16], size[16], peak[16];
+    mem_format_bytes(used, sizeof(used), a->used);
+    mem_format_bytes(size, sizeof(size), a->size);
+    mem_format_bytes(peak, sizeof(peak), a->used > a->peak ? a->used : a->peak);
+    return snprintf(buf, n, "Frame arena: %s of %s (peak %s), %lu overflows",
+                    used, size, peak, (unsigned long)a->overflows);
+}
+
+#endif
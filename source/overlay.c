@@ -2,21 +2,37 @@
 #include <stdio.h>
 #include <string.h>
 #include "system_utils.h"
-#include "json_parser.h"
+#include "config_store.h"
+#include "sensors.h"
+#include "console_diff.h"
+#include "config_watch.h"
+#include "config_writer.h"
 
 #define CONFIG_PATH "/3ds/system_enhancer/config.json"
 
 int main() {
     gfxInitDefault();
-    consoleInit(GFX_TOP, NULL);
-    consoleInit(GFX_BOTTOM, NULL);
+    PrintConsole* topConsole = consoleInit(GFX_TOP, NULL);
+    PrintConsole* bottomConsole = consoleInit(GFX_BOTTOM, NULL);
 
-    printf("3DS System Enhancer Overlay\n");
-    printf("Press START to exit overlay\n");
+    // only changed cells reach the consoles
+    static ConsoleGrid topGrid, bottomGrid;
+    console_grid_init(&topGrid, 50, 30, NULL, NULL);
+    console_grid_init(&bottomGrid, 40, 30, NULL, NULL);
 
     // read battery saver from config
-    bool battery_saver = read_bool_config(CONFIG_PATH, "battery_saver", false);
+    static ConfigStore config;
+    config_store_load(&config, CONFIG_PATH);
+    bool battery_saver = config_store_get_bool(&config, "battery_saver", false);
+    static ConfigWatch configWatch;
+    config_watch_start(&configWatch, CONFIG_PATH);
+    static ConfigWriter configWriter;
+    config_writer_init(&configWriter, &config, &configWatch);
+    static ConfigSnapshots configSnapshots;
+    config_snapshot_init(&configSnapshots, CONFIG_PATH);
+    configWriter.snapshots = &configSnapshots;
     set_battery_saver(battery_saver);
+    sensors_init();
 
     while(aptMainLoop()) {
         hidScanInput();
@@ -25,24 +41,33 @@ int main() {
         if(kDown & KEY_SELECT) { // toggle battery saver
             battery_saver = !battery_saver;
             set_battery_saver(battery_saver);
-            write_bool_config(CONFIG_PATH, "battery_saver", battery_saver);
+            config_writer_set_bool(&configWriter, "battery_saver", battery_saver, platform_ms());
         }
 
+        sensors_poll();
+        config_writer_poll(&configWriter, platform_ms());
+        if(config_watch_poll(&configWatch, &config, platform_ms(), NULL, NULL))
+            battery_saver = config_store_get_bool(&config, "battery_saver", battery_saver);
+
         // draw overlay info
-        consoleSelect(GFX_TOP);
-        printf("\x1b[2J"); // clear
-        printf("Battery: %d%%\n", get_battery_percent());
-        printf("Battery Saver: %s (press SELECT to toggle)\n", battery_saver?"ON":"OFF");
+        console_grid_begin(&topGrid);
+        console_grid_printf(&topGrid, "3DS System Enhancer Overlay\n");
+        console_grid_printf(&topGrid, "Battery: %d%%\n", (u8)sensors_get(SENSOR_BATTERY));
+        console_grid_printf(&topGrid, "Battery Saver: %s (press SELECT to toggle)\n", battery_saver?"ON":"OFF");
+        consoleSelect(topConsole);
+        console_grid_flush(&topGrid);
 
-        consoleSelect(GFX_BOTTOM);
-        printf("\x1b[2J");
-        printf("Press START to exit overlay\n");
+        console_grid_begin(&bottomGrid);
+        console_grid_printf(&bottomGrid, "Press START to exit overlay\n");
+        consoleSelect(bottomConsole);
+        console_grid_flush(&bottomGrid);
 
         gfxFlushBuffers();
         gfxSwapBuffers();
         gspWaitForVBlank();
     }
 
+    config_writer_flush(&configWriter);
     gfxExit();
     return 0;
 }
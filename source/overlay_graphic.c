@@ -4,153 +4,484 @@
 #include <stdbool.h>
 #include <string.h>
 #include "system_utils.h"
-#include "json_parser.h"
+#include "config_store.h"
+#include "sensors.h"
+#include "text_cache.h"
+#include "scene.h"
+#include "cpu_load.h"
+#include "frametime.h"
+#include "telemetry.h"
+#include "console_diff.h"
+#include "governor.h"
+#include "battery_history.h"
+#include "config_watch.h"
+#include "config_writer.h"
+#include "theme.h"
+#include "mem_track.h"
+#include "input.h"
+#include "startup.h"
 
 #define CONFIG_PATH "/3ds/system_enhancer/config.json"
+#define FRAMETIME_PATH "/3ds/system_enhancer/frametime.txt"
+#define PERF_LOG_FLAG "/3ds/system_enhancer/perf_log.flag"
+#define PERF_LOG_PATH "/3ds/system_enhancer/perf_log.bin"
+#define PERF_LOG_PERIOD_MS 1000
+#define BATTERY_HISTORY_PATH "/3ds/system_enhancer/battery_history.bin"
+#define STARTUP_LOG_PATH "/3ds/system_enhancer/startup_log.txt"
+#define INTRO_STEP 0.02f // per frame: 50 frames
 #define SCREEN_WIDTH 400
 #define SCREEN_HEIGHT 240
+#define FRAME_ARENA_BYTES 1024
+#define MEM_LINE_LEN 96
 
+// Formatted pieces of the bottom screen; they only live until the grid has
+// copied them, so they come from the frame arena
+typedef struct {
+    char frame[64];
+    char tte[16];
+    char latency[40];
+    char startup[64];
+    char mem[MEM_LINE_LEN];
+} BottomText;
+
+static ConfigStore config;
+static ConfigWatch configWatch;
+static ConfigWriter configWriter;
+static ConfigSnapshots configSnapshots;
 static bool battery_saver = false;
-static u32 lastTick = 0;
+static Governor governor;
+static BatteryHistory batteryHistory;
+static FrameTimer frameTimer;
 static float cpu_usage = 0;
 static float fps = 0;
 static float overlayOffset = -SCREEN_WIDTH; // slide overlay
-static u32 theme_background = C2D_Color32(0,0,0,128);
+// Themes are precompiled blobs, loaded in the background; R cycles them.
+// Until they are in, the built-in theme draws the first frames.
+static ThemeSet themes;
+static Theme bootTheme;
+static const Theme* theme = &bootTheme;
+static float introProgress = 0.0f; // 1 once the intro is over or skipped
+static bool cpuSampled = false;     // first CPU average is in
+
+// Text is parsed once (constants) or on change (numbers), never per frame
+static TextCache textCache;
+static TextSlot batteryText, cpuText, fpsText;
+
+// Widgets of the retained scene; a frame is only drawn when one changes
+enum {
+    W_BATTERY = 0,
+    W_SAVER,
+    W_CPU,
+    W_FPS,
+    W_PULSE,
+    W_COUNT
+};
+static u32 statsRefreshMs = 250; // CPU/FPS readout period, set by the governor tier
+static Scene scene;
+static ConsoleGrid bottomGrid;
+// Scratch for strings that only live for one frame; reset at the top of the loop
+static MemArena frameArena;
+static Input input;   // HID sampled on its own thread, latency to the drawn frame
 
-// Battery color function
-static u32 battery_color(u8 percent) {
-    if(percent > 60) return C2D_Color32(0,255,0,255);
-    else if(percent > 30) return C2D_Color32(255,255,0,255);
-    else return C2D_Color32(255,0,0,255);
+// Startup stages, run in order on the loader thread. The main loop leaves
+// each stage's state alone until startup_take() hands it over.
+enum {
+    BOOT_CONFIG = 0,
+    BOOT_SENSORS,
+    BOOT_THEMES,
+    BOOT_HISTORY,
+    BOOT_STAGES
+};
+static Startup boot;
+
+static void on_apt_event(APT_HookType hook, void* param) {
+    (void)param;
+    if(hook == APTHOOK_ONRESTORE || hook == APTHOOK_ONWAKEUP) scene_invalidate(&scene);
+    // HOME may close us while suspended: get pending settings onto SD first
+    if((hook == APTHOOK_ONSUSPEND || hook == APTHOOK_ONSLEEP) && startup_ready(&boot, BOOT_CONFIG))
+        config_writer_flush(&configWriter);
 }
 
-// Fake CPU usage for demo
+// CPU usage of the app core, from the idle-probe rolling average
 static void update_cpu_usage() {
-    cpu_usage = (svcGetSystemTick() % 1000) / 10.0f;
+    if(cpu_load_update()) {
+        cpu_usage = cpu_load_avg(0);
+        cpuSampled = true;
+    }
 }
 
-// FPS calculation
+// FPS from the frame timer's smoothed vblank-to-vblank interval
 static void update_fps() {
-    u32 tick = svcGetSystemTick();
-    fps = 1000000.0f / (tick - lastTick + 1);
-    lastTick = tick;
+    fps = frame_timer_fps(&frameTimer);
+}
+
+// Apply the governor's current tier: brightness, readout rate, battery polling
+static void apply_governor() {
+    const GovTierSettings* t = governor_settings(&governor);
+    platform_set_brightness(t->brightness, t->brightness);
+    statsRefreshMs = t->refresh_ms;
+    sensors_set_period(SENSOR_BATTERY, t->poll_ms);
+}
+
+static void select_theme(const char* name) {
+    theme_select(&themes, name);
+    theme = theme_current(&themes);
+    scene_invalidate(&scene);
+}
+
+// Settings changed by another app (enhanced_settings) while we run
+static bool governorReconfig = false;
+static void on_config_change(const char* key, const ConfigEntry* e, void* ctx) {
+    (void)e; (void)ctx;
+    if(strcmp(key, "theme") == 0) {
+        // while the loader still fills the theme set, leave it alone; taking
+        // BOOT_THEMES selects the configured theme anyway
+        if(startup_ready(&boot, BOOT_THEMES)) select_theme(config_store_get_string(&config, key, "default"));
+    } else if(strcmp(key, "battery_saver") == 0) {
+        battery_saver = config_store_get_bool(&config, key, false);
+        governor_set_floor(&governor, platform_ms(), battery_saver);
+        governorReconfig = true;
+    } else if(strncmp(key, "gov_", 4) == 0) {
+        governorReconfig = true;
+    }
+}
+
+static void apply_config_changes() {
+    if(!governorReconfig) return;
+    governorReconfig = false;
+    governor_config_load(&governor.cfg, &config);
+    governor_set_floor(&governor, platform_ms(), battery_saver);
+    apply_governor();
+}
+
+// Queue one telemetry sample; the writer thread does the SD I/O
+static void log_telemetry(u8 battery) {
+    TelemetryRecord rec;
+    rec.time_ms = platform_ms();
+    rec.free_mem = (u32)sensors_get(SENSOR_FREE_MEM);
+    rec.frame_us = frameTimer.last_us;
+    rec.cpu_x10 = (u16)(cpu_usage * 10.0f);
+    rec.battery = battery;
+    rec.brightness = (u8)governor_settings(&governor)->brightness;
+    telemetry_log(&rec);
 }
 
 // Draw battery bar with fill animation
-static void draw_battery_bar(float x, float y, u8 percent, float fill_ratio) {
-    float bar_width = 200 * percent / 100.0f * fill_ratio;
-    C2D_DrawRectSolid(x, y, 0, bar_width, 30, battery_color(percent));
-    C2D_DrawRectOutline(x, y, 0, 200, 30, C2D_Color32(255,255,255,255), 2.0f);
+static void draw_battery_bar(float xoff, u8 percent, float fill_ratio) {
+    const ThemeRect* r = &theme->rect[THEME_R_BATTERY_BAR];
+    float bar_width = r->w * percent / 100.0f * fill_ratio;
+    C2D_DrawRectSolid(r->x + xoff, r->y, 0, bar_width, r->h, theme_battery_color(theme, percent));
+    C2D_DrawRectOutline(r->x + xoff, r->y, 0, r->w, r->h, theme_color(theme, THEME_C_BATTERY_OUTLINE), 2.0f);
 }
 
-int main() {
-    gfxInitDefault();
-    C3D_Init(C3D_DEFAULT_CMDBUF_SIZE);
-    C2D_Init();
-    C2D_Prepare();
-    C2D_Target* top = C2D_CreateScreenTarget(GFX_TOP, GFX_LEFT);
+// Horizontal bar filled to ratio (0..1) inside a theme rectangle
+static void draw_bar(ThemeRectId id, float xoff, float ratio, u32 color) {
+    const ThemeRect* r = &theme->rect[id];
+    C2D_DrawRectSolid(r->x + xoff, r->y, 0, r->w * ratio, r->h, color);
+}
 
-    consoleInit(GFX_BOTTOM, NULL);
+// Loader stages: SD reads and sensor warm-up, off the render thread
 
-    battery_saver = read_bool_config(CONFIG_PATH, "battery_saver", false);
-    set_battery_saver(battery_saver);
+static void boot_config(void) {
+    config_store_load(&config, CONFIG_PATH);
+    config_watch_start(&configWatch, CONFIG_PATH);
+    config_writer_init(&configWriter, &config, &configWatch);
+    config_snapshot_init(&configSnapshots, CONFIG_PATH);
+    configWriter.snapshots = &configSnapshots;
 
-    // --- Animated Intro ---
-    float introProgress = 0.0f;
-    const float introSpeed = 0.02f; // 2 seconds animation
+    // perf_log.flag is set from the Performance page of enhanced_settings
+    FILE* flag = fopen(PERF_LOG_FLAG, "r");
+    if(flag) {
+        fclose(flag);
+        telemetry_start(PERF_LOG_PATH);
+    }
+}
 
-    while(introProgress < 1.0f) {
-        u8 battery = get_battery_percent();
-        hidScanInput();
-        u32 kDown = hidKeysDown();
-        if(kDown & KEY_START) return 0;
+static void boot_sensors(void) {
+    sensors_init();
+    sensors_start_worker(); // SD free is sampled off the render thread
+}
 
-        C3D_FrameBegin(C3D_FRAME_SYNCDRAW);
-        C2D_TargetClear(top, theme_background);
-        C2D_SceneBegin(top);
+static void boot_themes(void) {
+    theme_set_load(&themes, THEME_DIR);
+}
 
-        // Sliding title
-        float titleX = -200 + 200 * introProgress;
-        C2D_DrawTextBuf(C2D_TextBufNew(), titleX, 20, 0, 1.5f, 1.5f, "3DS System Enhancer", C2D_Color32(255,255,255,255));
+static void boot_history(void) {
+    battery_history_load(&batteryHistory, BATTERY_HISTORY_PATH);
+}
 
-        // Animated battery fill
-        draw_battery_bar(50, 80, battery, introProgress);
+static const StartupStage bootStages[BOOT_STAGES] = {
+    [BOOT_CONFIG]  = { "config",  boot_config },
+    [BOOT_SENSORS] = { "sensors", boot_sensors },
+    [BOOT_THEMES]  = { "themes",  boot_themes },
+    [BOOT_HISTORY] = { "history", boot_history },
+};
 
-        // Fade-in CPU & FPS bars
-        float alpha = introProgress * 255;
-        C2D_DrawRectSolid(50, 130, 0, 200 * cpu_usage / 100.0f, 20, C2D_Color32(255,128,0,alpha));
-        C2D_DrawRectSolid(50, 160, 0, 200 * fps / 60.0f, 20, C2D_Color32(0,255,128,alpha));
+// Apply what the loader finished since the last frame. Stages finish in
+// order, so a stage is never taken before the ones it depends on.
+static void take_boot_stages(void) {
+    if(startup_take(&boot, BOOT_CONFIG)) {
+        battery_saver = config_store_get_bool(&config, "battery_saver", false);
+        if(!config_store_get_bool(&config, "intro", true)) introProgress = 1.0f;
+    }
+    if(startup_take(&boot, BOOT_SENSORS)) {
+        GovConfig govConfig;
+        governor_config_load(&govConfig, &config);
+        governor_init(&governor, &govConfig);
+        governor_update(&governor, platform_ms(), (u8)sensors_get(SENSOR_BATTERY));
+        governor_set_floor(&governor, platform_ms(), battery_saver);
+        apply_governor();
+    }
+    if(startup_take(&boot, BOOT_THEMES)) {
+        mem_track_static(MEM_THEME, sizeof(themes));
+        select_theme(config_store_get_string(&config, "theme", "default"));
+    }
+    if(startup_take(&boot, BOOT_HISTORY))
+        battery_history_add(&batteryHistory, platform_wall_s(), (u8)sensors_get(SENSOR_BATTERY));
+}
 
-        C3D_FrameEnd(0);
+// One intro frame: sliding title, battery filling up, bars fading in
+static void draw_intro(u8 battery) {
+    const ThemeRect* title = &theme->rect[THEME_R_TITLE];
+    float titleX = title->x - 200 + 200 * introProgress;
+    text_cache_draw(&textCache, "3DS System Enhancer", titleX, title->y, theme->scale[THEME_S_TITLE], theme_color(theme, THEME_C_TEXT));
 
-        introProgress += introSpeed;
-        gspWaitForVBlank();
+    draw_battery_bar(0, battery, introProgress);
+
+    u8 alpha = (u8)(introProgress * 255);
+    draw_bar(THEME_R_CPU_BAR, 0, cpu_usage / 100.0f, theme_color_alpha(theme, THEME_C_CPU_BAR, alpha));
+    draw_bar(THEME_R_FPS_BAR, 0, fps / 60.0f, theme_color_alpha(theme, THEME_C_FPS_BAR, alpha));
+}
+
+// The overlay itself, slid in by overlayOffset
+static void draw_overlay(u8 battery, bool haveBattery, float shownCpu, float shownFps, u8 pulse) {
+    u32 textColor = theme_color(theme, THEME_C_TEXT);
+    const ThemeRect* r;
+
+    // Battery
+    draw_battery_bar(overlayOffset, battery, 1.0f);
+
+    // Battery % text
+    r = &theme->rect[THEME_R_BATTERY_TEXT];
+    if(haveBattery) text_slot_printf(&batteryText, "%d%%", battery);
+    else text_slot_set(&batteryText, "--%");
+    text_slot_draw(&batteryText, r->x + overlayOffset, r->y, theme->scale[THEME_S_BATTERY], textColor);
+
+    // Battery saver
+    draw_bar(THEME_R_SAVER, overlayOffset, 1.0f, theme_color(theme, battery_saver ? THEME_C_SAVER_ON : THEME_C_SAVER_OFF));
+    r = &theme->rect[THEME_R_SAVER_TEXT];
+    text_cache_draw(&textCache, battery_saver ? "Saver ON" : "Saver OFF", r->x + overlayOffset, r->y, theme->scale[THEME_S_SAVER], textColor);
+
+    // CPU & FPS bars
+    draw_bar(THEME_R_CPU_BAR, overlayOffset, shownCpu / 100.0f, theme_color(theme, THEME_C_CPU_BAR));
+    r = &theme->rect[THEME_R_CPU_TEXT];
+    text_slot_printf(&cpuText, "CPU: %.1f%%", shownCpu);
+    text_slot_draw(&cpuText, r->x + overlayOffset, r->y, theme->scale[THEME_S_STATS], textColor);
+
+    draw_bar(THEME_R_FPS_BAR, overlayOffset, shownFps / 60.0f, theme_color(theme, THEME_C_FPS_BAR));
+    r = &theme->rect[THEME_R_FPS_TEXT];
+    text_slot_printf(&fpsText, "FPS: %.1f", shownFps);
+    text_slot_draw(&fpsText, r->x + overlayOffset, r->y, theme->scale[THEME_S_STATS], textColor);
+
+    // Low battery pulse
+    if(pulse) {
+        u8 alpha = pulse == 1 ? 255 : 128;
+        C2D_DrawRectSolid(overlayOffset, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, theme_color_alpha(theme, THEME_C_LOW_PULSE, alpha));
     }
+}
+
+int main() {
+    startup_init(&boot);
+    gfxInitDefault();
+    C3D_Init(C3D_DEFAULT_CMDBUF_SIZE);
+    C2D_Init();
+    C2D_Prepare();
+    C2D_Target* top = C2D_CreateScreenTarget(GFX_TOP, GFX_LEFT);
+
+    consoleInit(GFX_BOTTOM, NULL);
+    console_grid_init(&bottomGrid, 40, 30, NULL, NULL);
+
+    // Everything the first frame needs is in memory already; the SD card
+    // and sensors are read by the loader while the intro plays
+    theme_default(&bootTheme);
+    GovConfig govConfig;
+    governor_config_defaults(&govConfig);
+    governor_init(&governor, &govConfig);
+    text_cache_init(&textCache);
+    text_slot_init(&batteryText);
+    text_slot_init(&cpuText);
+    text_slot_init(&fpsText);
+    mem_arena_init(&frameArena, FRAME_ARENA_BYTES);
+    InputConfig inputConfig;
+    input_config_defaults(&inputConfig, 0);   // no held-key actions here
+    input_init(&input, &inputConfig);
+    input_start(&input);
+    cpu_load_start();
+    startup_start(&boot, bootStages, BOOT_STAGES);
+    mem_track_static(MEM_CONFIG, sizeof(config) + sizeof(configWatch) + sizeof(configWriter) + sizeof(configSnapshots));
+    mem_track_static(MEM_TEXT, sizeof(textCache) + sizeof(batteryText) * 3);
+    mem_track_static(MEM_UI, sizeof(scene) + sizeof(bottomGrid) + sizeof(frameTimer));
+    mem_track_static(MEM_OTHER, sizeof(batteryHistory) + sizeof(governor));
+
+    aptHookCookie aptCookie;
+    aptHook(&aptCookie, on_apt_event, NULL);
+    scene_init(&scene);
+    frame_timer_init(&frameTimer);
+    float shownCpu = cpu_usage, shownFps = fps;
+    u32 lastStats = platform_ms();
+    u32 lastLog = 0;
 
-    // --- Main overlay loop ---
     while(aptMainLoop()) {
-        hidScanInput();
-        u32 kDown = hidKeysDown();
+        mem_arena_reset(&frameArena);
+        take_boot_stages();
+        bool haveConfig = startup_ready(&boot, BOOT_CONFIG);
+        bool haveSensors = startup_ready(&boot, BOOT_SENSORS);
+
+        u32 kDown = input_keys_down(&input);
         if(kDown & KEY_START) break;
-        if(kDown & KEY_SELECT) {
+        // any other key skips the intro
+        bool intro = introProgress < 1.0f;
+        if(intro && kDown) {
+            introProgress = 1.0f;
+            intro = false;
+            kDown = 0;
+        }
+        if((kDown & KEY_SELECT) && haveSensors) {
             battery_saver = !battery_saver;
-            set_battery_saver(battery_saver);
-            write_bool_config(CONFIG_PATH, "battery_saver", battery_saver);
+            governor_set_floor(&governor, platform_ms(), battery_saver);
+            apply_governor();
+            config_writer_set_bool(&configWriter, "battery_saver", battery_saver, platform_ms());
+        }
+        if(kDown & KEY_X) frame_timer_dump(&frameTimer, FRAMETIME_PATH);
+        if((kDown & KEY_R) && startup_ready(&boot, BOOT_THEMES)) {
+            theme = theme_next(&themes);
+            scene_invalidate(&scene);
+            config_writer_set_string(&configWriter, "theme", theme->name, platform_ms());
         }
 
         update_cpu_usage();
         update_fps();
-        if(overlayOffset < 0) overlayOffset += 8.0f;
-
-        u8 battery = get_battery_percent();
+        if(intro) introProgress += INTRO_STEP;
+        else if(overlayOffset < 0) overlayOffset += 8.0f;
 
-        C3D_FrameBegin(C3D_FRAME_SYNCDRAW);
-        C2D_TargetClear(top, theme_background);
-        C2D_SceneBegin(top);
+        u8 battery = 0;
+        if(haveSensors) {
+            sensors_poll();
+            battery = (u8)sensors_get(SENSOR_BATTERY);
+        }
 
-        // Battery
-        draw_battery_bar(50 + overlayOffset, 50, battery, 1.0f);
-
-        // Battery % text
-        char buf[16];
-        snprintf(buf, sizeof(buf), "%d%%", battery);
-        C2D_DrawTextBuf(C2D_TextBufNew(), 140 + overlayOffset, 55, 0, 1.0f, 1.0f, buf, C2D_Color32(255,255,255,255));
-
-        // Battery saver
-        if(battery_saver) {
-            C2D_DrawRectSolid(50 + overlayOffset, 100, 0, 50, 30, C2D_Color32(0,128,255,255));
-            C2D_DrawTextBuf(C2D_TextBufNew(), 55 + overlayOffset, 105, 0, 0.7f, 0.7f, "Saver ON", C2D_Color32(255,255,255,255));
-        } else {
-            C2D_DrawRectSolid(50 + overlayOffset, 100, 0, 50, 30, C2D_Color32(128,128,128,255));
-            C2D_DrawTextBuf(C2D_TextBufNew(), 55 + overlayOffset, 105, 0, 0.7f, 0.7f, "Saver OFF", C2D_Color32(255,255,255,255));
+        u32 now = platform_ms();
+        if(haveConfig) {
+            if(config_watch_poll(&configWatch, &config, now, on_config_change, NULL)) apply_config_changes();
+            config_writer_poll(&configWriter, now);
+        }
+        if(haveSensors && governor_update(&governor, now, battery)) apply_governor();
+        u32 wall = platform_wall_s();
+        if(startup_ready(&boot, BOOT_HISTORY)) {
+            battery_history_add(&batteryHistory, wall, battery);
+            battery_history_maybe_save(&batteryHistory, BATTERY_HISTORY_PATH, wall);
+        }
+        bool statsTick = now - lastStats >= statsRefreshMs;
+        if(statsTick) {
+            shownCpu = cpu_usage;
+            shownFps = fps;
+            lastStats = now;
+        }
+        if(haveSensors && telemetry_active() && now - lastLog >= PERF_LOG_PERIOD_MS) {
+            log_telemetry(battery);
+            lastLog = now;
+        }
+        if(!boot.full_data_ms && startup_all_taken(&boot) && cpuSampled) {
+            startup_full_data(&boot);
+            mem_track_mark();
+            statsTick = true;
         }
+        u8 pulse = haveSensors && battery <= theme->low_pulse_pct ? 1 + ((now / 500) & 1) : 0;
 
-        // CPU & FPS bars
-        C2D_DrawRectSolid(50 + overlayOffset, 150, 0, 200 * cpu_usage / 100.0f, 20, C2D_Color32(255,128,0,255));
-        snprintf(buf, sizeof(buf), "CPU: %.1f%%", cpu_usage);
-        C2D_DrawTextBuf(C2D_TextBufNew(), 50 + overlayOffset, 145, 0, 0.6f, 0.6f, buf, C2D_Color32(255,255,255,255));
+        scene_update(&scene, W_BATTERY, &battery, sizeof(battery));
+        scene_update(&scene, W_SAVER, &battery_saver, sizeof(battery_saver));
+        scene_update(&scene, W_CPU, &shownCpu, sizeof(shownCpu));
+        scene_update(&scene, W_FPS, &shownFps, sizeof(shownFps));
+        scene_update(&scene, W_PULSE, &pulse, sizeof(pulse));
+        scene_animate(&scene, intro || overlayOffset < 0);
 
-        C2D_DrawRectSolid(50 + overlayOffset, 180, 0, 200 * fps / 60.0f, 20, C2D_Color32(0,255,128,255));
-        snprintf(buf, sizeof(buf), "FPS: %.1f", fps);
-        C2D_DrawTextBuf(C2D_TextBufNew(), 50 + overlayOffset, 175, 0, 0.6f, 0.6f, buf, C2D_Color32(255,255,255,255));
+        // bottom screen, at the readout rate; the grid only emits changed cells
+        BottomText* bt = statsTick || kDown ? (BottomText*)mem_arena_alloc(&frameArena, sizeof(BottomText)) : NULL;
+        if(bt) {
+            frame_timer_format(&frameTimer, bt->frame, sizeof(bt->frame));
+            console_grid_begin(&bottomGrid);
+            battery_history_format_tte(bt->tte, sizeof(bt->tte), battery_history_tte(&batteryHistory, wall));
+            console_grid_printf(&bottomGrid, "Battery: %d%% (~%.0f%%), %s left\n", battery,
+                                battery_history_smoothed(&batteryHistory, wall), bt->tte);
+            console_grid_printf(&bottomGrid, "Battery Saver: %s\n", battery_saver?"ON":"OFF");
+            if(governor.runtime_min >= 0)
+                console_grid_printf(&bottomGrid, "Governor: %s, ~%d min left\n", governor_tier_name(governor.tier), (int)governor.runtime_min);
+            else
+                console_grid_printf(&bottomGrid, "Governor: %s\n", governor_tier_name(governor.tier));
+            console_grid_printf(&bottomGrid, "CPU: %.1f%% (core1 %.1f%%)\nFPS: %.1f\n", shownCpu, cpu_load_avg(1), shownFps);
+            console_grid_printf(&bottomGrid, "Frames drawn: %lu  skipped: %lu\n", (unsigned long)scene.frames_rendered, (unsigned long)scene.frames_skipped);
+            console_grid_printf(&bottomGrid, "Frame %s\n", bt->frame);
+            input_format_latency(&input, bt->latency, sizeof(bt->latency));
+            console_grid_printf(&bottomGrid, "Latency: %s\n", bt->latency);
+            startup_format(&boot, bt->startup, sizeof(bt->startup));
+            console_grid_printf(&bottomGrid, "%s\n", bt->startup);
+            // drift from the startup footprint; stays at +0 in a long session
+            mem_track_format_total(bt->mem, sizeof(bt->mem));
+            console_grid_printf(&bottomGrid, "%s\n", bt->mem);
+            mem_arena_format(&frameArena, bt->mem, sizeof(bt->mem));
+            console_grid_printf(&bottomGrid, "%s\n", bt->mem);
+            console_grid_printf(&bottomGrid, "Press START to exit, SELECT to toggle battery saver, Y to hide overlay\n");
+            console_grid_printf(&bottomGrid, "X: dump frame-time histogram\n");
+            console_grid_printf(&bottomGrid, "R: next theme (%s)\n", theme->name);
+            console_grid_flush(&bottomGrid);
+        }
 
-        // Low battery pulse
-        if(battery <= 20) {
-            u32 t = svcGetSystemTick() / 1000000;
-            u8 alpha = (t%1000 < 500) ? 255 : 128;
-            C2D_DrawRectSolid(overlayOffset, 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT, C2D_Color32(255,0,0,alpha));
+        if(!scene_should_render(&scene)) {
+            // nothing visible changed: keep the last frame on screen
+            scene_end_frame(&scene, false);
+            input_frame_end(&input, false);
+            gspWaitForVBlank();
+            input_vblank(&input, platform_perf_us());
+            frame_timer_end(&frameTimer, platform_perf_us(), false);
+            continue;
         }
 
+        // SYNCDRAW waits for the vblank, so the frame starts when this returns
+        C3D_FrameBegin(C3D_FRAME_SYNCDRAW);
+        u64 vblank = platform_perf_us();
+        frame_timer_mark(&frameTimer, FT_BEGIN, vblank);
+        input_vblank(&input, vblank);
+        C2D_TargetClear(top, theme_color(theme, THEME_C_BACKGROUND));
+        C2D_SceneBegin(top);
+        if(intro) draw_intro(battery);
+        else draw_overlay(battery, haveSensors, shownCpu, shownFps, pulse);
+
+        u64 cpuDone = platform_perf_us();
+        frame_timer_mark(&frameTimer, FT_CPU_DONE, cpuDone);
         C3D_FrameEnd(0);
+        // citro3d reports the GPU time of the last completed frame
+        frame_timer_mark(&frameTimer, FT_GPU_DONE, cpuDone + (u64)(C3D_GetDrawingTime() * 1000.0f));
+        frame_timer_end(&frameTimer, vblank, true);
+        input_frame_end(&input, true);
+        startup_frame_drawn(&boot);
+        scene_end_frame(&scene, true);
 
-        consoleSelect(GFX_BOTTOM);
-        printf("\x1b[2J");
-        printf("Battery: %d%%\n", battery);
-        printf("Battery Saver: %s\n", battery_saver?"ON":"OFF");
-        printf("CPU: %.1f%%\nFPS: %.1f\n", cpu_usage, fps);
-        printf("Press START to exit, SELECT to toggle battery saver, Y to hide overlay\n");
     }
 
+    aptUnhook(&aptCookie);
+    input_stop(&input);
+    // the loader may still be reading; after this every stage is done
+    startup_finish(&boot, STARTUP_LOG_PATH);
+    config_writer_flush(&configWriter);
+    sensors_stop_worker();
+    cpu_load_stop();
+    telemetry_stop();
+    if(batteryHistory.dirty) battery_history_save(&batteryHistory, BATTERY_HISTORY_PATH);
+    text_slot_free(&batteryText);
+    text_slot_free(&cpuText);
+    text_slot_free(&fpsText);
+    text_cache_free(&textCache);
+    mem_arena_free(&frameArena);
     C2D_Fini();
     C3D_Fini();
     gfxExit();
@@ -0,0 +1,52 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+// Platform interface used by system_utils.h and the host-testable layers.
+// Each backend provides:
+//   u8   platform_battery_percent(void)
+//   void platform_set_brightness(int top, int bottom)
+//   u32  platform_free_memory(void)
+//   u64  platform_sd_free(void)
+//   void platform_mem_info(PlatformMemInfo* m)   app region, heap, linear free
+//   u32  platform_keys_held(void)        scans HID; one caller only (input.h)
+//   u64  platform_ticks(void)            monotonic, PLATFORM_TICKS_PER_SEC
+//   u64  platform_perf_us(void)          wall-clock microseconds, for cost timing
+//   u32  platform_wall_s(void)           calendar seconds, survives restarts
+//   void platform_sleep_ms(u32 ms)
+//   PlatformLock   platform_lock_init/lock/unlock
+//   PlatformThread platform_thread_start(t, fn, arg)   below the caller's priority
+//                  platform_thread_start_high(t, fn, arg)   above the caller's priority
+//                  platform_thread_start_idle(t, fn, arg, core)   lowest priority
+//                  platform_thread_join(t)
+//   int  platform_core_count(void)       cores an app thread may run on
+//   bool platform_claim_syscore(u32 percent)   grant the app time on core 1
+//
+// __3DS__ is defined by the devkitARM 3DS rules; anything else gets the
+// simulated Linux backend driven by scripted traces.
+
+#include <stdint.h>
+
+// declared before the backends, which define u32 themselves
+typedef struct {
+    uint32_t app_total;       // APPLICATION memory region
+    uint32_t app_used;
+    uint32_t heap_used;       // malloc'd and not freed
+    uint32_t linear_free;     // GPU-visible heap left
+} PlatformMemInfo;
+
+#ifdef __3DS__
+#include "platform_3ds.h"
+#else
+#include "platform_sim.h"
+#endif
+
+static inline u64 platform_ticks_to_us(u64 ticks) {
+    return ticks / PLATFORM_TICKS_PER_SEC * 1000000ULL +
+           (ticks % PLATFORM_TICKS_PER_SEC) * 1000000ULL / PLATFORM_TICKS_PER_SEC;
+}
+
+static inline u32 platform_ms(void) {
+    return (u32)(platform_ticks() * 1000ULL / PLATFORM_TICKS_PER_SEC);
+}
+
+#endif
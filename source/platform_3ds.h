@@ -0,0 +1,123 @@
+#ifndef PLATFORM_3DS_H
+#define PLATFORM_3DS_H
+
+#include <3ds.h>
+#include <time.h>
+#include <malloc.h>
+
+// 3DS backend: the libctru calls that used to live in system_utils.h
+
+#define PLATFORM_TICKS_PER_SEC SYSCLOCK_ARM11
+
+static inline u8 platform_battery_percent(void) {
+    return ((u32)powerGetBatteryLevel()) * 10; // simple conversion
+}
+
+static inline void platform_set_brightness(int top, int bottom) {
+    gfxSetBrightness(GFX_TOP, top);
+    gfxSetBrightness(GFX_BOTTOM, bottom);
+}
+
+static inline u32 platform_free_memory(void) {
+    u32 free_mem;
+    svcGetInfo(&free_mem, 0x10003, CUR_PROCESS_HANDLE, 0); // CUR_PROCESS info
+    return free_mem;
+}
+
+static inline void platform_mem_info(PlatformMemInfo* m) {
+    m->app_total = osGetMemRegionSize(MEMREGION_APPLICATION);
+    m->app_used = osGetMemRegionUsed(MEMREGION_APPLICATION);
+    m->heap_used = (u32)mallinfo().uordblks;
+    m->linear_free = linearSpaceFree();
+}
+
+static inline u32 platform_keys_held(void) {
+    hidScanInput();
+    return hidKeysHeld();
+}
+
+static inline u64 platform_sd_free(void) {
+    u64 free, total;
+    FS_Archive sdmc;
+    FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""));
+    FSUSER_GetFreeSpace(&sdmc, &free, &total);
+    FSUSER_CloseArchive(&sdmc);
+    return free;
+}
+
+static inline u64 platform_ticks(void) {
+    return svcGetSystemTick();
+}
+
+// ticks * 1000000 would overflow u64 after ~19 h of uptime; split it
+static inline u64 platform_perf_us(void) {
+    u64 t = svcGetSystemTick();
+    return t / SYSCLOCK_ARM11 * 1000000ULL + (t % SYSCLOCK_ARM11) * 1000000ULL / SYSCLOCK_ARM11;
+}
+
+static inline u32 platform_wall_s(void) {
+    return (u32)time(NULL);
+}
+
+static inline void platform_sleep_ms(u32 ms) {
+    svcSleepThread((s64)ms * 1000000LL);
+}
+
+typedef LightLock PlatformLock;
+
+static inline void platform_lock_init(PlatformLock* l) { LightLock_Init(l); }
+static inline void platform_lock(PlatformLock* l) { LightLock_Lock(l); }
+static inline void platform_unlock(PlatformLock* l) { LightLock_Unlock(l); }
+
+#define PLATFORM_THREAD_STACK (16 * 1024)
+
+typedef struct {
+    Thread handle;
+} PlatformThread;
+
+// Start fn(arg) one priority step below the calling thread, so background
+// work never preempts the render loop.
+static inline bool platform_thread_start(PlatformThread* t, void (*fn)(void*), void* arg) {
+    s32 prio = 0x30;
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+    if(prio < 0x3F) prio++;
+    t->handle = threadCreate(fn, arg, PLATFORM_THREAD_STACK, prio, -2, false);
+    return t->handle != NULL;
+}
+
+// Start fn(arg) one priority step above the calling thread, for short
+// periodic work that must not wait behind a frame (input sampling). 0x18 is
+// the highest priority an application thread may take.
+static inline bool platform_thread_start_high(PlatformThread* t, void (*fn)(void*), void* arg) {
+    s32 prio = 0x30;
+    svcGetThreadPriority(&prio, CUR_THREAD_HANDLE);
+    if(prio > 0x18) prio--;
+    t->handle = threadCreate(fn, arg, PLATFORM_THREAD_STACK, prio, -2, false);
+    return t->handle != NULL;
+}
+
+// Start fn(arg) at the lowest priority, pinned to core.
+static inline bool platform_thread_start_idle(PlatformThread* t, void (*fn)(void*), void* arg, int core) {
+    t->handle = threadCreate(fn, arg, PLATFORM_THREAD_STACK, 0x3F, core, false);
+    return t->handle != NULL;
+}
+
+// The syscore (core 1) is only usable once the app was granted CPU time on it.
+static inline int platform_core_count(void) {
+    u32 percent = 0;
+    return R_SUCCEEDED(APT_GetAppCpuTimeLimit(&percent)) && percent > 0 ? 2 : 1;
+}
+
+// Ask for percent of the syscore's time for this app.
+static inline bool platform_claim_syscore(u32 percent) {
+    return R_SUCCEEDED(APT_SetAppCpuTimeLimit(percent));
+}
+
+static inline void platform_thread_join(PlatformThread* t) {
+    if(!t->handle) return;
+    threadJoin(t->handle, U64_MAX);
+    threadFree(t->handle);
+    t->handle = NULL;
+}
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef PLATFORM_SIM_H
+#define PLATFORM_SIM_H
+
+// Simulated Linux backend.
+// Sensor values come from a scripted trace, one sample per line:
+//     <time_ms> <battery_percent> <free_mem_bytes> <sd_free_bytes>
+// '#' starts a comment. The clock is virtual and only moves when the
+// host driver calls platform_sim_advance_ms(), so runs are repeatable.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <malloc.h>
+
+typedef uint8_t  u8;
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t  s32;
+typedef int64_t  s64;
+
+#define PLATFORM_TICKS_PER_SEC 268111856ULL // same rate as the ARM11 tick
+#define PLATFORM_SIM_MAX_SAMPLES 4096
+#define PLATFORM_SIM_EPOCH 1700000000u  // calendar time at virtual t=0
+#define PLATFORM_SIM_APP_MEM (64u << 20)  // size of the 3DS APPLICATION region
+
+// libctru's key bits
+enum {
+    KEY_A = 1u << 0, KEY_B = 1u << 1, KEY_SELECT = 1u << 2, KEY_START = 1u << 3,
+    KEY_DRIGHT = 1u << 4, KEY_DLEFT = 1u << 5, KEY_DUP = 1u << 6, KEY_DDOWN = 1u << 7,
+    KEY_R = 1u << 8, KEY_L = 1u << 9, KEY_X = 1u << 10, KEY_Y = 1u << 11,
+    KEY_ZL = 1u << 14, KEY_ZR = 1u << 15,
+    KEY_CPAD_RIGHT = 1u << 28, KEY_CPAD_LEFT = 1u << 29, KEY_CPAD_UP = 1u << 30, KEY_CPAD_DOWN = 1u << 31,
+    KEY_RIGHT = KEY_DRIGHT | KEY_CPAD_RIGHT, KEY_LEFT = KEY_DLEFT | KEY_CPAD_LEFT,
+    KEY_UP = KEY_DUP | KEY_CPAD_UP, KEY_DOWN = KEY_DDOWN | KEY_CPAD_DOWN,
+};
+
+typedef struct {
+    u32 time_ms;
+    u8 battery;
+    u32 free_mem;
+    u64 sd_free;
+} SimSample;
+
+typedef struct {
+    SimSample samples[PLATFORM_SIM_MAX_SAMPLES];
+    int count;
+    int cursor;              // last sample with time_ms <= now_ms; atomic
+    u64 now_ms;              // atomic
+    int brightness_top;
+    int brightness_bottom;
+    u32 sd_queries;          // how often the "SD card" was hit; atomic
+    u32 keys;                // held keys, set by the host driver; atomic
+} PlatformSim;
+
+static PlatformSim platform_sim = {
+    .samples = { { 0, 100, 64u << 20, 1ULL << 30 } },
+    .count = 1,
+    .brightness_top = 100,
+    .brightness_bottom = 100,
+};
+
+// Load a trace file. Returns the number of samples, 0 on failure (the
+// previous trace is kept).
+static inline int platform_sim_load_trace(const char* path) {
+    FILE* f = fopen(path, "r");
+    if(!f) return 0;
+    int n = 0;
+    char line[128];
+    while(n < PLATFORM_SIM_MAX_SAMPLES && fgets(line, sizeof(line), f)) {
+        unsigned t, batt;
+        unsigned long mem;
+        unsigned long long sd;
+        if(line[0] == '#') continue;
+        if(sscanf(line, "%u %u %lu %llu", &t, &batt, &mem, &sd) != 4) continue;
+        SimSample* s = &platform_sim.samples[n++];
+        s->time_ms = t;
+        s->battery = batt > 100 ? 100 : (u8)batt;
+        s->free_mem = (u32)mem;
+        s->sd_free = sd;
+    }
+    fclose(f);
+    if(n == 0) return 0;
+    platform_sim.count = n;
+    __atomic_store_n(&platform_sim.cursor, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&platform_sim.now_ms, 0, __ATOMIC_RELAXED);
+    return n;
+}
+
+// Only the host driver advances the clock; the worker threads read it.
+static inline void platform_sim_advance_ms(u32 ms) {
+    u64 now = __atomic_load_n(&platform_sim.now_ms, __ATOMIC_RELAXED) + ms;
+    int cursor = __atomic_load_n(&platform_sim.cursor, __ATOMIC_RELAXED);
+    while(cursor + 1 < platform_sim.count && platform_sim.samples[cursor + 1].time_ms <= now) cursor++;
+    __atomic_store_n(&platform_sim.cursor, cursor, __ATOMIC_RELAXED);
+    __atomic_store_n(&platform_sim.now_ms, now, __ATOMIC_RELAXED);
+}
+
+// Time of the last trace sample, i.e. how long a replay should run.
+static inline u32 platform_sim_duration_ms(void) {
+    return platform_sim.samples[platform_sim.count - 1].time_ms;
+}
+
+static inline const SimSample* platform_sim_current(void) {
+    return &platform_sim.samples[__atomic_load_n(&platform_sim.cursor, __ATOMIC_RELAXED)];
+}
+
+static inline u8 platform_battery_percent(void) {
+    return platform_sim_current()->battery;
+}
+
+static inline void platform_set_brightness(int top, int bottom) {
+    platform_sim.brightness_top = top;
+    platform_sim.brightness_bottom = bottom;
+}
+
+static inline u32 platform_free_memory(void) {
+    return platform_sim_current()->free_mem;
+}
+
+static inline u32 platform_keys_held(void) {
+    return __atomic_load_n(&platform_sim.keys, __ATOMIC_RELAXED);
+}
+
+// The region figures follow the trace; the heap is the host's real one.
+static inline void platform_mem_info(PlatformMemInfo* m) {
+    u32 free_mem = platform_sim_current()->free_mem;
+    m->app_total = PLATFORM_SIM_APP_MEM;
+    m->app_used = free_mem < PLATFORM_SIM_APP_MEM ? PLATFORM_SIM_APP_MEM - free_mem : 0;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    m->heap_used = (u32)mallinfo2().uordblks;
+#else
+    m->heap_used = 0;
+#endif
+    m->linear_free = 0;
+}
+
+static inline u64 platform_sd_free(void) {
+    __atomic_add_fetch(&platform_sim.sd_queries, 1, __ATOMIC_RELAXED);
+    return platform_sim_current()->sd_free;
+}
+
+static inline u64 platform_ticks(void) {
+    return __atomic_load_n(&platform_sim.now_ms, __ATOMIC_RELAXED) * PLATFORM_TICKS_PER_SEC / 1000ULL;
+}
+
+static inline u32 platform_wall_s(void) {
+    return PLATFORM_SIM_EPOCH + (u32)(__atomic_load_n(&platform_sim.now_ms, __ATOMIC_RELAXED) / 1000);
+}
+
+// Cost timing and sleeping use the real clock, not the virtual one.
+static inline u64 platform_perf_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000ULL + (u64)ts.tv_nsec / 1000ULL;
+}
+
+static inline void platform_sleep_ms(u32 ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+typedef pthread_mutex_t PlatformLock;
+
+static inline void platform_lock_init(PlatformLock* l) { pthread_mutex_init(l, NULL); }
+static inline void platform_lock(PlatformLock* l) { pthread_mutex_lock(l); }
+static inline void platform_unlock(PlatformLock* l) { pthread_mutex_unlock(l); }
+
+typedef struct {
+    pthread_t handle;
+    bool started;
+    void (*fn)(void*);
+    void* arg;
+} PlatformThread;
+
+static inline void* platform_thread_entry(void* p) {
+    PlatformThread* t = (PlatformThread*)p;
+    t->fn(t->arg);
+    return NULL;
+}
+
+// Priorities are not modelled on the host.
+static inline bool platform_thread_start(PlatformThread* t, void (*fn)(void*), void* arg) {
+    t->fn = fn;
+    t->arg = arg;
+    t->started = pthread_create(&t->handle, NULL, platform_thread_entry, t) == 0;
+    return t->started;
+}
+
+static inline bool platform_thread_start_high(PlatformThread* t, void (*fn)(void*), void* arg) {
+    return platform_thread_start(t, fn, arg);
+}
+
+static inline bool platform_thread_start_idle(PlatformThread* t, void (*fn)(void*), void* arg, int core) {
+    (void)core;
+    return platform_thread_start(t, fn, arg);
+}
+
+static inline int platform_core_count(void) {
+    return 2;
+}
+
+static inline bool platform_claim_syscore(u32 percent) {
+    (void)percent;
+    return true;
+}
+
+static inline void platform_thread_join(PlatformThread* t) {
+    if(!t->started) return;
+    pthread_join(t->handle, NULL);
+    t->started = false;
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <stdbool.h>
+#include <string.h>
+#include "platform.h"
+
+// Retained scene model for change-driven rendering.
+// Each widget keeps a copy of the state it was last drawn with; the app
+// pushes the current state every frame and a frame is only submitted when
+// some widget changed, an animation is running, or the scene was
+// invalidated (first frame, return from HOME). Counters record how many
+// frames were rendered versus skipped.
+
+#define SCENE_MAX_WIDGETS 16
+#define SCENE_STATE_MAX   32   // bytes of visible state per widget
+
+typedef struct {
+    u8 state[SCENE_STATE_MAX];
+    u8 size;
+    bool dirty;
+} SceneWidget;
+
+typedef struct {
+    SceneWidget widgets[SCENE_MAX_WIDGETS];
+    bool invalid;             // redraw everything on the next frame
+    bool animating;           // set per frame by the app
+    u32 frames_rendered;
+    u32 frames_skipped;
+} Scene;
+
+static inline void scene_init(Scene* sc) {
+    memset(sc, 0, sizeof(*sc));
+    sc->invalid = true;
+}
+
+static inline void scene_invalidate(Scene* sc) {
+    sc->invalid = true;
+}
+
+// Push the visible state of widget id. Marks it dirty if it differs from
+// what was last drawn. Returns the dirty flag.
+static inline bool scene_update(Scene* sc, int id, const void* state, size_t size) {
+    SceneWidget* w = &sc->widgets[id];
+    if(size > SCENE_STATE_MAX) size = SCENE_STATE_MAX;
+    if(w->size != size || memcmp(w->state, state, size) != 0) {
+        memcpy(w->state, state, size);
+        w->size = (u8)size;
+        w->dirty = true;
+    }
+    return w->dirty;
+}
+
+// Mark an animation (slide-in, pulse) as running for this frame.
+static inline void scene_animate(Scene* sc, bool active) {
+    if(active) sc->animating = true;
+}
+
+static inline bool scene_should_render(const Scene* sc) {
+    if(sc->invalid || sc->animating) return true;
+    for(int i = 0; i < SCENE_MAX_WIDGETS; i++)
+        if(sc->widgets[i].dirty) return true;
+    return false;
+}
+
+// Close the frame: clear dirty state and count it as rendered or skipped.
+static inline void scene_end_frame(Scene* sc, bool rendered) {
+    if(rendered) {
+        for(int i = 0; i < SCENE_MAX_WIDGETS; i++) sc->widgets[i].dirty = false;
+        sc->invalid = false;
+        sc->frames_rendered++;
+    } else {
+        sc->frames_skipped++;
+    }
+    sc->animating = false;
+}
+
+#endif
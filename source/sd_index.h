@@ -0,0 +1,508 @@
+#ifndef SD_INDEX_H
+#define SD_INDEX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "platform.h"
+#include "config_store.h"
+#include "mem_track.h"
+
+// SD card usage index.
+// A walker visits every directory under the root breadth-first and sums
+// the sizes of the files directly inside it; the totals per subtree are
+// rolled up once the walk ends. All walker state lives in SdIndex, so the
+// walk runs in slices of sd_index_step(), each bounded by a time budget and
+// resumable in the middle of a directory listing. The worker thread runs
+// one short slice, then sleeps, at the lowest priority.
+//
+// The finished table is persisted. The next walk loads it and, for every
+// directory whose mtime did not move, reuses its file totals and list of
+// subdirectories instead of reading it again; only its subdirectories are
+// stat()ed. FAT does not update a directory's mtime when a file in it just
+// grows, so a walk older than SD_INDEX_FULL_S reads everything again.
+//
+// Two tables: the walker fills `next` while the UI reads `current`, and a
+// finished walk swaps them under the lock. They are the app's largest
+// buffer and come from mem_alloc(), charged to MEM_SD_INDEX.
+
+#define SD_INDEX_MAX_DIRS   1024
+#define SD_INDEX_NAME_LEN   40    // longer names are not descended into
+#define SD_INDEX_PATH_LEN   256
+#define SD_INDEX_DEPTH      32    // deeper directories are not read
+#define SD_INDEX_SLOTS      2048  // path lookup, power of two
+#define SD_INDEX_SLICE_US   2000  // worker time slice
+#define SD_INDEX_PAUSE_MS   8     // worker sleep between slices
+#define SD_INDEX_FULL_S     (24 * 3600)
+#define SD_INDEX_MAGIC      0x58444953u  // "SIDX"
+#define SD_INDEX_VERSION    1
+#define SD_INDEX_NONE       0xFFFF
+#define SD_INDEX_FILE       "/3ds/system_enhancer/sd_index.bin"
+
+#define SD_DIR_TRUNCATED    1     // the directory or some subdirectories were not indexed
+
+// The SD card has no links; on the host, do not follow them out of the tree.
+#ifdef __3DS__
+#define sd_index_stat stat
+#else
+#define sd_index_stat lstat
+#endif
+
+#define SD_MTIME_UNKNOWN    (-1)  // never matches, so the directory is read
+
+typedef struct {
+    char name[SD_INDEX_NAME_LEN];
+    u32 hash;                 // config_hash() of the full path
+    u16 parent;               // SD_INDEX_NONE for the root
+    u16 first_child;          // subdirectories are contiguous
+    u16 children;
+    u16 flags;
+    u32 files;                // directly inside
+    s64 mtime;
+    u64 own_bytes;            // files directly inside
+    u64 total_bytes;          // whole subtree
+} SdDir;
+
+typedef struct {
+    u32 magic;
+    u16 version;
+    u16 entry_size;
+    u32 count;
+    u32 scan_time;            // platform_wall_s() when the walk finished
+    u32 scan_ms;              // walk duration, pauses included
+    u32 files;
+    u32 reused;               // directories taken over from the previous walk
+    u32 full;                 // nothing was reused on purpose
+} SdIndexHeader;
+
+typedef struct {
+    SdIndexHeader h;
+    SdDir dirs[SD_INDEX_MAX_DIRS];
+} SdIndexTable;
+
+typedef enum {
+    SD_INDEX_IDLE = 0,
+    SD_INDEX_SCANNING,
+    SD_INDEX_DONE
+} SdIndexState;
+
+typedef struct {
+    char root[SD_INDEX_PATH_LEN];
+    char path[128];           // persisted table, "" to not persist
+    SdIndexTable* tables;     // two, NULL if sd_index_init() failed
+    SdIndexTable* current;    // swapped under lock
+    SdIndexTable* next;       // walker only
+
+    // walker only
+    u16 lookup[SD_INDEX_SLOTS];   // index + 1 into current
+    u32 cursor;               // next directory of `next` to visit
+    DIR* dir;                 // listing of dirs[cursor] in progress
+    char dir_path[SD_INDEX_PATH_LEN];
+    int dir_len;
+    bool full;
+    u64 start_us;
+    u32 reused;
+
+    // walk cost
+    u32 slices;
+    u32 slice_max_us;
+    u64 busy_us;
+    u32 stats;                // stat() calls this walk
+
+    int state;                // SdIndexState; atomic
+    u32 visited;              // progress; atomic
+    u32 generation;           // bumped per finished walk; atomic
+    bool rescan;              // start a walk when idle; atomic
+    bool running;             // worker active; atomic
+    PlatformLock lock;
+    PlatformThread worker;
+} SdIndex;
+
+// Write the path of t->dirs[i] into out. Returns its length, or -1 if the
+// directory is nested deeper than SD_INDEX_DEPTH or its path does not fit;
+// out is then empty.
+static inline int sd_index_path(const SdIndex* ix, const SdIndexTable* t, u32 i, char* out, int n) {
+    u16 chain[SD_INDEX_DEPTH];
+    int depth = 0;
+    out[0] = '\0';
+    for(u32 d = i; d != SD_INDEX_NONE; d = t->dirs[d].parent) {
+        if(depth == SD_INDEX_DEPTH) return -1;
+        chain[depth++] = (u16)d;
+    }
+    int len = snprintf(out, n, "%s", ix->root);
+    if(len >= n) {
+        out[0] = '\0';
+        return -1;
+    }
+    // chain ends with the root, whose name is empty
+    for(int k = depth - 2; k >= 0; k--) {
+        bool slash = len > 0 && out[len - 1] == '/';
+        int w = snprintf(out + len, n - len, "%s%s", slash ? "" : "/", t->dirs[chain[k]].name);
+        if(w >= n - len) {
+            out[0] = '\0';
+            return -1;
+        }
+        len += w;
+    }
+    return len;
+}
+
+static inline void sd_index_build_lookup(SdIndex* ix) {
+    memset(ix->lookup, 0, sizeof(ix->lookup));
+    const SdIndexTable* t = ix->current;
+    for(u32 i = 0; i < t->h.count; i++) {
+        u32 s = t->dirs[i].hash & (SD_INDEX_SLOTS - 1);
+        while(ix->lookup[s]) s = (s + 1) & (SD_INDEX_SLOTS - 1);
+        ix->lookup[s] = (u16)(i + 1);
+    }
+}
+
+static inline const SdDir* sd_index_find_old(const SdIndex* ix, u32 hash, const char* name) {
+    u32 s = hash & (SD_INDEX_SLOTS - 1);
+    for(; ix->lookup[s]; s = (s + 1) & (SD_INDEX_SLOTS - 1)) {
+        const SdDir* d = &ix->current->dirs[ix->lookup[s] - 1];
+        if(d->hash == hash && strcmp(d->name, name) == 0) return d;
+    }
+    return NULL;
+}
+
+// Append a subdirectory of `parent` to the table being built.
+static inline bool sd_index_add(SdIndex* ix, u32 parent, const char* name) {
+    SdIndexTable* t = ix->next;
+    if(strlen(name) >= SD_INDEX_NAME_LEN || t->h.count >= SD_INDEX_MAX_DIRS) {
+        t->dirs[parent].flags |= SD_DIR_TRUNCATED;
+        return false;
+    }
+    SdDir* d = &t->dirs[t->h.count];
+    memset(d, 0, sizeof(*d));
+    strcpy(d->name, name);
+    d->parent = (u16)parent;
+    d->first_child = SD_INDEX_NONE;
+    if(!t->dirs[parent].children) t->dirs[parent].first_child = (u16)t->h.count;
+    t->dirs[parent].children++;
+    t->h.count++;
+    return true;
+}
+
+// Start a walk. Without `full`, unchanged directories of the current table
+// are reused; a table older than SD_INDEX_FULL_S forces a full walk.
+static inline void sd_index_begin(SdIndex* ix, bool full) {
+    const SdIndexHeader* old = &ix->current->h;
+    if(!old->count || platform_wall_s() - old->scan_time >= SD_INDEX_FULL_S) full = true;
+    if(ix->dir) closedir(ix->dir);
+    ix->dir = NULL;
+    ix->full = full;
+    ix->cursor = 0;
+    ix->reused = 0;
+    ix->slices = 0;
+    ix->slice_max_us = 0;
+    ix->busy_us = 0;
+    ix->stats = 0;
+    ix->start_us = platform_perf_us();
+    sd_index_build_lookup(ix);
+
+    SdIndexTable* t = ix->next;
+    memset(&t->h, 0, sizeof(t->h));
+    memset(&t->dirs[0], 0, sizeof(t->dirs[0]));
+    t->dirs[0].parent = SD_INDEX_NONE;
+    t->dirs[0].first_child = SD_INDEX_NONE;
+    t->h.count = 1;
+    __atomic_store_n(&ix->visited, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&ix->state, SD_INDEX_SCANNING, __ATOMIC_RELEASE);
+}
+
+// libctru's stat() leaves st_mtime 0 on the SD card, which would make every
+// directory look unchanged forever; the FAT timestamp comes from
+// sdmc_getmtime() instead.
+static inline s64 sd_index_mtime(const char* path) {
+#ifdef __3DS__
+    u64 mtime;
+    if(R_FAILED(sdmc_getmtime(path, &mtime)) || mtime == 0) return SD_MTIME_UNKNOWN;
+    return (s64)mtime;
+#else
+    struct stat st;
+    if(sd_index_stat(path, &st) != 0) return SD_MTIME_UNKNOWN;
+    return (s64)st.st_mtime;
+#endif
+}
+
+// Either take dirs[cursor] over from the previous walk or open its listing.
+// Returns false once the directory is finished (reused, unreadable or too
+// deep to name).
+static inline bool sd_index_enter(SdIndex* ix) {
+    SdIndexTable* t = ix->next;
+    SdDir* d = &t->dirs[ix->cursor];
+    ix->dir_len = sd_index_path(ix, t, ix->cursor, ix->dir_path, sizeof(ix->dir_path));
+    if(ix->dir_len < 0) {
+        d->mtime = SD_MTIME_UNKNOWN;
+        d->flags |= SD_DIR_TRUNCATED;
+        return false;
+    }
+    d->hash = config_hash(ix->dir_path);
+
+    ix->stats++;
+    d->mtime = sd_index_mtime(ix->dir_path);
+
+    const SdDir* o = ix->full ? NULL : sd_index_find_old(ix, d->hash, d->name);
+    if(o && o->mtime == d->mtime && d->mtime != SD_MTIME_UNKNOWN) {
+        d->files = o->files;
+        d->own_bytes = o->own_bytes;
+        d->flags = o->flags;
+        for(u32 c = 0; c < o->children; c++)
+            sd_index_add(ix, ix->cursor, ix->current->dirs[o->first_child + c].name);
+        ix->reused++;
+        return false;
+    }
+    ix->dir = opendir(ix->dir_path);
+    return ix->dir != NULL;
+}
+
+// Read one entry of the open listing. Returns false at its end.
+static inline bool sd_index_read(SdIndex* ix) {
+    struct dirent* e = readdir(ix->dir);
+    if(!e) return false;
+    const char* name = e->d_name;
+    if(name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]))) return true;
+
+    char child[SD_INDEX_PATH_LEN];
+    bool slash = ix->dir_len > 0 && ix->dir_path[ix->dir_len - 1] == '/';
+    if(snprintf(child, sizeof(child), "%s%s%s", ix->dir_path, slash ? "" : "/", name) >= (int)sizeof(child)) {
+        ix->next->dirs[ix->cursor].flags |= SD_DIR_TRUNCATED;
+        return true;
+    }
+    struct stat st;
+    ix->stats++;
+    if(sd_index_stat(child, &st) != 0) return true;
+    if(S_ISDIR(st.st_mode)) {
+        sd_index_add(ix, ix->cursor, name);
+    } else {
+        SdDir* d = &ix->next->dirs[ix->cursor];
+        d->own_bytes += (u64)st.st_size;
+        d->files++;
+    }
+    return true;
+}
+
+// Roll the totals up, then publish the table.
+static inline void sd_index_finish(SdIndex* ix) {
+    SdIndexTable* t = ix->next;
+    u32 files = 0;
+    for(u32 i = 0; i < t->h.count; i++) {
+        t->dirs[i].total_bytes = t->dirs[i].own_bytes;
+        files += t->dirs[i].files;
+    }
+    // children always come after their parent
+    for(u32 i = t->h.count - 1; i > 0; i--)
+        t->dirs[t->dirs[i].parent].total_bytes += t->dirs[i].total_bytes;
+
+    t->h.magic = SD_INDEX_MAGIC;
+    t->h.version = SD_INDEX_VERSION;
+    t->h.entry_size = sizeof(SdDir);
+    t->h.scan_time = platform_wall_s();
+    t->h.scan_ms = (u32)((platform_perf_us() - ix->start_us) / 1000);
+    t->h.files = files;
+    t->h.reused = ix->reused;
+    t->h.full = ix->full;
+
+    platform_lock(&ix->lock);
+    ix->next = ix->current;
+    ix->current = t;
+    platform_unlock(&ix->lock);
+    __atomic_add_fetch(&ix->generation, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&ix->state, SD_INDEX_DONE, __ATOMIC_RELEASE);
+}
+
+// Walk for at most about budget_us. Returns true while the walk is
+// unfinished. The table is published, not saved; see sd_index_save().
+static inline bool sd_index_step(SdIndex* ix, u32 budget_us) {
+    if(__atomic_load_n(&ix->state, __ATOMIC_ACQUIRE) != SD_INDEX_SCANNING) return false;
+    u64 t0 = platform_perf_us();
+    u64 now = t0;
+    while(now - t0 < budget_us) {
+        if(ix->dir) {
+            if(!sd_index_read(ix)) {
+                closedir(ix->dir);
+                ix->dir = NULL;
+                ix->cursor++;
+                __atomic_store_n(&ix->visited, ix->cursor, __ATOMIC_RELAXED);
+            }
+        } else if(ix->cursor < ix->next->h.count) {
+            if(!sd_index_enter(ix)) {
+                ix->cursor++;
+                __atomic_store_n(&ix->visited, ix->cursor, __ATOMIC_RELAXED);
+            }
+        } else {
+            break;
+        }
+        now = platform_perf_us();
+    }
+    u32 cost = (u32)(now - t0);
+    ix->slices++;
+    ix->busy_us += cost;
+    if(cost > ix->slice_max_us) ix->slice_max_us = cost;
+
+    if(ix->dir || ix->cursor < ix->next->h.count) return true;
+    sd_index_finish(ix);
+    return false;
+}
+
+// Only the walker thread may call this; it reads `current` unlocked.
+static inline bool sd_index_save(const SdIndex* ix) {
+    if(!ix->path[0]) return false;
+    const SdIndexTable* t = ix->current;
+    size_t len = sizeof(t->h) + t->h.count * sizeof(SdDir);
+    return config_write_atomic(ix->path, (const char*)t, len);
+}
+
+static inline bool sd_index_load(SdIndex* ix) {
+    if(!ix->path[0]) return false;
+    FILE* f = fopen(ix->path, "rb");
+    if(!f) return false;
+    SdIndexTable* t = ix->current;
+    bool ok = fread(&t->h, sizeof(t->h), 1, f) == 1
+        && t->h.magic == SD_INDEX_MAGIC && t->h.version == SD_INDEX_VERSION
+        && t->h.entry_size == sizeof(SdDir)
+        && t->h.count > 0 && t->h.count <= SD_INDEX_MAX_DIRS
+        && fread(t->dirs, sizeof(SdDir), t->h.count, f) == t->h.count;
+    fclose(f);
+    // reject tables whose links point outside themselves
+    for(u32 i = 1; ok && i < t->h.count; i++) {
+        const SdDir* d = &t->dirs[i];
+        ok = d->parent < i && (!d->children || (u32)d->first_child + d->children <= t->h.count);
+    }
+    if(ok && t->dirs[0].children) ok = (u32)t->dirs[0].first_child + t->dirs[0].children <= t->h.count;
+    if(!ok) memset(&t->h, 0, sizeof(t->h));
+    return ok;
+}
+
+// Index the tree under root, persisting to path ("" or NULL for none). A
+// previously saved table is loaded right away so results show before the
+// first walk ends.
+// Returns false when the tables cannot be allocated; the index then stays
+// empty and sd_index_start() refuses to run.
+static inline bool sd_index_init(SdIndex* ix, const char* root, const char* path) {
+    memset(ix, 0, sizeof(*ix));
+    snprintf(ix->root, sizeof(ix->root), "%s", root);
+    snprintf(ix->path, sizeof(ix->path), "%s", path ? path : "");
+    platform_lock_init(&ix->lock);
+    ix->tables = (SdIndexTable*)mem_calloc(MEM_SD_INDEX, 2 * sizeof(SdIndexTable));
+    if(!ix->tables) return false;
+    ix->current = &ix->tables[0];
+    ix->next = &ix->tables[1];
+    if(sd_index_load(ix)) ix->generation = 1;
+    return true;
+}
+
+// After sd_index_stop().
+static inline void sd_index_free(SdIndex* ix) {
+    mem_free(ix->tables);
+    ix->tables = ix->current = ix->next = NULL;
+}
+
+static void sd_index_worker(void* arg) {
+    SdIndex* ix = (SdIndex*)arg;
+    while(__atomic_load_n(&ix->running, __ATOMIC_ACQUIRE)) {
+        if(__atomic_load_n(&ix->state, __ATOMIC_ACQUIRE) != SD_INDEX_SCANNING) {
+            if(!__atomic_exchange_n(&ix->rescan, false, __ATOMIC_ACQ_REL)) {
+                platform_sleep_ms(100);
+                continue;
+            }
+            sd_index_begin(ix, false);
+        }
+        if(!sd_index_step(ix, SD_INDEX_SLICE_US)) sd_index_save(ix);
+        platform_sleep_ms(SD_INDEX_PAUSE_MS);
+    }
+    if(ix->dir) closedir(ix->dir);
+    ix->dir = NULL;
+}
+
+// Start the worker, which begins a walk right away.
+static inline bool sd_index_start(SdIndex* ix) {
+    if(!ix->tables) return false;
+    __atomic_store_n(&ix->rescan, true, __ATOMIC_RELEASE);
+    __atomic_store_n(&ix->running, true, __ATOMIC_RELEASE);
+    if(!platform_thread_start_idle(&ix->worker, sd_index_worker, ix, platform_core_count() - 1)) {
+        __atomic_store_n(&ix->running, false, __ATOMIC_RELEASE);
+        return false;
+    }
+    return true;
+}
+
+// An unfinished walk is dropped; the next start begins it again.
+static inline void sd_index_stop(SdIndex* ix) {
+    if(!ix->running) return;
+    __atomic_store_n(&ix->running, false, __ATOMIC_RELEASE);
+    platform_thread_join(&ix->worker);
+    __atomic_store_n(&ix->state, SD_INDEX_IDLE, __ATOMIC_RELEASE);
+}
+
+static inline void sd_index_request(SdIndex* ix) {
+    __atomic_store_n(&ix->rescan, true, __ATOMIC_RELEASE);
+}
+
+static inline void sd_index_size_text(u64 bytes, char* buf, int n) {
+    if(bytes >= (1ULL << 30)) snprintf(buf, n, "%.1fG", bytes / (double)(1ULL << 30));
+    else if(bytes >= (1ULL << 20)) snprintf(buf, n, "%.1fM", bytes / (double)(1ULL << 20));
+    else snprintf(buf, n, "%lluK", (unsigned long long)(bytes >> 10));
+}
+
+// One line: walk progress, or the size of the last finished table.
+static inline void sd_index_status(SdIndex* ix, char* buf, int n) {
+    if(!ix->tables) {
+        snprintf(buf, n, "SD index: out of memory");
+        return;
+    }
+    int state = __atomic_load_n(&ix->state, __ATOMIC_ACQUIRE);
+    platform_lock(&ix->lock);
+    SdIndexHeader h = ix->current->h;
+    u64 total = h.count ? ix->current->dirs[0].total_bytes : 0;
+    platform_unlock(&ix->lock);
+
+    char size[16];
+    sd_index_size_text(total, size, sizeof(size));
+    if(state == SD_INDEX_SCANNING && !h.count)
+        snprintf(buf, n, "SD index: scanning, %lu dirs", (unsigned long)__atomic_load_n(&ix->visited, __ATOMIC_RELAXED));
+    else if(!h.count)
+        snprintf(buf, n, "SD index: none yet");
+    else
+        snprintf(buf, n, "SD index: %s in %lu files, %lu dirs%s%s",
+                 size, (unsigned long)h.files, (unsigned long)h.count,
+                 state == SD_INDEX_SCANNING ? ", rescanning" : "",
+                 h.full || state == SD_INDEX_SCANNING ? "" : ", incremental");
+}
+
+// The largest top-level directories, biggest first, e.g.
+// "/Nintendo 3DS 3.1G  /3ds 210.4M  /luma 1.2M".
+static inline void sd_index_top(SdIndex* ix, int count, char* buf, int n) {
+    u16 top[8];
+    u64 bytes[8];
+    int k = 0;
+    if(count > 8) count = 8;
+    buf[0] = '\0';
+    if(!ix->tables) return;
+
+    platform_lock(&ix->lock);
+    const SdIndexTable* t = ix->current;
+    if(t->h.count && t->dirs[0].children) {
+        for(u32 c = t->dirs[0].first_child; c < (u32)t->dirs[0].first_child + t->dirs[0].children; c++) {
+            u64 b = t->dirs[c].total_bytes;
+            int j = k < count ? k++ : count;
+            for(; j > 0 && bytes[j - 1] < b; j--) {
+                if(j < count) { top[j] = top[j - 1]; bytes[j] = bytes[j - 1]; }
+            }
+            if(j < count) { top[j] = (u16)c; bytes[j] = b; }
+        }
+    }
+    int len = 0;
+    for(int i = 0; i < k && len < n; i++) {
+        char size[16];
+        sd_index_size_text(bytes[i], size, sizeof(size));
+        len += snprintf(buf + len, n - len, "%s/%s %s", i ? "  " : "", t->dirs[top[i]].name, size);
+    }
+    platform_unlock(&ix->lock);
+}
+
+#endif
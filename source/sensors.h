@@ -0,0 +1,171 @@
+#ifndef SENSORS_H
+#define SENSORS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "system_utils.h"
+
+// Rate-limited sensor scheduler.
+// Each metric has its own sampling period and the renderers only ever see
+// the cached last value. Sensors marked async (SD free space) are sampled
+// on a low-priority worker thread once sensors_start_worker() was called;
+// without a worker, sensors_poll() samples them inline, which keeps host
+// replays deterministic.
+
+typedef enum {
+    SENSOR_BATTERY = 0,
+    SENSOR_FREE_MEM,
+    SENSOR_SD_FREE,
+    SENSOR_COUNT
+} SensorId;
+
+typedef struct {
+    const char* name;
+    u64 (*sample)(void);
+    u32 period_ms;
+    bool async;
+
+    // guarded by SensorScheduler.lock
+    u64 value;
+    bool valid;
+    u32 last_ms;              // platform_ms() of the last sample
+    bool force;               // sample on the next poll regardless of period
+
+    // sample cost, in microseconds
+    u32 samples;
+    u32 cost_last_us;
+    u32 cost_max_us;
+    u64 cost_total_us;
+} Sensor;
+
+typedef struct {
+    Sensor s[SENSOR_COUNT];
+    PlatformLock lock;
+    PlatformThread worker;
+    bool running;             // worker active; atomic
+} SensorScheduler;
+
+static inline u64 sensor_sample_battery(void) { return get_battery_percent(); }
+static inline u64 sensor_sample_free_mem(void) { return get_free_memory(); }
+static inline u64 sensor_sample_sd_free(void) { return get_sd_free(); }
+
+static SensorScheduler sensors = {
+    .s = {
+        [SENSOR_BATTERY]  = { "battery", sensor_sample_battery,  2000, false },
+        [SENSOR_FREE_MEM] = { "mem",     sensor_sample_free_mem, 1000, false },
+        [SENSOR_SD_FREE]  = { "sd",      sensor_sample_sd_free, 10000, true  },
+    },
+};
+
+static inline bool sensor_due(const Sensor* s, u32 now) {
+    return !s->valid || s->force || now - s->last_ms >= s->period_ms;
+}
+
+// Take one sample outside the lock, then publish value and cost.
+static inline void sensor_run(Sensor* s, u32 now) {
+    u64 t0 = platform_perf_us();
+    u64 v = s->sample();
+    u32 cost = (u32)(platform_perf_us() - t0);
+
+    platform_lock(&sensors.lock);
+    s->value = v;
+    s->valid = true;
+    s->force = false;
+    s->last_ms = now;
+    s->samples++;
+    s->cost_last_us = cost;
+    if(cost > s->cost_max_us) s->cost_max_us = cost;
+    s->cost_total_us += cost;
+    platform_unlock(&sensors.lock);
+}
+
+// Samples every synchronous sensor so the first frame has real values.
+static inline void sensors_init(void) {
+    platform_lock_init(&sensors.lock);
+    u32 now = platform_ms();
+    for(int i = 0; i < SENSOR_COUNT; i++)
+        if(!sensors.s[i].async) sensor_run(&sensors.s[i], now);
+}
+
+static void sensors_worker(void* arg) {
+    (void)arg;
+    while(__atomic_load_n(&sensors.running, __ATOMIC_ACQUIRE)) {
+        u32 now = platform_ms();
+        for(int i = 0; i < SENSOR_COUNT; i++) {
+            Sensor* s = &sensors.s[i];
+            if(!s->async) continue;
+            platform_lock(&sensors.lock);
+            bool due = sensor_due(s, now);
+            platform_unlock(&sensors.lock);
+            if(due) sensor_run(s, now);
+        }
+        platform_sleep_ms(100);
+    }
+}
+
+static inline bool sensors_start_worker(void) {
+    __atomic_store_n(&sensors.running, true, __ATOMIC_RELEASE);
+    if(!platform_thread_start(&sensors.worker, sensors_worker, NULL)) {
+        __atomic_store_n(&sensors.running, false, __ATOMIC_RELEASE);
+        return false;
+    }
+    return true;
+}
+
+static inline void sensors_stop_worker(void) {
+    if(!sensors.running) return;
+    __atomic_store_n(&sensors.running, false, __ATOMIC_RELEASE);
+    platform_thread_join(&sensors.worker);
+}
+
+// Call once per frame. Only sensors whose period elapsed do any work.
+static inline void sensors_poll(void) {
+    u32 now = platform_ms();
+    for(int i = 0; i < SENSOR_COUNT; i++) {
+        Sensor* s = &sensors.s[i];
+        if(s->async && sensors.running) continue;
+        if(sensor_due(s, now)) sensor_run(s, now);
+    }
+}
+
+static inline u64 sensors_get(SensorId id) {
+    platform_lock(&sensors.lock);
+    u64 v = sensors.s[id].value;
+    platform_unlock(&sensors.lock);
+    return v;
+}
+
+static inline bool sensors_valid(SensorId id) {
+    platform_lock(&sensors.lock);
+    bool v = sensors.s[id].valid;
+    platform_unlock(&sensors.lock);
+    return v;
+}
+
+static inline void sensors_set_period(SensorId id, u32 period_ms) {
+    platform_lock(&sensors.lock);
+    sensors.s[id].period_ms = period_ms;
+    platform_unlock(&sensors.lock);
+}
+
+// Ask for a fresh sample on the next poll, e.g. after the user acted.
+static inline void sensors_refresh(SensorId id) {
+    platform_lock(&sensors.lock);
+    sensors.s[id].force = true;
+    platform_unlock(&sensors.lock);
+}
+
+// One line per sensor: name, period, samples, last/avg/max cost in us.
+static inline int sensors_format_stats(SensorId id, char* buf, size_t n) {
+    platform_lock(&sensors.lock);
+    const Sensor* s = &sensors.s[id];
+    u32 avg = s->samples ? (u32)(s->cost_total_us / s->samples) : 0;
+    int r = snprintf(buf, n, "%-7s %5lums n=%lu cost %lu/%lu/%lu us",
+                     s->name, (unsigned long)s->period_ms, (unsigned long)s->samples,
+                     (unsigned long)s->cost_last_us, (unsigned long)avg,
+                     (unsigned long)s->cost_max_us);
+    platform_unlock(&sensors.lock);
+    return r;
+}
+
+#endif
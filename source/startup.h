@@ -0,0 +1,121 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include "platform.h"
+
+// Startup pipeline.
+// The slow parts of startup (SD reads, sensor warm-up) run as stages on a
+// loader thread while the main loop already draws. Each stage only touches
+// state the main loop leaves alone until it took the stage: once
+// startup_take() returned true for it, the main loop owns that state and
+// applies it (selects the theme, sets up the governor, ...).
+//
+// Two times are recorded, both from the start of main(): the first frame
+// on screen and the moment every stage was applied and the sensors had
+// real values ("full data"). startup_finish() appends them with the
+// per-stage times to a log, one line per start.
+
+#define STARTUP_MAX_STAGES 8
+
+typedef struct {
+    const char* name;
+    void (*run)(void);
+} StartupStage;
+
+typedef struct {
+    const StartupStage* stages;
+    int count;
+    u64 t0_us;
+    u32 stage_ms[STARTUP_MAX_STAGES];   // finish time of each stage
+    u32 done;                 // bit per finished stage; atomic
+    u32 taken;                // main loop only
+    u32 first_frame_ms;       // 0 until reached
+    u32 full_data_ms;
+    PlatformThread loader;
+    bool threaded;
+} Startup;
+
+static inline u32 startup_elapsed_ms(const Startup* s) {
+    u32 ms = (u32)((platform_perf_us() - s->t0_us) / 1000);
+    return ms ? ms : 1;       // 0 means "not reached"
+}
+
+// First thing in main(), so the times include graphics init.
+static inline void startup_init(Startup* s) {
+    memset(s, 0, sizeof(*s));
+    s->t0_us = platform_perf_us();
+}
+
+static void startup_loader(void* arg) {
+    Startup* s = (Startup*)arg;
+    for(int i = 0; i < s->count; i++) {
+        s->stages[i].run();
+        s->stage_ms[i] = startup_elapsed_ms(s);
+        __atomic_or_fetch(&s->done, 1u << i, __ATOMIC_RELEASE);
+    }
+}
+
+// Run the stages in order on the loader thread, or right here if no thread
+// could be started.
+static inline void startup_start(Startup* s, const StartupStage* stages, int count) {
+    s->stages = stages;
+    s->count = count < STARTUP_MAX_STAGES ? count : STARTUP_MAX_STAGES;
+    s->threaded = platform_thread_start(&s->loader, startup_loader, s);
+    if(!s->threaded) startup_loader(s);
+}
+
+// True exactly once, on the first call after stage i finished.
+static inline bool startup_take(Startup* s, int i) {
+    u32 bit = 1u << i;
+    if(s->taken & bit) return false;
+    if(!(__atomic_load_n(&s->done, __ATOMIC_ACQUIRE) & bit)) return false;
+    s->taken |= bit;
+    return true;
+}
+
+static inline bool startup_ready(const Startup* s, int i) {
+    return (s->taken >> i) & 1;
+}
+
+static inline bool startup_all_taken(const Startup* s) {
+    return s->taken == (1u << s->count) - 1;
+}
+
+// Call after a frame was submitted.
+static inline void startup_frame_drawn(Startup* s) {
+    if(!s->first_frame_ms) s->first_frame_ms = startup_elapsed_ms(s);
+}
+
+// Call once everything shown is real data; only the first call counts.
+static inline void startup_full_data(Startup* s) {
+    if(!s->full_data_ms) s->full_data_ms = startup_elapsed_ms(s);
+}
+
+// "Startup: first frame 62 ms, full data 410 ms"
+static inline int startup_format(const Startup* s, char* buf, size_t n) {
+    if(!s->full_data_ms)
+        return snprintf(buf, n, "Startup: first frame %lu ms, loading...", (unsigned long)s->first_frame_ms);
+    return snprintf(buf, n, "Startup: first frame %lu ms, full data %lu ms",
+                    (unsigned long)s->first_frame_ms, (unsigned long)s->full_data_ms);
+}
+
+// Wait for the loader, then append
+// "<wall_s> first=<ms> full=<ms> <stage>=<ms>..." to log_path (if set).
+static inline void startup_finish(Startup* s, const char* log_path) {
+    if(s->threaded) platform_thread_join(&s->loader);
+    s->threaded = false;
+    if(!log_path) return;
+    FILE* f = fopen(log_path, "a");
+    if(!f) return;
+    fprintf(f, "%lu first=%lu full=%lu", (unsigned long)platform_wall_s(),
+            (unsigned long)s->first_frame_ms, (unsigned long)s->full_data_ms);
+    for(int i = 0; i < s->count; i++)
+        fprintf(f, " %s=%lu", s->stages[i].name, (unsigned long)s->stage_ms[i]);
+    fprintf(f, "\n");
+    fclose(f);
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef STATUS_TEXT_H
+#define STATUS_TEXT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "platform.h"
+
+// Status line formatting shared by the apps and the host build.
+// Every helper returns snprintf's result.
+
+static inline int status_battery(char* buf, size_t n, u8 percent) {
+    return snprintf(buf, n, "Battery: %d%%", percent);
+}
+
+static inline int status_saver(char* buf, size_t n, bool on) {
+    return snprintf(buf, n, "Battery Saver: %s", on ? "ON" : "OFF");
+}
+
+static inline int status_free_mem(char* buf, size_t n, u32 bytes) {
+    return snprintf(buf, n, "Free mem: %lu bytes", (unsigned long)bytes);
+}
+
+static inline int status_sd_free(char* buf, size_t n, u64 bytes) {
+    return snprintf(buf, n, "SD free: %llu bytes", (unsigned long long)bytes);
+}
+
+#endif
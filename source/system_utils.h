@@ -1,40 +1,35 @@
 #ifndef SYSTEM_UTILS_H
 #define SYSTEM_UTILS_H
 
-#include <3ds.h>
 #include <stdio.h>
+#include <stdbool.h>
+#include "platform.h"
+
+#define BRIGHTNESS_NORMAL 100
+#define BRIGHTNESS_SAVER  80
 
 // Returns battery percentage 0-100
 static inline u8 get_battery_percent() {
-    return ((u32)powerGetBatteryLevel()) * 10; // simple conversion
+    return platform_battery_percent();
 }
 
 // Enable or disable battery saving mode
 static inline void set_battery_saver(bool enable) {
     if(enable) {
-        gfxSetBrightness(GFX_TOP, 80);    // dim top screen
-        gfxSetBrightness(GFX_BOTTOM, 80); // dim bottom screen
+        platform_set_brightness(BRIGHTNESS_SAVER, BRIGHTNESS_SAVER);   // dim both screens
     } else {
-        gfxSetBrightness(GFX_TOP, 100);
-        gfxSetBrightness(GFX_BOTTOM, 100);
+        platform_set_brightness(BRIGHTNESS_NORMAL, BRIGHTNESS_NORMAL);
     }
 }
 
 // Returns free memory in bytes
 static inline u32 get_free_memory() {
-    u32 free_mem;
-    svcGetInfo(&free_mem, 0x10003, CUR_PROCESS_HANDLE, 0); // CUR_PROCESS info
-    return free_mem;
+    return platform_free_memory();
 }
 
 // Return SD card free space in bytes
 static inline u64 get_sd_free() {
-    u64 free, total;
-    FS_Archive sdmc;
-    FSUSER_OpenArchive(&sdmc, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""));
-    FSUSER_GetFreeSpace(&sdmc, &free, &total);
-    FSUSER_CloseArchive(&sdmc);
-    return free;
+    return platform_sd_free();
 }
 
 #endif
@@ -0,0 +1,180 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include "platform.h"
+
+// Binary telemetry logger.
+// The render thread appends fixed-size records to a lock-free ring in RAM;
+// a low-priority writer thread appends them to SD in batches of
+// TELEMETRY_BATCH records (or every TELEMETRY_FLUSH_MS when logging is
+// sparse). The log starts with a versioned header; host/telemetry_decode
+// turns it into CSV.
+//
+// Every telemetry_start() appends a session record first: a record with
+// cpu_x10 set to TELEMETRY_SESSION, time_ms the platform_ms() it started at
+// and free_mem the wall-clock time in seconds. time_ms restarts with every
+// boot, so the decoder needs these to tell sessions apart.
+//
+// A log is appended to as long as its records have the current layout
+// (version 1 logs only lack the session records). A record torn by a
+// crash is cut off first so the new ones stay aligned. A short write stops
+// logging for the rest of the session rather than leave a torn record
+// behind the next one.
+
+#define TELEMETRY_MAGIC      0x4C544553u   // "SETL", little-endian
+#define TELEMETRY_VERSION    2             // 2: session records
+#define TELEMETRY_SESSION    0xFFFFu       // cpu_x10 of a session record
+#define TELEMETRY_RING       1024          // records, power of two
+#define TELEMETRY_BATCH      256
+#define TELEMETRY_FLUSH_MS   5000
+
+typedef struct {
+    u32 magic;
+    u16 version;
+    u16 record_size;
+    u32 start_ms;             // platform_ms() when the log was created
+    u32 reserved;
+} TelemetryHeader;
+
+typedef struct {
+    u32 time_ms;
+    u32 free_mem;             // bytes
+    u32 frame_us;             // last frame interval
+    u16 cpu_x10;              // CPU load in 0.1 %
+    u8 battery;               // percent
+    u8 brightness;            // percent
+} TelemetryRecord;
+
+typedef struct {
+    TelemetryRecord ring[TELEMETRY_RING];
+    u32 head;                 // producer
+    u32 tail;                 // writer thread
+    u32 dropped;
+    u32 written;
+    u32 flushes;
+    bool failed;              // a write came up short; atomic
+    FILE* file;
+    PlatformThread writer;
+    bool running;             // atomic
+} TelemetryLog;
+
+static TelemetryLog telemetry;
+
+// Called from the render thread; never blocks. False if the ring is full.
+static inline bool telemetry_log(const TelemetryRecord* rec) {
+    if(!telemetry.file || __atomic_load_n(&telemetry.failed, __ATOMIC_ACQUIRE)) return false;
+    u32 head = telemetry.head;
+    u32 tail = __atomic_load_n(&telemetry.tail, __ATOMIC_ACQUIRE);
+    if(head - tail >= TELEMETRY_RING) { telemetry.dropped++; return false; }
+    telemetry.ring[head & (TELEMETRY_RING - 1)] = *rec;
+    __atomic_store_n(&telemetry.head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Write everything pending; at most two fwrite calls (ring wrap).
+static inline void telemetry_flush(void) {
+    u32 tail = telemetry.tail;
+    u32 head = __atomic_load_n(&telemetry.head, __ATOMIC_ACQUIRE);
+    while(tail != head) {
+        u32 start = tail & (TELEMETRY_RING - 1);
+        u32 n = head - tail;
+        if(n > TELEMETRY_RING - start) n = TELEMETRY_RING - start;
+        size_t w = fwrite(&telemetry.ring[start], sizeof(TelemetryRecord), n, telemetry.file);
+        telemetry.written += w;
+        if(w != n) {
+            tail = head;      // the rest has nowhere to go
+            __atomic_store_n(&telemetry.failed, true, __ATOMIC_RELEASE);
+            break;
+        }
+        tail += n;
+    }
+    if(fflush(telemetry.file) != 0) __atomic_store_n(&telemetry.failed, true, __ATOMIC_RELEASE);
+    telemetry.flushes++;
+    __atomic_store_n(&telemetry.tail, tail, __ATOMIC_RELEASE);
+}
+
+static void telemetry_writer(void* arg) {
+    (void)arg;
+    u32 last = platform_perf_us() / 1000;
+    while(__atomic_load_n(&telemetry.running, __ATOMIC_ACQUIRE) &&
+          !__atomic_load_n(&telemetry.failed, __ATOMIC_ACQUIRE)) {
+        platform_sleep_ms(250);
+        u32 now = platform_perf_us() / 1000;
+        u32 pending = __atomic_load_n(&telemetry.head, __ATOMIC_ACQUIRE) - telemetry.tail;
+        if(pending >= TELEMETRY_BATCH || (pending && now - last >= TELEMETRY_FLUSH_MS)) {
+            telemetry_flush();
+            last = now;
+        }
+    }
+    if(!__atomic_load_n(&telemetry.failed, __ATOMIC_ACQUIRE)) telemetry_flush();
+}
+
+// Open the log at path for appending, cut back to its last whole record.
+// NULL if there is no log this version can append to.
+static inline FILE* telemetry_open_append(const char* path) {
+    FILE* f = fopen(path, "r+b");
+    if(!f) return NULL;
+    TelemetryHeader h;
+    bool ok = fread(&h, sizeof(h), 1, f) == 1 && h.magic == TELEMETRY_MAGIC &&
+              h.version >= 1 && h.version <= TELEMETRY_VERSION && h.record_size == sizeof(TelemetryRecord);
+    long end = ok && fseek(f, 0, SEEK_END) == 0 ? ftell(f) : -1;
+    if(end < (long)sizeof(h)) {
+        fclose(f);
+        return NULL;
+    }
+    long whole = sizeof(h) + (end - (long)sizeof(h)) / sizeof(TelemetryRecord) * sizeof(TelemetryRecord);
+    if(whole != end && (fflush(f) != 0 || ftruncate(fileno(f), whole) != 0 || fseek(f, whole, SEEK_SET) != 0)) {
+        fclose(f);
+        return NULL;
+    }
+    return f;
+}
+
+// Open (or append to) the log at path, mark the new session and start the
+// writer thread. A file that is not a log of this layout is started over.
+static inline bool telemetry_start(const char* path) {
+    if(telemetry.file) return true;
+    memset(&telemetry, 0, sizeof(telemetry));
+    u32 now = platform_ms();
+    FILE* f = telemetry_open_append(path);
+    bool ok = true;
+    if(!f) {
+        f = fopen(path, "wb");
+        if(!f) return false;
+        TelemetryHeader h = { TELEMETRY_MAGIC, TELEMETRY_VERSION, sizeof(TelemetryRecord), now, 0 };
+        ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    }
+    TelemetryRecord session = { now, platform_wall_s(), 0, TELEMETRY_SESSION, 0, 0 };
+    if(!ok || fwrite(&session, sizeof(session), 1, f) != 1 || fflush(f) != 0) {
+        fclose(f);
+        return false;
+    }
+    telemetry.file = f;
+    __atomic_store_n(&telemetry.running, true, __ATOMIC_RELEASE);
+    if(!platform_thread_start(&telemetry.writer, telemetry_writer, NULL)) {
+        telemetry.running = false;
+        fclose(f);
+        telemetry.file = NULL;
+        return false;
+    }
+    return true;
+}
+
+// Stop the writer; it flushes whatever is still in the ring.
+static inline void telemetry_stop(void) {
+    if(!telemetry.file) return;
+    __atomic_store_n(&telemetry.running, false, __ATOMIC_RELEASE);
+    platform_thread_join(&telemetry.writer);
+    fclose(telemetry.file);
+    telemetry.file = NULL;
+}
+
+static inline bool telemetry_active(void) {
+    return telemetry.file != NULL;
+}
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef TEXT_CACHE_H
+#define TEXT_CACHE_H
+
+#include <3ds.h>
+#include <citro2d.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include "mem_track.h"
+
+// Text caching for citro2d.
+// TextCache interns constant strings (titles, page names, help lines): each
+// one is parsed into a shared, fixed-size glyph buffer the first time it is
+// drawn and reused afterwards. TextSlot holds one dynamic string such as
+// "Battery: 87%" in its own small buffer and only re-parses when the
+// contents change. All buffers are allocated once at init, so drawing
+// allocates nothing per frame. The buffers are charged to MEM_TEXT.
+
+#define TEXT_CACHE_ENTRIES   64
+#define TEXT_CACHE_GLYPHS    2048
+#define TEXT_SLOT_LEN        96
+#define TEXT_SLOT_GLYPHS     TEXT_SLOT_LEN
+#define TEXT_GLYPH_BYTES     36   // citro2d's per-glyph record (C2Di_Glyph)
+
+// What C2D_TextBufNew(glyphs) takes from the heap, near enough.
+static inline u32 text_buf_bytes(u32 glyphs) {
+    return (u32)sizeof(C2D_Text) + glyphs * TEXT_GLYPH_BYTES;
+}
+
+typedef struct {
+    const char* str;          // interned strings must outlive the cache
+    u32 hash;
+    C2D_Text text;
+} TextCacheEntry;
+
+typedef struct {
+    C2D_TextBuf buf;
+    TextCacheEntry entries[TEXT_CACHE_ENTRIES];
+    int count;
+    bool full;                // glyph buffer or entry table ran out
+} TextCache;
+
+typedef struct {
+    C2D_TextBuf buf;
+    C2D_Text text;
+    char str[TEXT_SLOT_LEN];
+    bool valid;
+    u32 reparses;             // how often the contents changed
+} TextSlot;
+
+static inline u32 text_hash(const char* s) {
+    u32 h = 2166136261u;
+    while(*s) { h ^= (u8)*s++; h *= 16777619u; }
+    return h;
+}
+
+static inline void text_cache_init(TextCache* tc) {
+    memset(tc, 0, sizeof(*tc));
+    tc->buf = C2D_TextBufNew(TEXT_CACHE_GLYPHS);
+    if(tc->buf) mem_track_add(MEM_TEXT, text_buf_bytes(TEXT_CACHE_GLYPHS));
+}
+
+static inline void text_cache_free(TextCache* tc) {
+    if(tc->buf) {
+        C2D_TextBufDelete(tc->buf);
+        mem_track_remove(MEM_TEXT, text_buf_bytes(TEXT_CACHE_GLYPHS));
+    }
+    tc->buf = NULL;
+    tc->count = 0;
+}
+
+// C2D_TextParse() never fails: when the glyph buffer runs out it stops and
+// returns where it got to. Only a parse that reached the end is usable.
+static inline bool text_parse_whole(C2D_Text* text, C2D_TextBuf buf, const char* str) {
+    return C2D_TextParse(text, buf, str) == str + strlen(str);
+}
+
+// Parsed text for a constant string; NULL once the cache is full.
+static inline const C2D_Text* text_cache_get(TextCache* tc, const char* str) {
+    for(int i = 0; i < tc->count; i++)
+        if(tc->entries[i].str == str) return &tc->entries[i].text;
+
+    u32 h = text_hash(str);
+    for(int i = 0; i < tc->count; i++)
+        if(tc->entries[i].hash == h && strcmp(tc->entries[i].str, str) == 0) return &tc->entries[i].text;
+
+    if(tc->count >= TEXT_CACHE_ENTRIES || !tc->buf) { tc->full = true; return NULL; }
+    TextCacheEntry* e = &tc->entries[tc->count];
+    if(!text_parse_whole(&e->text, tc->buf, str)) { tc->full = true; return NULL; }
+    C2D_TextOptimize(&e->text);
+    e->str = str;
+    e->hash = h;
+    tc->count++;
+    return &e->text;
+}
+
+static inline void text_cache_draw(TextCache* tc, const char* str, float x, float y, float scale, u32 color) {
+    const C2D_Text* t = text_cache_get(tc, str);
+    if(t) C2D_DrawText(t, C2D_WithColor, x, y, 0, scale, scale, color);
+}
+
+static inline void text_slot_init(TextSlot* ts) {
+    memset(ts, 0, sizeof(*ts));
+    ts->buf = C2D_TextBufNew(TEXT_SLOT_GLYPHS);
+    if(ts->buf) mem_track_add(MEM_TEXT, text_buf_bytes(TEXT_SLOT_GLYPHS));
+}
+
+static inline void text_slot_free(TextSlot* ts) {
+    if(ts->buf) {
+        C2D_TextBufDelete(ts->buf);
+        mem_track_remove(MEM_TEXT, text_buf_bytes(TEXT_SLOT_GLYPHS));
+    }
+    ts->buf = NULL;
+    ts->valid = false;
+}
+
+// Returns true if the string changed and was re-parsed.
+static inline bool text_slot_set(TextSlot* ts, const char* str) {
+    if(ts->valid && strcmp(ts->str, str) == 0) return false;
+    snprintf(ts->str, sizeof(ts->str), "%s", str);
+    C2D_TextBufClear(ts->buf);
+    ts->valid = ts->buf && text_parse_whole(&ts->text, ts->buf, ts->str);
+    if(ts->valid) C2D_TextOptimize(&ts->text);
+    ts->reparses++;
+    return true;
+}
+
+static inline bool text_slot_printf(TextSlot* ts, const char* fmt, ...) {
+    char tmp[TEXT_SLOT_LEN];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    return text_slot_set(ts, tmp);
+}
+
+static inline void text_slot_draw(const TextSlot* ts, float x, float y, float scale, u32 color) {
+    if(ts->valid) C2D_DrawText(&ts->text, C2D_WithColor, x, y, 0, scale, scale, color);
+}
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef THEME_H
+#define THEME_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <dirent.h>
+#include "platform.h"
+
+// Precompiled overlay themes.
+// A theme is a fixed-layout, little-endian struct: colors (already packed
+// the way C2D_Color32 packs them), battery thresholds, widget rectangles and
+// text scales. host/theme_compile turns an editable JSON source into the
+// binary; on the console it is one fread straight into a Theme plus a
+// header check, with no parsing or allocation. All themes in THEME_DIR are
+// loaded at startup, so switching is just an index change.
+
+#define THEME_MAGIC    0x48545345u  // "ESTH"
+#define THEME_VERSION  1
+#define THEME_NAME_LEN 16
+#define THEME_MAX      8
+#define THEME_DIR      "/3ds/system_enhancer/themes"
+
+// same byte order as C2D_Color32
+#define THEME_RGBA(r, g, b, a) ((u32)(r) | ((u32)(g) << 8) | ((u32)(b) << 16) | ((u32)(a) << 24))
+
+typedef enum {
+    THEME_C_BACKGROUND = 0,
+    THEME_C_TEXT,
+    THEME_C_BATTERY_HIGH,
+    THEME_C_BATTERY_MID,
+    THEME_C_BATTERY_LOW,
+    THEME_C_BATTERY_OUTLINE,
+    THEME_C_SAVER_ON,
+    THEME_C_SAVER_OFF,
+    THEME_C_CPU_BAR,
+    THEME_C_FPS_BAR,
+    THEME_C_LOW_PULSE,
+    THEME_COLOR_COUNT
+} ThemeColor;
+
+typedef enum {
+    THEME_R_TITLE = 0,        // intro title: x is the end of the slide, y
+    THEME_R_BATTERY_BAR,
+    THEME_R_BATTERY_TEXT,
+    THEME_R_SAVER,
+    THEME_R_SAVER_TEXT,
+    THEME_R_CPU_BAR,
+    THEME_R_CPU_TEXT,
+    THEME_R_FPS_BAR,
+    THEME_R_FPS_TEXT,
+    THEME_RECT_COUNT
+} ThemeRectId;
+
+typedef enum {
+    THEME_S_TITLE = 0,
+    THEME_S_BATTERY,
+    THEME_S_SAVER,
+    THEME_S_STATS,
+    THEME_SCALE_COUNT
+} ThemeScale;
+
+typedef struct {
+    s16 x, y, w, h;
+} ThemeRect;
+
+typedef struct {
+    u32 magic;
+    u16 version;
+    u16 size;                 // sizeof(Theme) when compiled
+    char name[THEME_NAME_LEN];
+    u32 color[THEME_COLOR_COUNT];
+    u8 battery_high_pct;      // above: high color
+    u8 battery_mid_pct;       // above: mid color, else low
+    u8 low_pulse_pct;         // at or below: pulse the screen
+    u8 reserved;
+    ThemeRect rect[THEME_RECT_COUNT];
+    float scale[THEME_SCALE_COUNT];
+} Theme;
+
+// The look the overlay always had; used when no theme file is present.
+static inline void theme_default(Theme* t) {
+    memset(t, 0, sizeof(*t));
+    t->magic = THEME_MAGIC;
+    t->version = THEME_VERSION;
+    t->size = sizeof(Theme);
+    snprintf(t->name, sizeof(t->name), "default");
+    t->color[THEME_C_BACKGROUND]      = THEME_RGBA(0, 0, 0, 128);
+    t->color[THEME_C_TEXT]            = THEME_RGBA(255, 255, 255, 255);
+    t->color[THEME_C_BATTERY_HIGH]    = THEME_RGBA(0, 255, 0, 255);
+    t->color[THEME_C_BATTERY_MID]     = THEME_RGBA(255, 255, 0, 255);
+    t->color[THEME_C_BATTERY_LOW]     = THEME_RGBA(255, 0, 0, 255);
+    t->color[THEME_C_BATTERY_OUTLINE] = THEME_RGBA(255, 255, 255, 255);
+    t->color[THEME_C_SAVER_ON]        = THEME_RGBA(0, 128, 255, 255);
+    t->color[THEME_C_SAVER_OFF]       = THEME_RGBA(128, 128, 128, 255);
+    t->color[THEME_C_CPU_BAR]         = THEME_RGBA(255, 128, 0, 255);
+    t->color[THEME_C_FPS_BAR]         = THEME_RGBA(0, 255, 128, 255);
+    t->color[THEME_C_LOW_PULSE]       = THEME_RGBA(255, 0, 0, 255);
+    t->battery_high_pct = 60;
+    t->battery_mid_pct = 30;
+    t->low_pulse_pct = 20;
+    t->rect[THEME_R_TITLE]        = (ThemeRect){ 0, 20, 0, 0 };
+    t->rect[THEME_R_BATTERY_BAR]  = (ThemeRect){ 50, 50, 200, 30 };
+    t->rect[THEME_R_BATTERY_TEXT] = (ThemeRect){ 140, 55, 0, 0 };
+    t->rect[THEME_R_SAVER]        = (ThemeRect){ 50, 100, 50, 30 };
+    t->rect[THEME_R_SAVER_TEXT]   = (ThemeRect){ 55, 105, 0, 0 };
+    t->rect[THEME_R_CPU_BAR]      = (ThemeRect){ 50, 150, 200, 20 };
+    t->rect[THEME_R_CPU_TEXT]     = (ThemeRect){ 50, 145, 0, 0 };
+    t->rect[THEME_R_FPS_BAR]      = (ThemeRect){ 50, 180, 200, 20 };
+    t->rect[THEME_R_FPS_TEXT]     = (ThemeRect){ 50, 175, 0, 0 };
+    t->scale[THEME_S_TITLE] = 1.5f;
+    t->scale[THEME_S_BATTERY] = 1.0f;
+    t->scale[THEME_S_SAVER] = 0.7f;
+    t->scale[THEME_S_STATS] = 0.6f;
+}
+
+static inline bool theme_valid(const Theme* t) {
+    return t->magic == THEME_MAGIC && t->version == THEME_VERSION && t->size == sizeof(Theme) &&
+           t->name[THEME_NAME_LEN - 1] == '\0';
+}
+
+// One read, then a header check.
+static inline bool theme_load(Theme* t, const char* path) {
+    FILE* f = fopen(path, "rb");
+    if(!f) return false;
+    bool ok = fread(t, 1, sizeof(*t), f) == sizeof(*t) && fgetc(f) == EOF;
+    fclose(f);
+    return ok && theme_valid(t);
+}
+
+static inline bool theme_save(const Theme* t, const char* path) {
+    FILE* f = fopen(path, "wb");
+    if(!f) return false;
+    bool ok = fwrite(t, 1, sizeof(*t), f) == sizeof(*t);
+    ok = fclose(f) == 0 && ok;
+    return ok;
+}
+
+static inline u32 theme_color(const Theme* t, ThemeColor c) {
+    return t->color[c];
+}
+
+// Same color with its alpha replaced (fades).
+static inline u32 theme_color_alpha(const Theme* t, ThemeColor c, u8 alpha) {
+    return (t->color[c] & 0x00FFFFFFu) | ((u32)alpha << 24);
+}
+
+static inline u32 theme_battery_color(const Theme* t, u8 percent) {
+    if(percent > t->battery_high_pct) return t->color[THEME_C_BATTERY_HIGH];
+    if(percent > t->battery_mid_pct) return t->color[THEME_C_BATTERY_MID];
+    return t->color[THEME_C_BATTERY_LOW];
+}
+
+// The built-in default plus every valid *.bin in a directory.
+typedef struct {
+    Theme themes[THEME_MAX];
+    int count;
+    int current;
+} ThemeSet;
+
+static inline void theme_set_load(ThemeSet* ts, const char* dir) {
+    theme_default(&ts->themes[0]);
+    ts->count = 1;
+    ts->current = 0;
+    DIR* d = opendir(dir);
+    if(!d) return;
+    struct dirent* ent;
+    while(ts->count < THEME_MAX && (ent = readdir(d)) != NULL) {
+        size_t n = strlen(ent->d_name);
+        if(n < 5 || strcmp(ent->d_name + n - 4, ".bin") != 0) continue;
+        char path[256];
+        if(snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name) >= (int)sizeof(path)) continue;
+        Theme* t = &ts->themes[ts->count];
+        if(!theme_load(t, path)) continue;
+        // a file named like the built-in one replaces it
+        if(strcmp(t->name, ts->themes[0].name) == 0) ts->themes[0] = *t;
+        else ts->count++;
+    }
+    closedir(d);
+}
+
+static inline const Theme* theme_current(const ThemeSet* ts) {
+    return &ts->themes[ts->current];
+}
+
+// Switch by name; false (and no change) if there is no such theme.
+static inline bool theme_select(ThemeSet* ts, const char* name) {
+    for(int i = 0; i < ts->count; i++) {
+        if(strcmp(ts->themes[i].name, name) == 0) {
+            ts->current = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline const Theme* theme_next(ThemeSet* ts) {
+    ts->current = (ts->current + 1) % ts->count;
+    return theme_current(ts);
+}
+
+#endif
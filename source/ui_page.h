@@ -0,0 +1,312 @@
+#ifndef UI_PAGE_H
+#define UI_PAGE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "platform.h"
+#include "theme.h"
+
+// Table-driven settings pages.
+// A page is a static table of widgets (toggle, slider, info line, action).
+// ui_layout() places every widget once at startup; ui_input() moves the
+// focus between focusable widgets and applies edits; ui_emit() turns the
+// current page into a flat draw list that is sorted so all rectangles of a
+// layer go out before its text, which keeps citro2d from flushing a batch
+// at every switch between untextured rects and the glyph sheet. Nothing
+// here touches citro2d or libctru, so layout, input and the draw list can
+// be exercised on the host; the app only submits the sorted list.
+
+#define UI_MAX_WIDGETS 12
+#define UI_MAX_SLOTS   12        // dynamic strings per page
+#define UI_TEXT_LEN    96
+#define UI_MAX_RECTS   32
+#define UI_MAX_TEXTS   48
+
+// layout, in top-screen pixels
+#define UI_SCREEN_W    400
+#define UI_SCREEN_H    240
+#define UI_LEFT        24
+#define UI_TOP         90
+#define UI_LINE_H      25.0f     // line height at scale 1.0
+#define UI_SLIDER_W    220
+#define UI_SLIDER_H    10
+#define UI_VALUE_X     260       // toggle state column
+
+#define UI_COLOR_BG        THEME_RGBA(8, 8, 16, 255)
+#define UI_COLOR_TITLE     THEME_RGBA(200, 200, 255, 255)
+#define UI_COLOR_TAB       THEME_RGBA(200, 200, 200, 255)
+#define UI_COLOR_TEXT      THEME_RGBA(255, 255, 255, 255)
+#define UI_COLOR_DIM       THEME_RGBA(200, 200, 200, 255)
+#define UI_COLOR_FOCUS     THEME_RGBA(255, 255, 0, 255)
+#define UI_COLOR_BAR       THEME_RGBA(0, 160, 255, 255)
+#define UI_COLOR_OUTLINE   THEME_RGBA(255, 255, 255, 255)
+#define UI_COLOR_HELP_BG   THEME_RGBA(0, 0, 0, 200)
+
+// abstract input, mapped from HID keys by ui_keys()
+enum {
+    UI_IN_UP       = 1 << 0,
+    UI_IN_DOWN     = 1 << 1,
+    UI_IN_LEFT     = 1 << 2,
+    UI_IN_RIGHT    = 1 << 3,
+    UI_IN_ACTIVATE = 1 << 4,
+    UI_IN_HELP     = 1 << 5,
+    UI_IN_PAGE_PREV = 1 << 6,
+    UI_IN_PAGE_NEXT = 1 << 7,
+};
+
+// L/R (and ZL/ZR on the New 3DS) always turn the page, so a focused slider
+// that takes Left/Right never traps the user on its page.
+static inline u32 ui_keys(u32 keys) {
+    u32 in = 0;
+    if(keys & KEY_UP) in |= UI_IN_UP;
+    if(keys & KEY_DOWN) in |= UI_IN_DOWN;
+    if(keys & KEY_LEFT) in |= UI_IN_LEFT;
+    if(keys & KEY_RIGHT) in |= UI_IN_RIGHT;
+    if(keys & KEY_A) in |= UI_IN_ACTIVATE;
+    if(keys & KEY_SELECT) in |= UI_IN_HELP;
+    if(keys & (KEY_L | KEY_ZL)) in |= UI_IN_PAGE_PREV;
+    if(keys & (KEY_R | KEY_ZR)) in |= UI_IN_PAGE_NEXT;
+    return in;
+}
+
+typedef enum {
+    UI_INFO = 0,              // text line, constant or from text()
+    UI_TOGGLE,                // label + ON/OFF, A flips *flag
+    UI_SLIDER,                // label + bar; Left/Right step *value (read-only without flag UI_F_EDIT)
+    UI_ACTION                 // label, A calls on_change
+} UiKind;
+
+enum {
+    UI_F_EDIT  = 1 << 0,      // slider can be changed
+    UI_F_SMALL = 1 << 1,      // stats-sized text
+};
+
+typedef struct UiApp UiApp;
+typedef struct UiWidget UiWidget;
+typedef void (*UiTextFn)(const UiWidget* w, char* buf, size_t n);
+typedef void (*UiChangeFn)(UiApp* app, UiWidget* w);
+
+struct UiWidget {
+    UiKind kind;
+    const char* label;
+    UiTextFn text;            // dynamic text; INFO uses it instead of label
+    bool* flag;               // TOGGLE
+    int* value;               // SLIDER
+    int min, max, step;
+    UiChangeFn on_change;     // after a toggle / slider edit, or on A for actions
+    u8 flags;
+    int arg;                  // free for text() / on_change
+    // set by ui_layout
+    float y, scale;
+    int slot;                 // text slot for dynamic text, -1 if none
+};
+
+typedef struct {
+    const char* tab;          // "[Power]  (L/R to change)"
+    const char* title;        // "Power & Battery"
+    UiWidget widgets[UI_MAX_WIDGETS];
+    int count;                // filled in by ui_layout
+    int focusable;
+} UiPage;
+
+struct UiApp {
+    const char* title;
+    UiPage* pages;
+    int page_count;
+    int page;
+    int focus;                // index among the page's focusable widgets
+    bool help;
+};
+
+static inline bool ui_focusable(const UiWidget* w) {
+    return w->kind == UI_TOGGLE || w->kind == UI_ACTION || (w->kind == UI_SLIDER && (w->flags & UI_F_EDIT));
+}
+
+// Place every widget of every page. Call once; pages are static tables
+// terminated by a widget with no label and no text().
+static inline void ui_layout(UiApp* app) {
+    for(int p = 0; p < app->page_count; p++) {
+        UiPage* pg = &app->pages[p];
+        float y = UI_TOP;
+        int slot = 0;
+        pg->count = pg->focusable = 0;
+        for(int i = 0; i < UI_MAX_WIDGETS; i++) {
+            UiWidget* w = &pg->widgets[i];
+            if(!w->label && !w->text) break;
+            pg->count++;
+            if(ui_focusable(w)) pg->focusable++;
+            w->scale = (w->flags & UI_F_SMALL) ? 0.45f : (w->kind == UI_TOGGLE ? 0.8f : 0.7f);
+            w->y = y;
+            y += UI_LINE_H * w->scale;
+            if(w->kind == UI_SLIDER) y += UI_SLIDER_H + 14;
+            w->slot = (w->text || w->kind == UI_SLIDER) && slot < UI_MAX_SLOTS ? slot++ : -1;
+        }
+    }
+}
+
+static inline UiPage* ui_current(UiApp* app) {
+    return &app->pages[app->page];
+}
+
+// The widget holding the focus, NULL on pages with nothing to focus.
+static inline UiWidget* ui_focused(UiApp* app) {
+    UiPage* pg = ui_current(app);
+    int n = 0;
+    for(int i = 0; i < pg->count; i++) {
+        if(!ui_focusable(&pg->widgets[i])) continue;
+        if(n++ == app->focus) return &pg->widgets[i];
+    }
+    return NULL;
+}
+
+static inline void ui_goto_page(UiApp* app, int page) {
+    app->page = (page + app->page_count) % app->page_count;
+    app->focus = 0;
+}
+
+// Apply one frame of input. Returns true when anything visible changed.
+static inline bool ui_input(UiApp* app, u32 in) {
+    if(!in) return false;
+    UiPage* pg = ui_current(app);
+    UiWidget* w = ui_focused(app);
+
+    if(in & UI_IN_HELP) app->help = !app->help;
+    if(in & (UI_IN_PAGE_PREV | UI_IN_PAGE_NEXT)) {
+        ui_goto_page(app, app->page + ((in & UI_IN_PAGE_NEXT) ? 1 : -1));
+    } else if(in & UI_IN_DOWN) {
+        if(app->focus < pg->focusable - 1) app->focus++;
+    } else if(in & UI_IN_UP) {
+        if(app->focus > 0) app->focus--;
+    } else if(in & (UI_IN_LEFT | UI_IN_RIGHT)) {
+        int dir = (in & UI_IN_RIGHT) ? 1 : -1;
+        if(w && w->kind == UI_SLIDER) {
+            // Left/Right edit the focused slider instead of turning the page
+            int v = *w->value + dir * w->step;
+            if(v < w->min) v = w->min;
+            if(v > w->max) v = w->max;
+            if(v != *w->value) {
+                *w->value = v;
+                if(w->on_change) w->on_change(app, w);
+            }
+        } else {
+            ui_goto_page(app, app->page + dir);
+        }
+    } else if((in & UI_IN_ACTIVATE) && w) {
+        if(w->kind == UI_TOGGLE) *w->flag = !*w->flag;
+        if(w->kind != UI_SLIDER && w->on_change) w->on_change(app, w);
+    }
+    return true;
+}
+
+// Draw list
+
+typedef struct {
+    float x, y, w, h;
+    u32 color;
+    u8 layer;
+    bool outline;
+} UiRect;
+
+typedef struct {
+    const char* str;          // constant text (text cache), or NULL
+    int slot;                 // dynamic text in UiDrawList.slot_text
+    float x, y, scale;
+    u32 color;
+    u8 layer;
+} UiText;
+
+typedef struct {
+    UiRect rects[UI_MAX_RECTS];
+    UiText texts[UI_MAX_TEXTS];
+    int rect_count, text_count;
+    char slot_text[UI_MAX_SLOTS][UI_TEXT_LEN];
+} UiDrawList;
+
+static inline void ui_rect(UiDrawList* dl, u8 layer, float x, float y, float w, float h, u32 color, bool outline) {
+    if(dl->rect_count < UI_MAX_RECTS) dl->rects[dl->rect_count++] = (UiRect){ x, y, w, h, color, layer, outline };
+}
+
+static inline void ui_text(UiDrawList* dl, u8 layer, const char* str, int slot, float x, float y, float scale, u32 color) {
+    if(dl->text_count < UI_MAX_TEXTS) dl->texts[dl->text_count++] = (UiText){ str, slot, x, y, scale, color, layer };
+}
+
+// Build the draw list for the current page.
+static inline void ui_emit(UiApp* app, UiDrawList* dl) {
+    dl->rect_count = dl->text_count = 0;
+    UiPage* pg = ui_current(app);
+    UiWidget* focus = ui_focused(app);
+
+    ui_text(dl, 0, app->title, -1, 16, 8, 1.2f, UI_COLOR_TITLE);
+    ui_text(dl, 0, pg->tab, -1, 16, 36, 0.6f, UI_COLOR_TAB);
+    ui_text(dl, 0, pg->title, -1, UI_LEFT, 60, 0.9f, UI_COLOR_TEXT);
+
+    for(int i = 0; i < pg->count; i++) {
+        UiWidget* w = &pg->widgets[i];
+        u32 color = w == focus ? UI_COLOR_FOCUS : (w->kind == UI_TOGGLE ? UI_COLOR_TEXT : UI_COLOR_DIM);
+        if(w == focus) ui_text(dl, 0, ">", -1, UI_LEFT - 14, w->y, w->scale, color);
+
+        if(w->text && w->slot >= 0) {
+            w->text(w, dl->slot_text[w->slot], UI_TEXT_LEN);
+            ui_text(dl, 0, NULL, w->slot, UI_LEFT, w->y, w->scale, color);
+        } else {
+            ui_text(dl, 0, w->label, -1, UI_LEFT, w->y, w->scale, color);
+        }
+
+        if(w->kind == UI_TOGGLE)
+            ui_text(dl, 0, *w->flag ? "ON" : "OFF", -1, UI_VALUE_X, w->y, w->scale, color);
+
+        if(w->kind == UI_SLIDER) {
+            float by = w->y + UI_LINE_H * w->scale + 4;
+            int range = w->max - w->min;
+            float fill = range > 0 ? UI_SLIDER_W * (float)(*w->value - w->min) / range : 0;
+            ui_rect(dl, 0, UI_LEFT, by, fill, UI_SLIDER_H, UI_COLOR_BAR, false);
+            ui_rect(dl, 0, UI_LEFT, by, UI_SLIDER_W, UI_SLIDER_H, UI_COLOR_OUTLINE, true);
+            if(!w->text && w->slot >= 0) {
+                // the label line is constant, the value goes in the slot
+                snprintf(dl->slot_text[w->slot], UI_TEXT_LEN, "%d%%", *w->value);
+                ui_text(dl, 0, NULL, w->slot, UI_LEFT + UI_SLIDER_W + 8, by - 2, 0.6f, UI_COLOR_TEXT);
+            }
+        }
+    }
+
+    if(app->help) {
+        ui_rect(dl, 1, 16, 196, UI_SCREEN_W - 32, 36, UI_COLOR_HELP_BG, false);
+        ui_text(dl, 1, "L/R: page  Left/Right: slider or page  Up/Down: select", -1, 24, 200, 0.5f, UI_COLOR_TEXT);
+        ui_text(dl, 1, "A: activate  X: quick save  SELECT: help  START: exit", -1, 24, 214, 0.5f, UI_COLOR_TEXT);
+    }
+}
+
+// Submission order is layer by layer, and within a layer all rects first,
+// then all text, each in emit order.
+static inline int ui_layer_count(const UiDrawList* dl) {
+    int n = 0;
+    for(int i = 0; i < dl->rect_count; i++) if(dl->rects[i].layer + 1 > n) n = dl->rects[i].layer + 1;
+    for(int i = 0; i < dl->text_count; i++) if(dl->texts[i].layer + 1 > n) n = dl->texts[i].layer + 1;
+    return n;
+}
+
+// Number of texture switches a submission would cost (for the perf page
+// and for checking the batching on the host).
+static inline int ui_batch_breaks(const UiDrawList* dl) {
+    int breaks = 0;
+    int layers = ui_layer_count(dl);
+    bool prev_text = false, any = false;
+    for(int l = 0; l < layers; l++) {
+        for(int i = 0; i < dl->rect_count; i++) {
+            if(dl->rects[i].layer != l) continue;
+            if(any && prev_text) breaks++;
+            prev_text = false;
+            any = true;
+        }
+        for(int i = 0; i < dl->text_count; i++) {
+            if(dl->texts[i].layer != l) continue;
+            if(any && !prev_text) breaks++;
+            prev_text = true;
+            any = true;
+        }
+    }
+    return breaks;
+}
+
+#endif